@@ -0,0 +1,147 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * Measures the CPU cost of building and submitting batches for each of the
+ * ways intel_batchbuffer can get commands into the batch bo: writing into a
+ * malloced staging buffer and copying it with pwrite, or writing directly
+ * through a CPU (LLC parts only) or GTT mapping of the bo.
+ *
+ * Each batch is filled with MI_NOOPs plus a relocation every 64 dwords, and
+ * only process CPU time is reported so the numbers are independent of how
+ * long the GPU takes to chew through the noops.  -r submits through libdrm's
+ * relocation lists instead of the batchbuffer's NO_RELOC/HANDLE_LUT path.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_bufmgr.h"
+#include "intel_batchbuffer.h"
+#include "intel_gpu_tools.h"
+
+static const char *mapping_names[] = {
+	[INTEL_BATCH_STAGED] = "staged",
+	[INTEL_BATCH_CPU_MAP] = "cpu map",
+	[INTEL_BATCH_GTT_MAP] = "gtt map",
+};
+
+static double
+get_cpu_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double
+run(struct intel_batchbuffer *batch, drm_intel_bo *target,
+    int count, int dwords)
+{
+	double start_time;
+	int i, n;
+
+	start_time = get_cpu_time();
+	for (i = 0; i < count; i++) {
+		for (n = 0; n < dwords; n += 64) {
+			int len = dwords - n < 64 ? dwords - n : 64;
+
+			BEGIN_BATCH(len + 1);
+			OUT_RELOC(target, I915_GEM_DOMAIN_RENDER, 0, n);
+			while (len--)
+				OUT_BATCH(MI_NOOP);
+			ADVANCE_BATCH();
+		}
+		intel_batchbuffer_flush(batch);
+	}
+	drm_intel_bo_wait_rendering(target);
+
+	return get_cpu_time() - start_time;
+}
+
+int main(int argc, char **argv)
+{
+	drm_intel_bufmgr *bufmgr;
+	struct intel_batchbuffer *batch;
+	drm_intel_bo *target;
+	int count = 10000, fd, opt, dwords, i;
+	int has_llc, relocs = 0;
+
+	while ((opt = getopt(argc, argv, "n:r")) != -1) {
+		switch (opt) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'r':
+			relocs = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n batches] [-r]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	fd = drm_open_any();
+	has_llc = gem_has_llc(fd);
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+	if (!relocs)
+		intel_batchbuffer_set_exec_fd(batch, fd);
+	target = drm_intel_bo_alloc(bufmgr, "target", 4096, 4096);
+
+	for (i = INTEL_BATCH_STAGED; i <= INTEL_BATCH_GTT_MAP; i++) {
+		if (i == INTEL_BATCH_CPU_MAP && !has_llc) {
+			printf("%s: skipped, no LLC\n", mapping_names[i]);
+			continue;
+		}
+
+		intel_batchbuffer_set_mapping(batch, i);
+		run(batch, target, 16, 1024);
+
+		for (dwords = 16; dwords <= 1024; dwords *= 4) {
+			double elapsed = run(batch, target, count, dwords);
+
+			printf("%s: %5d dwords/batch: %.03f usecs/batch\n",
+			       mapping_names[i], dwords, 1e6 * elapsed / count);
+		}
+	}
+
+	drm_intel_bo_unreference(target);
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	close(fd);
+
+	return 0;
+}
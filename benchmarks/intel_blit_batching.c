@@ -0,0 +1,180 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * Measures how blit throughput scales with the number of blits submitted per
+ * execbuffer.  Small copies are emitted back to back into a batch that is
+ * allowed to grow until it holds the requested number of blits, so the cost
+ * of the execbuffer ioctl itself is amortised across the whole batch.
+ *
+ * -p sets the size of the batchbuffer's bo pool, with -p 0 allocating a new
+ * batch bo for every execbuffer to show what recycling them saves.  -r
+ * submits through libdrm's relocation lists instead of the batchbuffer's
+ * own NO_RELOC/HANDLE_LUT path.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_bufmgr.h"
+#include "intel_batchbuffer.h"
+#include "intel_batch_packets.h"
+#include "intel_gpu_tools.h"
+
+#define OBJECT_WIDTH	256
+#define OBJECT_HEIGHT	256
+#define BLIT_SIZE	sizeof(struct xy_src_copy_blt)
+
+static double
+get_time_in_secs(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (double)tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+emit_blit(struct intel_batchbuffer *batch,
+	  drm_intel_bo *dst_bo, drm_intel_bo *src_bo, int i)
+{
+	int x = (i * 4) % OBJECT_WIDTH;
+	int y = (i * 4 / OBJECT_WIDTH * 4) % OBJECT_HEIGHT;
+	struct xy_src_copy_blt blt = {
+		.cmd = XY_SRC_COPY_BLT_CMD |
+		       XY_SRC_COPY_BLT_WRITE_ALPHA |
+		       XY_SRC_COPY_BLT_WRITE_RGB,
+		.br13 = (3 << 24) | /* 32 bits */
+			(0xcc << 16) | /* copy ROP */
+			(OBJECT_WIDTH * 4) /* dst pitch */,
+		.dst_x1y1 = BLT_XY(x, y),
+		.dst_x2y2 = BLT_XY(x + 4, y + 4),
+		.src_x1y1 = BLT_XY(x, y),
+		.src_pitch = OBJECT_WIDTH * 4,
+	};
+	uint32_t offset;
+
+	offset = OUT_PACKET(blt);
+	OUT_PACKET_RELOC(offset, blt, dst, dst_bo,
+			 I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+	OUT_PACKET_RELOC(offset, blt, src, src_bo,
+			 I915_GEM_DOMAIN_RENDER, 0, 0);
+}
+
+static double
+run(struct intel_batchbuffer *batch,
+    drm_intel_bo *dst_bo, drm_intel_bo *src_bo,
+    int count, int per_batch)
+{
+	double start_time, end_time;
+	int i;
+
+	start_time = get_time_in_secs();
+	for (i = 0; i < count; i++) {
+		emit_blit(batch, dst_bo, src_bo, i);
+		if ((i + 1) % per_batch == 0)
+			intel_batchbuffer_flush(batch);
+	}
+	intel_batchbuffer_flush(batch);
+	drm_intel_bo_wait_rendering(dst_bo);
+	end_time = get_time_in_secs();
+
+	return end_time - start_time;
+}
+
+int main(int argc, char **argv)
+{
+	int object_size = OBJECT_WIDTH * OBJECT_HEIGHT * 4;
+	drm_intel_bufmgr *bufmgr;
+	struct intel_batchbuffer *batch;
+	drm_intel_bo *dst_bo, *src_bo;
+	int count = 100000, max_per_batch = 16384, pool = BATCH_POOL_SIZE;
+	int fd, per_batch, opt, relocs = 0;
+
+	while ((opt = getopt(argc, argv, "n:m:p:r")) != -1) {
+		switch (opt) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'm':
+			max_per_batch = atoi(optarg);
+			break;
+		case 'p':
+			pool = atoi(optarg);
+			break;
+		case 'r':
+			relocs = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n blits] [-m max blits per batch] "
+				"[-p batch pool size] [-r]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	fd = drm_open_any();
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+	intel_batchbuffer_set_max_size(batch,
+				       2 * max_per_batch * BLIT_SIZE + BATCH_SZ);
+	intel_batchbuffer_set_pool_size(batch, pool);
+	if (!relocs && !intel_batchbuffer_set_exec_fd(batch, fd))
+		printf("NO_RELOC/HANDLE_LUT not supported, using relocations\n");
+
+	dst_bo = drm_intel_bo_alloc(bufmgr, "dst", object_size, 4096);
+	src_bo = drm_intel_bo_alloc(bufmgr, "src", object_size, 4096);
+
+	/* Warm up, which also grows the batch to its final size. */
+	run(batch, dst_bo, src_bo, max_per_batch, max_per_batch);
+
+	for (per_batch = 1; per_batch <= max_per_batch; per_batch *= 4) {
+		double elapsed = run(batch, dst_bo, src_bo, count, per_batch);
+
+		printf("%6d blits/execbuf: %d blits in %.03f secs, %.0f blits/sec\n",
+		       per_batch, count, elapsed, count / elapsed);
+	}
+
+	printf("batch bos: %lu allocated, %lu reused, %lu waits\n",
+	       batch->pool_allocs, batch->pool_reuses, batch->pool_waits);
+	printf("execbufs without relocation: %lu\n", batch->exec_no_relocs);
+
+	drm_intel_bo_unreference(src_bo);
+	drm_intel_bo_unreference(dst_bo);
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * Measures the CPU cost of building and submitting render copies and blits
+ * for each supported generation, without any GPU.
+ *
+ * Everything runs against the mock GEM device, whose execbuffer only applies
+ * relocations, so the numbers are the cost of intel_batchbuffer, the
+ * rendercopy state emission and libdrm_intel alone.  -g picks a single
+ * device id, -r submits through libdrm's relocation lists instead of the
+ * batchbuffer's NO_RELOC/HANDLE_LUT path.  Batch bytes are what gets
+ * uploaded per copy, and so roughly what the GPU has to fetch.  The list
+ * numbers submit the same copies LIST_SIZE at a time through the
+ * rendercopy list interface.
+ *
+ * That is all it measures: nothing is executed, and the kernel's share of
+ * a real execbuffer (object lookup, binding, relocation and domain
+ * tracking, ring emission) is missing as well.  Fewer bytes or relocations
+ * per copy should help on hardware too, but how much can only be told by
+ * timing the copies on a real device.  intel_render_fill does that for the
+ * gen6/gen7 fill path, which shares the persistent render state with the
+ * copies, and includes the GPU time.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "rendercopy.h"
+#include "intel_mock_gem.h"
+
+#define WIDTH 512
+#define HEIGHT 512
+#define COPY_SIZE 64
+#define LIST_SIZE 64
+
+static const uint32_t default_devids[] = {
+	PCI_CHIP_I830_M,
+	PCI_CHIP_I915_G,
+	PCI_CHIP_I965_GM,
+	PCI_CHIP_SANDYBRIDGE_GT2,
+	PCI_CHIP_IVYBRIDGE_GT2,
+};
+
+static double
+get_cpu_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+init_buf(drm_intel_bufmgr *bufmgr, struct scratch_buf *buf)
+{
+	memset(buf, 0, sizeof(*buf));
+	buf->bo = drm_intel_bo_alloc(bufmgr, "scratch", WIDTH * HEIGHT * 4, 4096);
+	buf->stride = WIDTH * 4;
+	buf->tiling = I915_TILING_NONE;
+	buf->size = WIDTH * HEIGHT * 4;
+}
+
+static void
+report(const char *what, int fd, int count, double elapsed,
+       const struct intel_mock_gem_stats *before, unsigned long bytes)
+{
+	struct intel_mock_gem_stats after;
+
+	intel_mock_gem_get_stats(fd, &after);
+	printf("  %-6s: %.03f usecs/copy, %.1f ioctls/copy, %.1f relocs/copy (%.1f skipped), %lu batch bytes/copy\n",
+	       what, 1e6 * elapsed / count,
+	       (double)(after.ioctls - before->ioctls) / count,
+	       (double)(after.relocs - before->relocs) / count,
+	       (double)(after.relocs_skipped - before->relocs_skipped) / count,
+	       bytes / count);
+}
+
+static void
+run_device(uint32_t devid, int count, int relocs)
+{
+	struct intel_mock_gem_stats stats;
+	drm_intel_bufmgr *bufmgr;
+	struct intel_batchbuffer *batch;
+	struct scratch_buf src, dst;
+	render_copyfunc_t copy;
+	render_copylistfunc_t copylist;
+	struct render_copy list[LIST_SIZE];
+	unsigned long bytes;
+	double start_time;
+	int fd, i;
+
+	intel_mock_gem_enable(devid);
+	fd = drm_open_any();
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
+
+	batch = intel_batchbuffer_alloc(bufmgr, devid);
+	if (!relocs)
+		intel_batchbuffer_set_exec_fd(batch, fd);
+
+	init_buf(bufmgr, &src);
+	init_buf(bufmgr, &dst);
+
+	printf("0x%04x (gen%d):\n", devid, intel_gen(devid));
+
+	copy = get_render_copyfunc(devid);
+	if (copy) {
+		intel_mock_gem_get_stats(fd, &stats);
+		bytes = 0;
+		start_time = get_cpu_time();
+		for (i = 0; i < count; i++) {
+			copy(batch, &src, i % (WIDTH / COPY_SIZE) * COPY_SIZE, 0,
+			     COPY_SIZE, COPY_SIZE, &dst, 0, 0);
+			bytes += batch->upload_size;
+		}
+		report("render", fd, count, get_cpu_time() - start_time, &stats,
+		       bytes);
+	} else
+		printf("  render: no rendercopy\n");
+
+	copylist = get_render_copylistfunc(devid);
+	if (copylist) {
+		for (i = 0; i < LIST_SIZE; i++) {
+			list[i].src = &src;
+			list[i].src_x = i % (WIDTH / COPY_SIZE) * COPY_SIZE;
+			list[i].src_y = i / (WIDTH / COPY_SIZE) * COPY_SIZE;
+			list[i].width = COPY_SIZE;
+			list[i].height = COPY_SIZE;
+			list[i].dst = &dst;
+			list[i].dst_x = list[i].src_x;
+			list[i].dst_y = list[i].src_y;
+		}
+
+		intel_mock_gem_get_stats(fd, &stats);
+		bytes = 0;
+		start_time = get_cpu_time();
+		for (i = 0; i < count; i += LIST_SIZE) {
+			copylist(batch, list, LIST_SIZE);
+			bytes += batch->upload_size;
+		}
+		report("list", fd, i, get_cpu_time() - start_time, &stats,
+		       bytes);
+	}
+
+	intel_mock_gem_get_stats(fd, &stats);
+	bytes = 0;
+	start_time = get_cpu_time();
+	for (i = 0; i < count; i++) {
+		intel_copy_bo(batch, dst.bo, src.bo, WIDTH, COPY_SIZE);
+		bytes += batch->upload_size;
+	}
+	report("blit", fd, count, get_cpu_time() - start_time, &stats, bytes);
+
+	drm_intel_bo_unreference(src.bo);
+	drm_intel_bo_unreference(dst.bo);
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	close(fd);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t devid = 0;
+	int count = 10000, opt, relocs = 0;
+	unsigned i;
+
+	while ((opt = getopt(argc, argv, "g:n:r")) != -1) {
+		switch (opt) {
+		case 'g':
+			devid = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'r':
+			relocs = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-g devid] [-n copies] [-r]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	printf("mock device: CPU time only, no GPU or kernel execbuffer cost\n");
+
+	if (devid) {
+		run_device(devid, count, relocs);
+		return 0;
+	}
+
+	for (i = 0; i < sizeof(default_devids) / sizeof(default_devids[0]); i++)
+		run_device(default_devids[i], count, relocs);
+
+	return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * Compares initialising a surface to a solid colour on the GPU, with the
+ * render fill function (the blitter before gen6), against filling a buffer
+ * on the CPU and uploading it with pwrite as the tests used to do.
+ *
+ * "clear" fills the whole surface with one rectangle, "rects" covers it
+ * with 64x64 rectangles in a single call to measure the per-rectangle cost.
+ * Each mode waits for the GPU once, after its last pass, so the times
+ * include the GPU work but let it overlap with submitting the next passes.
+ * -g runs against the mock GEM device instead, where only the CPU side is
+ * measured.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "rendercopy.h"
+#include "intel_mock_gem.h"
+
+#define RECT_SIZE 64
+
+static double
+get_time_in_secs(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (double)tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static void
+report(const char *what, int size, int count, double elapsed)
+{
+	printf("%-6s: %.03f msecs/fill, %.01f MB/sec\n", what,
+	       1e3 * elapsed / count,
+	       (double)count * size * size * 4 / 1024.0 / 1024.0 / elapsed);
+}
+
+int main(int argc, char **argv)
+{
+	drm_intel_bufmgr *bufmgr;
+	struct intel_batchbuffer *batch;
+	struct scratch_buf buf;
+	struct render_rect *rects;
+	render_fillfunc_t fill;
+	uint32_t devid = 0, tiling = I915_TILING_NONE, *data;
+	int size = 2048, count = 100, num_rects;
+	double start_time;
+	int fd, opt, i, x, y;
+
+	while ((opt = getopt(argc, argv, "g:n:s:x")) != -1) {
+		switch (opt) {
+		case 'g':
+			devid = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 's':
+			size = atoi(optarg);
+			break;
+		case 'x':
+			tiling = I915_TILING_X;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-g mock devid] [-n passes] [-s size] [-x]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (devid)
+		intel_mock_gem_enable(devid);
+	fd = drm_open_any();
+	devid = intel_get_drm_devid(fd);
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	batch = intel_batchbuffer_alloc(bufmgr, devid);
+	intel_batchbuffer_set_exec_fd(batch, fd);
+
+	memset(&buf, 0, sizeof(buf));
+	buf.bo = drm_intel_bo_alloc(bufmgr, "surface", size * size * 4, 4096);
+	buf.stride = size * 4;
+	buf.size = size * size * 4;
+	if (tiling != I915_TILING_NONE)
+		drm_intel_bo_set_tiling(buf.bo, &tiling, buf.stride);
+	buf.tiling = tiling;
+
+	data = malloc(buf.size);
+	num_rects = (size / RECT_SIZE) * (size / RECT_SIZE);
+	rects = malloc(num_rects * sizeof(*rects));
+	for (i = 0, y = 0; y + RECT_SIZE <= size; y += RECT_SIZE) {
+		for (x = 0; x + RECT_SIZE <= size; x += RECT_SIZE, i++) {
+			rects[i].x = x;
+			rects[i].y = y;
+			rects[i].width = RECT_SIZE;
+			rects[i].height = RECT_SIZE;
+		}
+	}
+
+	printf("0x%04x (gen%d), %dx%d %s\n", devid, intel_gen(devid),
+	       size, size, tiling ? "X-tiled" : "linear");
+
+	start_time = get_time_in_secs();
+	for (i = 0; i < count; i++) {
+		uint32_t *p = data, n = size * size;
+
+		while (n--)
+			*p++ = i;
+		do_or_die(drm_intel_bo_subdata(buf.bo, 0, buf.size, data));
+	}
+	drm_intel_bo_wait_rendering(buf.bo);
+	report("cpu", size, count, get_time_in_secs() - start_time);
+
+	start_time = get_time_in_secs();
+	for (i = 0; i < count; i++)
+		render_clear(batch, &buf, i);
+	drm_intel_bo_wait_rendering(buf.bo);
+	report("clear", size, count, get_time_in_secs() - start_time);
+
+	fill = get_render_fillfunc(devid);
+	start_time = get_time_in_secs();
+	for (i = 0; i < count; i++)
+		fill(batch, &buf, rects, num_rects, i);
+	drm_intel_bo_wait_rendering(buf.bo);
+	report("rects", size, count, get_time_in_secs() - start_time);
+
+	free(rects);
+	free(data);
+	drm_intel_bo_unreference(buf.bo);
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * Measures the CPU tiling and detiling functions in GB/s, for every tiling
+ * layout and swizzle mode and each implementation the CPU supports.  Both
+ * sides are plain malloc'ed memory, so no GPU is needed; the numbers are an
+ * upper bound for copies through a CPU mmap of a bo.  The _17 swizzle modes
+ * use random page addresses.  That is with one thread; the second table
+ * shows how the default implementation scales from 1 to -t threads.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "intel_tiling.h"
+
+static const struct {
+	const char *name;
+	uint32_t tiling;
+	int gen;
+} layouts[] = {
+	{ "X", I915_TILING_X, 0 },
+	{ "Y", I915_TILING_Y, 0 },
+	{ "gen2 X", I915_TILING_X, 2 },
+};
+
+static const struct {
+	const char *name;
+	uint32_t swizzle;
+} swizzles[] = {
+	{ "none", I915_BIT_6_SWIZZLE_NONE },
+	{ "bit9", I915_BIT_6_SWIZZLE_9 },
+	{ "bit9^10", I915_BIT_6_SWIZZLE_9_10 },
+	{ "bit9^11", I915_BIT_6_SWIZZLE_9_11 },
+	{ "bit9^10^11", I915_BIT_6_SWIZZLE_9_10_11 },
+	{ "bit9^17", I915_BIT_6_SWIZZLE_9_17 },
+	{ "bit9^10^17", I915_BIT_6_SWIZZLE_9_10_17 },
+};
+
+static double
+get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+	struct intel_tiled_surface surf;
+	uint32_t stride = 4096, height = 4096, size;
+	uint8_t *linear, *bit17;
+	double start_time, to_tiled, from_tiled;
+	int count = 10, opt, i, l, s, impl, best = 0;
+	int threads = sysconf(_SC_NPROCESSORS_ONLN), t;
+
+	while ((opt = getopt(argc, argv, "n:s:h:t:")) != -1) {
+		switch (opt) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 's':
+			stride = atoi(optarg);
+			break;
+		case 'h':
+			height = atoi(optarg);
+			break;
+		case 't':
+			threads = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n passes] [-s stride in bytes] [-h height] [-t max threads]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	/* whole tiles in every layout */
+	stride = (stride + 511) & ~511;
+	height = (height + 31) & ~31;
+	size = stride * height;
+
+	memset(&surf, 0, sizeof(surf));
+	surf.stride = stride;
+	if (posix_memalign(&surf.ptr, 4096, size) ||
+	    posix_memalign((void **)&linear, 4096, size))
+		return 1;
+	memset(surf.ptr, 0, size);
+	memset(linear, 0x5a, size);
+
+	bit17 = malloc(size / 4096);
+	for (i = 0; i < size / 4096; i++)
+		bit17[i] = random();
+
+	if (threads < 1)
+		threads = 1;
+	intel_tiling_set_threads(1);
+
+	printf("%ux%u bytes, %d passes, GB/s tile/detile\n", stride, height, count);
+	printf("%-7s %-11s", "", "");
+	for (impl = 0; impl < INTEL_TILING_NUM_IMPLS; impl++) {
+		if (intel_tiling_set_impl(impl) == 0) {
+			printf(" %13s", intel_tiling_impl_name(impl));
+			best = impl;
+		}
+	}
+	printf("\n");
+
+	for (l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+		for (s = 0; s < sizeof(swizzles) / sizeof(swizzles[0]); s++) {
+			/* gen2 doesn't swizzle */
+			if (layouts[l].gen == 2 && s)
+				continue;
+
+			surf.tiling = layouts[l].tiling;
+			surf.gen = layouts[l].gen;
+			surf.swizzle = swizzles[s].swizzle;
+			surf.bit17 = bit17;
+
+			printf("%-7s %-11s", layouts[l].name, swizzles[s].name);
+			for (impl = 0; impl < INTEL_TILING_NUM_IMPLS; impl++) {
+				if (intel_tiling_set_impl(impl))
+					continue;
+
+				start_time = get_time();
+				for (i = 0; i < count; i++)
+					intel_linear_to_tiled(&surf, 0, 0,
+							      linear, stride,
+							      stride, height);
+				to_tiled = get_time() - start_time;
+
+				start_time = get_time();
+				for (i = 0; i < count; i++)
+					intel_tiled_to_linear(linear, stride,
+							      &surf, 0, 0,
+							      stride, height);
+				from_tiled = get_time() - start_time;
+
+				printf("   %5.2f/%5.2f",
+				       (double)count * size / to_tiled / 1e9,
+				       (double)count * size / from_tiled / 1e9);
+			}
+			printf("\n");
+		}
+	}
+
+	intel_tiling_set_impl(best);
+	printf("\n%s, no swizzling, GB/s tile/detile\n",
+	       intel_tiling_impl_name(best));
+	printf("%-7s", "threads");
+	for (l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++)
+		printf(" %13s", layouts[l].name);
+	printf("\n");
+
+	for (t = 1; t <= threads; t++) {
+		intel_tiling_set_threads(t);
+
+		printf("%-7d", t);
+		for (l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+			surf.tiling = layouts[l].tiling;
+			surf.gen = layouts[l].gen;
+			surf.swizzle = I915_BIT_6_SWIZZLE_NONE;
+			surf.bit17 = NULL;
+
+			start_time = get_time();
+			for (i = 0; i < count; i++)
+				intel_linear_to_tiled(&surf, 0, 0,
+						      linear, stride,
+						      stride, height);
+			to_tiled = get_time() - start_time;
+
+			start_time = get_time();
+			for (i = 0; i < count; i++)
+				intel_tiled_to_linear(linear, stride,
+						      &surf, 0, 0,
+						      stride, height);
+			from_tiled = get_time() - start_time;
+
+			printf("   %5.2f/%5.2f",
+			       (double)count * size / to_tiled / 1e9,
+			       (double)count * size / from_tiled / 1e9);
+		}
+		printf("\n");
+	}
+
+	free(bit17);
+	free(linear);
+	free(surf.ptr);
+
+	return 0;
+}
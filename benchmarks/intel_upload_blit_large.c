@@ -58,6 +58,7 @@
 #include "drmtest.h"
 #include "intel_bufmgr.h"
 #include "intel_batchbuffer.h"
+#include "intel_batch_packets.h"
 #include "intel_gpu_tools.h"
 
 #define OBJECT_WIDTH	1280
@@ -77,6 +78,8 @@ static void
 do_render(drm_intel_bufmgr *bufmgr, struct intel_batchbuffer *batch,
 	  drm_intel_bo *dst_bo, int width, int height)
 {
+	struct xy_src_copy_blt blt;
+	uint32_t offset;
 	uint32_t data[width * height];
 	drm_intel_bo *src_bo;
 	int i;
@@ -94,20 +97,23 @@ do_render(drm_intel_bufmgr *bufmgr, struct intel_batchbuffer *batch,
 	drm_intel_bo_subdata(src_bo, 0, sizeof(data), data);
 
 	/* Render the junk to the dst. */
-	BEGIN_BATCH(8);
-	OUT_BATCH(XY_SRC_COPY_BLT_CMD |
-		  XY_SRC_COPY_BLT_WRITE_ALPHA |
-		  XY_SRC_COPY_BLT_WRITE_RGB);
-	OUT_BATCH((3 << 24) | /* 32 bits */
-		  (0xcc << 16) | /* copy ROP */
-		  (width * 4) /* dst pitch */);
-	OUT_BATCH(0); /* dst x1,y1 */
-	OUT_BATCH((height << 16) | width); /* dst x2,y2 */
-	OUT_RELOC(dst_bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
-	OUT_BATCH(0); /* src x1,y1 */
-	OUT_BATCH(width * 4); /* src pitch */
-	OUT_RELOC(src_bo, I915_GEM_DOMAIN_RENDER, 0, 0);
-	ADVANCE_BATCH();
+	blt = (struct xy_src_copy_blt) {
+		.cmd = XY_SRC_COPY_BLT_CMD |
+		       XY_SRC_COPY_BLT_WRITE_ALPHA |
+		       XY_SRC_COPY_BLT_WRITE_RGB,
+		.br13 = (3 << 24) | /* 32 bits */
+			(0xcc << 16) | /* copy ROP */
+			(width * 4) /* dst pitch */,
+		.dst_x1y1 = BLT_XY(0, 0),
+		.dst_x2y2 = BLT_XY(width, height),
+		.src_x1y1 = BLT_XY(0, 0),
+		.src_pitch = width * 4,
+	};
+	offset = OUT_PACKET(blt);
+	OUT_PACKET_RELOC(offset, blt, dst, dst_bo,
+			 I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+	OUT_PACKET_RELOC(offset, blt, src, src_bo,
+			 I915_GEM_DOMAIN_RENDER, 0, 0);
 
 	intel_batchbuffer_flush(batch);
 
@@ -130,6 +136,7 @@ int main(int argc, char **argv)
 	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
 
 	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+	intel_batchbuffer_set_exec_fd(batch, fd);
 
 	dst_bo = drm_intel_bo_alloc(bufmgr, "dst", object_size, 4096);
 
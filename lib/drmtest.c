@@ -54,7 +54,7 @@ gem_handle_to_libdrm_bo(drm_intel_bufmgr *bufmgr, int fd, const char *name, uint
 	drm_intel_bo *bo;
 
 	flink.handle = handle;
-	ret = ioctl(fd, DRM_IOCTL_GEM_FLINK, &flink);
+	ret = drmIoctl(fd, DRM_IOCTL_GEM_FLINK, &flink);
 	assert(ret == 0);
 
 	bo = drm_intel_bo_gem_create_from_name(bufmgr, name, flink.name);
@@ -72,7 +72,7 @@ is_intel(int fd)
 	gp.param = I915_PARAM_CHIPSET_ID;
 	gp.value = &devid;
 
-	if (ioctl(fd, DRM_IOCTL_I915_GETPARAM, &gp, sizeof(gp)))
+	if (drmIoctl(fd, DRM_IOCTL_I915_GETPARAM, &gp))
 		return 0;
 
 	return IS_INTEL(devid);
@@ -86,12 +86,48 @@ bool gem_uses_aliasing_ppgtt(int fd)
 	gp.param = 18; /* HAS_ALIASING_PPGTT */
 	gp.value = &val;
 
-	if (ioctl(fd, DRM_IOCTL_I915_GETPARAM, &gp, sizeof(gp)))
+	if (drmIoctl(fd, DRM_IOCTL_I915_GETPARAM, &gp))
 		return 0;
 
 	return val;
 }
 
+bool gem_has_llc(int fd)
+{
+	struct drm_i915_getparam gp;
+	int val;
+
+	gp.param = I915_PARAM_HAS_LLC;
+	gp.value = &val;
+
+	if (drmIoctl(fd, DRM_IOCTL_I915_GETPARAM, &gp))
+		return 0;
+
+	return val;
+}
+
+#define LOCAL_I915_PARAM_HAS_EXEC_NO_RELOC	25
+#define LOCAL_I915_PARAM_HAS_EXEC_HANDLE_LUT	26
+
+/* Whether execbuffer2 takes both I915_EXEC_NO_RELOC and I915_EXEC_HANDLE_LUT. */
+bool gem_has_exec_lut(int fd)
+{
+	struct drm_i915_getparam gp;
+	int val = 0;
+
+	gp.param = LOCAL_I915_PARAM_HAS_EXEC_NO_RELOC;
+	gp.value = &val;
+	if (drmIoctl(fd, DRM_IOCTL_I915_GETPARAM, &gp) || !val)
+		return false;
+
+	val = 0;
+	gp.param = LOCAL_I915_PARAM_HAS_EXEC_HANDLE_LUT;
+	if (drmIoctl(fd, DRM_IOCTL_I915_GETPARAM, &gp))
+		return false;
+
+	return val;
+}
+
 int gem_available_fences(int fd)
 {
 	struct drm_i915_getparam gp;
@@ -100,7 +136,7 @@ int gem_available_fences(int fd)
 	gp.param = I915_PARAM_NUM_FENCES_AVAIL;
 	gp.value = &val;
 
-	if (ioctl(fd, DRM_IOCTL_I915_GETPARAM, &gp, sizeof(gp)))
+	if (drmIoctl(fd, DRM_IOCTL_I915_GETPARAM, &gp))
 		return 0;
 
 	return val;
@@ -209,11 +245,30 @@ int drm_get_card(int master)
 	return i;
 }
 
+/*
+ * Only programs linked with libintel_mock_gem have these, and only they get
+ * its drmIoctl() in place of libdrm's, see intel_mock_gem.h.
+ */
+extern uint32_t intel_mock_gem_enabled(void) __attribute__((weak));
+extern int intel_mock_gem_open(uint32_t devid) __attribute__((weak));
+
 /** Open the first DRM device we can find, searching up to 16 device nodes */
 int drm_open_any(void)
 {
 	char *name;
 	int ret, fd;
+	uint32_t devid = 0;
+
+	if (intel_mock_gem_enabled)
+		devid = intel_mock_gem_enabled();
+	if (devid) {
+		fd = intel_mock_gem_open(devid);
+		if (fd == -1)
+			fprintf(stderr, "failed to create a mock device for 0x%04x: %s\n",
+				devid, strerror(errno));
+		assert(fd >= 0);
+		return fd;
+	}
 
 	ret = asprintf(&name, "/dev/dri/card%d", drm_get_card(0));
 	if (ret == -1)
@@ -263,12 +318,27 @@ void gem_set_tiling(int fd, uint32_t handle, int tiling, int stride)
 		st.tiling_mode = tiling;
 		st.stride = tiling ? stride : 0;
 
-		ret = ioctl(fd, DRM_IOCTL_I915_GEM_SET_TILING, &st);
+		ret = drmIoctl(fd, DRM_IOCTL_I915_GEM_SET_TILING, &st);
 	} while (ret == -1 && (errno == EINTR || errno == EAGAIN));
 	assert(ret == 0);
 	assert(st.tiling_mode == tiling);
 }
 
+void gem_get_tiling(int fd, uint32_t handle, uint32_t *tiling, uint32_t *swizzle)
+{
+	struct drm_i915_gem_get_tiling get_tiling;
+	int ret;
+
+	memset(&get_tiling, 0, sizeof(get_tiling));
+	get_tiling.handle = handle;
+
+	ret = drmIoctl(fd, DRM_IOCTL_I915_GEM_GET_TILING, &get_tiling);
+	assert(ret == 0);
+
+	*tiling = get_tiling.tiling_mode;
+	*swizzle = get_tiling.swizzle_mode;
+}
+
 struct local_drm_i915_gem_cacheing {
 	uint32_t handle;
 	uint32_t cacheing;
@@ -291,7 +361,7 @@ int gem_has_cacheing(int fd)
 		return 0;
 
 	arg.cacheing = 0;
-	ret = ioctl(fd, LOCAL_DRM_IOCTL_I915_GEM_SET_CACHEING, &arg);
+	ret = drmIoctl(fd, LOCAL_DRM_IOCTL_I915_GEM_SET_CACHEING, &arg);
 	gem_close(fd, arg.handle);
 
 	return ret == 0;
@@ -304,7 +374,7 @@ void gem_set_cacheing(int fd, uint32_t handle, int cacheing)
 
 	arg.handle = handle;
 	arg.cacheing = cacheing;
-	ret = ioctl(fd, LOCAL_DRM_IOCTL_I915_GEM_SET_CACHEING, &arg);
+	ret = drmIoctl(fd, LOCAL_DRM_IOCTL_I915_GEM_SET_CACHEING, &arg);
 	assert(ret == 0);
 }
 
@@ -315,7 +385,7 @@ int gem_get_cacheing(int fd, uint32_t handle)
 
 	arg.handle = handle;
 	arg.cacheing = 0;
-	ret = ioctl(fd, LOCAL_DRM_IOCTL_I915_GEM_GET_CACHEING, &arg);
+	ret = drmIoctl(fd, LOCAL_DRM_IOCTL_I915_GEM_GET_CACHEING, &arg);
 	assert(ret == 0);
 
 	return arg.cacheing;
@@ -725,7 +795,7 @@ paint_allocate_surface(int fd, int width, int height, int depth, int bpp,
 		set_tiling.handle = fb_info->gem_handle;
 		set_tiling.tiling_mode = I915_TILING_X;
 		set_tiling.stride = stride;
-		if (ioctl(fd, DRM_IOCTL_I915_GEM_SET_TILING, &set_tiling)) {
+		if (drmIoctl(fd, DRM_IOCTL_I915_GEM_SET_TILING, &set_tiling)) {
 			fprintf(stderr, "set tiling failed: %s (stride=%d, size=%d)\n",
 				strerror(errno), stride, size);
 			return NULL;
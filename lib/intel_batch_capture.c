@@ -0,0 +1,381 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "intel_batchbuffer.h"
+#include "intel_batch_capture.h"
+
+/* Submission only blocks once the writer falls this far behind. */
+#define CAPTURE_MAX_QUEUED	(64 << 20)
+
+/* How long a fatal signal waits for the writer to drain the queue. */
+#define CAPTURE_DRAIN_MS	2000
+
+struct capture_record {
+	struct capture_record *next;
+	size_t len;
+	char data[];
+};
+
+/*
+ * The capture matters most when the test dies, so the fatal signals drain
+ * the queue before the default action runs.  The writer is woken through a
+ * semaphore rather than a condition variable for that, sem_post() being
+ * async-signal-safe.
+ */
+#define CAPTURE_NUM_SIGNALS	8
+
+static const int capture_signals[CAPTURE_NUM_SIGNALS] = {
+	SIGABRT, SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGTERM, SIGINT, SIGQUIT,
+};
+
+static struct {
+	pthread_once_t once;
+	pthread_mutex_t lock;
+	sem_t more;		/* a record was queued or stop was set */
+	pthread_cond_t space;	/* the writer drained some records */
+
+	int fd;			/* -1 when not capturing */
+	pid_t pid;		/* forked children don't capture */
+	pthread_t thread;
+
+	struct capture_record *head, **tail;
+	size_t queued;
+	int stop;
+
+	/* records queued and written so far, for the signal handler */
+	volatile unsigned long num_queued, num_written;
+	struct sigaction old_actions[CAPTURE_NUM_SIGNALS];
+
+	int header_written;
+	uint64_t seqno;
+
+	drm_intel_context **contexts;
+	int num_contexts;
+} capture = {
+	.once = PTHREAD_ONCE_INIT,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.space = PTHREAD_COND_INITIALIZER,
+	.fd = -1,
+};
+
+static void
+write_record(struct capture_record *rec)
+{
+	const char *data = rec->data;
+	size_t len = rec->len;
+	ssize_t ret;
+
+	while (len) {
+		ret = write(capture.fd, data, len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			fprintf(stderr, "batch capture: write failed: %s\n",
+				strerror(errno));
+			return;
+		}
+		data += ret;
+		len -= ret;
+	}
+}
+
+static void *
+capture_thread(void *data)
+{
+	struct capture_record *list, *rec;
+	unsigned long count;
+	size_t written;
+	sigset_t set;
+	unsigned int i;
+	int stop;
+
+	/* Leave the asynchronous signals to the threads that can wait for
+	 * this one in the handler. */
+	sigemptyset(&set);
+	for (i = 0; i < CAPTURE_NUM_SIGNALS; i++)
+		sigaddset(&set, capture_signals[i]);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	do {
+		while (sem_wait(&capture.more) && errno == EINTR)
+			;
+
+		pthread_mutex_lock(&capture.lock);
+		list = capture.head;
+		capture.head = NULL;
+		capture.tail = &capture.head;
+		stop = capture.stop;
+		pthread_mutex_unlock(&capture.lock);
+
+		written = 0;
+		count = 0;
+		while (list) {
+			rec = list;
+			list = rec->next;
+			write_record(rec);
+			written += rec->len;
+			count++;
+			free(rec);
+		}
+
+		pthread_mutex_lock(&capture.lock);
+		capture.queued -= written;
+		capture.num_written += count;
+		pthread_cond_broadcast(&capture.space);
+		pthread_mutex_unlock(&capture.lock);
+	} while (!stop);
+
+	return NULL;
+}
+
+static void
+capture_signal(int sig)
+{
+	unsigned long target = capture.num_queued;
+	struct timespec ts = { 0, 1000000 };
+	unsigned int i;
+	int ms;
+
+	if (capture.pid == getpid()) {
+		sem_post(&capture.more);
+		for (ms = 0; ms < CAPTURE_DRAIN_MS; ms++) {
+			if (capture.num_written >= target)
+				break;
+			nanosleep(&ts, NULL);
+		}
+	}
+
+	for (i = 0; i < CAPTURE_NUM_SIGNALS; i++)
+		if (capture_signals[i] == sig)
+			sigaction(sig, &capture.old_actions[i], NULL);
+	raise(sig);
+}
+
+static void
+install_signal_handlers(void)
+{
+	struct sigaction sa;
+	unsigned int i;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = capture_signal;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESETHAND;
+
+	/* Don't get in the way of handlers the program set up itself. */
+	for (i = 0; i < CAPTURE_NUM_SIGNALS; i++) {
+		sigaction(capture_signals[i], NULL, &capture.old_actions[i]);
+		if (capture.old_actions[i].sa_handler == SIG_DFL)
+			sigaction(capture_signals[i], &sa, NULL);
+	}
+}
+
+static void
+capture_fini(void)
+{
+	if (capture.pid != getpid())
+		return;
+
+	pthread_mutex_lock(&capture.lock);
+	capture.stop = 1;
+	pthread_mutex_unlock(&capture.lock);
+	sem_post(&capture.more);
+
+	pthread_join(capture.thread, NULL);
+	close(capture.fd);
+	capture.fd = -1;
+}
+
+static void
+capture_init(void)
+{
+	const char *path = getenv("INTEL_BATCH_CAPTURE");
+	int fd;
+
+	if (!path || !*path)
+		return;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (fd < 0) {
+		fprintf(stderr, "batch capture: failed to open %s: %s\n",
+			path, strerror(errno));
+		return;
+	}
+
+	capture.tail = &capture.head;
+	capture.pid = getpid();
+	capture.fd = fd;
+	sem_init(&capture.more, 0, 0);
+
+	if (pthread_create(&capture.thread, NULL, capture_thread, NULL)) {
+		fprintf(stderr, "batch capture: failed to start the writer\n");
+		close(fd);
+		capture.fd = -1;
+		return;
+	}
+
+	atexit(capture_fini);
+	install_signal_handlers();
+}
+
+/* Called with the lock held. */
+static void
+queue_record(struct capture_record *rec)
+{
+	while (capture.queued > CAPTURE_MAX_QUEUED)
+		pthread_cond_wait(&capture.space, &capture.lock);
+
+	rec->next = NULL;
+	*capture.tail = rec;
+	capture.tail = &rec->next;
+	capture.queued += rec->len;
+	capture.num_queued++;
+	sem_post(&capture.more);
+}
+
+static struct capture_record *
+record_alloc(size_t len)
+{
+	struct capture_record *rec;
+
+	rec = malloc(sizeof(*rec) + len);
+	if (rec)
+		rec->len = len;
+
+	return rec;
+}
+
+/* Called with the lock held. */
+static uint32_t
+context_id(drm_intel_context *context)
+{
+	drm_intel_context **tmp;
+	int i;
+
+	if (!context)
+		return 0;
+
+	for (i = 0; i < capture.num_contexts; i++)
+		if (capture.contexts[i] == context)
+			return i + 1;
+
+	tmp = realloc(capture.contexts, (i + 1) * sizeof(*tmp));
+	if (!tmp)
+		return ~0u;
+	capture.contexts = tmp;
+	capture.contexts[capture.num_contexts++] = context;
+
+	return i + 1;
+}
+
+/*
+ * Queue the batch about to be submitted on ring for writing to the capture
+ * file, if INTEL_BATCH_CAPTURE is set.  used is the length that will be
+ * executed, the record holds everything uploaded so that indirect state
+ * behind the commands is included too.
+ */
+void
+intel_batch_capture(struct intel_batchbuffer *batch, unsigned int used,
+		    int ring, drm_intel_context *context)
+{
+	struct intel_capture_batch *header;
+	struct intel_capture_reloc *relocs;
+	struct capture_record *rec;
+	unsigned int size;
+	int i;
+
+	pthread_once(&capture.once, capture_init);
+	if (capture.fd < 0 || capture.pid != getpid())
+		return;
+
+	size = batch->upload_size > used ? batch->upload_size : used;
+
+	rec = record_alloc(sizeof(*header) +
+			   batch->num_relocs * sizeof(*relocs) + size);
+	if (!rec)
+		return;
+
+	header = (struct intel_capture_batch *)rec->data;
+	memset(header, 0, sizeof(*header));
+	header->gtt_offset = batch->bo->offset;
+	header->size = size;
+	header->batch_len = used;
+	header->ring = ring;
+	header->num_relocs = batch->num_relocs;
+
+	relocs = (struct intel_capture_reloc *)(header + 1);
+	for (i = 0; i < batch->num_relocs; i++) {
+		struct intel_batchbuffer_reloc *reloc = &batch->relocs[i];
+
+		relocs[i].target_offset = reloc->presumed;
+		relocs[i].target_size = reloc->target->size;
+		relocs[i].offset = reloc->offset;
+		relocs[i].delta = reloc->delta;
+		relocs[i].target_handle = reloc->target->handle;
+		relocs[i].read_domains = reloc->read_domains;
+		relocs[i].write_domain = reloc->write_domain;
+		relocs[i].flags = reloc->fenced ? INTEL_CAPTURE_RELOC_FENCED : 0;
+	}
+
+	/* libdrm keeps the mapping around after unmap, so this is still
+	 * valid in the mapped modes. */
+	memcpy(relocs + batch->num_relocs, batch->buffer, size);
+
+	pthread_mutex_lock(&capture.lock);
+	if (!capture.header_written) {
+		struct capture_record *file_header;
+		struct intel_capture_header *h;
+
+		file_header = record_alloc(sizeof(*h));
+		if (!file_header) {
+			pthread_mutex_unlock(&capture.lock);
+			free(rec);
+			return;
+		}
+
+		h = (struct intel_capture_header *)file_header->data;
+		memset(h, 0, sizeof(*h));
+		h->magic = INTEL_CAPTURE_MAGIC;
+		h->version = INTEL_CAPTURE_VERSION;
+		h->devid = batch->devid;
+		queue_record(file_header);
+		capture.header_written = 1;
+	}
+
+	header->seqno = capture.seqno++;
+	header->context = context_id(context);
+	queue_record(rec);
+	pthread_mutex_unlock(&capture.lock);
+}
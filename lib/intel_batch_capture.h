@@ -0,0 +1,83 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_BATCH_CAPTURE_H
+#define INTEL_BATCH_CAPTURE_H
+
+#include <stdint.h>
+#include "intel_bufmgr.h"
+
+/*
+ * Capture of every batch submitted through intel_batchbuffer, enabled by
+ * setting INTEL_BATCH_CAPTURE=<file> in the environment.  Submission only
+ * copies the batch into a queue, a separate thread writes it out.  The
+ * queue is drained at exit and, unless the program handles them itself, on
+ * fatal signals, so the batches leading up to a crash make it to the file.
+ * Decode the result with intel_dump_decode.
+ *
+ * The file is a header followed by one record per batch: the batch header,
+ * its relocations and then the batch contents, all in host byte order.
+ */
+
+#define INTEL_CAPTURE_MAGIC	0x50414349	/* "ICAP" */
+#define INTEL_CAPTURE_VERSION	1
+
+struct intel_capture_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t devid;
+	uint32_t pad;
+};
+
+struct intel_capture_batch {
+	uint64_t seqno;		/* counts batches from 0 */
+	uint64_t gtt_offset;	/* presumed offset of the batch bo */
+	uint32_t size;		/* bytes of batch contents in the record */
+	uint32_t batch_len;	/* bytes actually executed */
+	uint32_t ring;		/* I915_EXEC_* ring selector */
+	uint32_t context;	/* 0 for the default context, others are
+				 * numbered in order of first use */
+	uint32_t num_relocs;
+	uint32_t pad;
+};
+
+#define INTEL_CAPTURE_RELOC_FENCED	(1 << 0)
+
+struct intel_capture_reloc {
+	uint64_t target_offset;	/* presumed offset written into the batch */
+	uint64_t target_size;
+	uint32_t offset;	/* in the batch */
+	uint32_t delta;
+	uint32_t target_handle;
+	uint32_t read_domains;
+	uint32_t write_domain;
+	uint32_t flags;
+};
+
+struct intel_batchbuffer;
+
+void intel_batch_capture(struct intel_batchbuffer *batch, unsigned int used,
+			 int ring, drm_intel_context *context);
+
+#endif /* INTEL_BATCH_CAPTURE_H */
@@ -0,0 +1,130 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_BATCH_PACKETS_H
+#define INTEL_BATCH_PACKETS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "intel_batchbuffer.h"
+#include "intel_reg.h"
+
+/*
+ * Command packets as structs, for building a whole packet in registers and
+ * writing it into the batch in one go with OUT_PACKET() instead of counting
+ * dwords by hand for BEGIN_BATCH().  Address fields are left zero and filled
+ * in by OUT_PACKET_RELOC() along with their relocation, e.g.
+ *
+ *	struct xy_color_blt blt = {
+ *		.cmd = XY_COLOR_BLT_CMD | XY_COLOR_BLT_WRITE_ALPHA | ...,
+ *		...
+ *	};
+ *	uint32_t offset = OUT_PACKET(blt);
+ *	OUT_PACKET_RELOC(offset, blt, dst, bo, I915_GEM_DOMAIN_RENDER,
+ *			 I915_GEM_DOMAIN_RENDER, 0);
+ *
+ * Each struct is checked against the dword length encoded in its opcode.
+ */
+
+#define INTEL_PACKET_CHECK(type, cmd, bias)				\
+	_Static_assert(sizeof(struct type) == 4 * (((cmd) & 0xff) + (bias)), \
+		       "struct " #type " does not match the length of " #cmd)
+
+struct mi_flush {
+	uint32_t cmd;
+} __attribute__((packed));
+_Static_assert(sizeof(struct mi_flush) == 4, "struct mi_flush is one dword");
+
+/* 965+ layout, with the reserved dword before the address */
+struct mi_store_dword_imm {
+	uint32_t cmd;
+	uint32_t reserved;
+	uint32_t addr;
+	uint32_t value;
+} __attribute__((packed));
+INTEL_PACKET_CHECK(mi_store_dword_imm, MI_STORE_DWORD_IMM, 2);
+
+struct xy_setup_clip_blt {
+	uint32_t cmd;
+	uint32_t clip_x1y1;
+	uint32_t clip_x2y2;
+} __attribute__((packed));
+INTEL_PACKET_CHECK(xy_setup_clip_blt, XY_SETUP_CLIP_BLT_CMD, 2);
+
+struct xy_color_blt {
+	uint32_t cmd;
+	uint32_t br13;		/* depth, ROP and dst pitch */
+	uint32_t dst_x1y1;
+	uint32_t dst_x2y2;
+	uint32_t dst;
+	uint32_t color;
+} __attribute__((packed));
+INTEL_PACKET_CHECK(xy_color_blt, XY_COLOR_BLT_CMD, 2);
+
+struct xy_src_copy_blt {
+	uint32_t cmd;
+	uint32_t br13;		/* depth, ROP and dst pitch */
+	uint32_t dst_x1y1;
+	uint32_t dst_x2y2;
+	uint32_t dst;
+	uint32_t src_x1y1;
+	uint32_t src_pitch;
+	uint32_t src;
+} __attribute__((packed));
+INTEL_PACKET_CHECK(xy_src_copy_blt, XY_SRC_COPY_BLT_CMD, 2);
+
+#define BLT_XY(x, y) ((uint32_t)(y) << 16 | (uint16_t)(x))
+
+/* Returns the offset of the packet in the batch, for OUT_PACKET_RELOC(). */
+static inline uint32_t
+intel_batchbuffer_emit_packet(struct intel_batchbuffer *batch,
+			      const void *packet, unsigned int size)
+{
+	uint32_t offset;
+
+	intel_batchbuffer_require_space(batch, size);
+	offset = batch->ptr - batch->buffer;
+	memcpy(batch->ptr, packet, size);
+	batch->ptr += size;
+
+	return offset;
+}
+
+#define OUT_PACKET(packet) \
+	intel_batchbuffer_emit_packet(batch, &(packet), sizeof(packet))
+
+#define OUT_PACKET_RELOC(offset, packet, field, buf,			\
+			 read_domains, write_domain, delta)		\
+	intel_batchbuffer_emit_reloc_at(batch,				\
+					(offset) + offsetof(__typeof__(packet), field), \
+					buf, delta, read_domains, write_domain, 0)
+
+#define OUT_PACKET_RELOC_FENCED(offset, packet, field, buf,		\
+				read_domains, write_domain, delta)	\
+	intel_batchbuffer_emit_reloc_at(batch,				\
+					(offset) + offsetof(__typeof__(packet), field), \
+					buf, delta, read_domains, write_domain, 1)
+
+#endif /* INTEL_BATCH_PACKETS_H */
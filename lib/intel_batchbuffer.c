@@ -34,21 +34,138 @@
 #include "drm.h"
 #include "drmtest.h"
 #include "intel_batchbuffer.h"
+#include "intel_batch_packets.h"
+#include "intel_batch_capture.h"
 #include "intel_bufmgr.h"
 #include "intel_chipset.h"
 #include "intel_reg.h"
 #include <i915_drm.h>
 
+#define LOCAL_I915_EXEC_NO_RELOC	(1<<11)
+#define LOCAL_I915_EXEC_HANDLE_LUT	(1<<12)
+#define LOCAL_EXEC_OBJECT_WRITE		(1<<2)
+
+static drm_intel_bo *
+pool_get(struct intel_batchbuffer *batch)
+{
+	drm_intel_bo *bo;
+
+	if (batch->pool_max == 0) {
+		batch->pool_allocs++;
+		return drm_intel_bo_alloc(batch->bufmgr, "batchbuffer",
+					  batch->size, 4096);
+	}
+
+	if (batch->pool_count < batch->pool_max &&
+	    (batch->pool_count == 0 ||
+	     drm_intel_bo_busy(batch->pool[batch->pool_next]))) {
+		/* Insert in front of the oldest so the order is kept. */
+		memmove(&batch->pool[batch->pool_next + 1],
+			&batch->pool[batch->pool_next],
+			(batch->pool_count - batch->pool_next) *
+			sizeof(batch->pool[0]));
+		batch->pool_count++;
+
+		bo = drm_intel_bo_alloc(batch->bufmgr, "batchbuffer",
+					batch->size, 4096);
+		batch->pool_allocs++;
+	} else {
+		bo = batch->pool[batch->pool_next];
+		if (bo->size != batch->size) {
+			/* Left over from before the batch grew */
+			drm_intel_bo_unreference(bo);
+			bo = drm_intel_bo_alloc(batch->bufmgr, "batchbuffer",
+						batch->size, 4096);
+			batch->pool_allocs++;
+		} else {
+			if (drm_intel_bo_busy(bo)) {
+				drm_intel_bo_wait_rendering(bo);
+				batch->pool_waits++;
+			}
+			drm_intel_gem_bo_clear_relocs(bo, 0);
+			batch->pool_reuses++;
+		}
+	}
+
+	batch->pool[batch->pool_next] = bo;
+	batch->pool_next = (batch->pool_next + 1) % batch->pool_count;
+
+	drm_intel_bo_reference(bo);
+	return bo;
+}
+
+static void
+pool_fini(struct intel_batchbuffer *batch)
+{
+	int i;
+
+	for (i = 0; i < batch->pool_count; i++)
+		drm_intel_bo_unreference(batch->pool[i]);
+	batch->pool_count = 0;
+	batch->pool_next = 0;
+}
+
+static uint8_t *
+batch_map(struct intel_batchbuffer *batch, drm_intel_bo *bo)
+{
+	if (batch->mapping == INTEL_BATCH_CPU_MAP)
+		do_or_die(drm_intel_bo_map(bo, 1));
+	else
+		do_or_die(drm_intel_gem_bo_map_gtt(bo));
+
+	return bo->virtual;
+}
+
+/* Unmaps batch->bo, unless the upload at flush time already did. */
+static int
+batch_unmap(struct intel_batchbuffer *batch)
+{
+	if (!batch->mapped)
+		return 0;
+
+	batch->mapped = 0;
+	if (batch->mapping == INTEL_BATCH_CPU_MAP)
+		return drm_intel_bo_unmap(batch->bo);
+	else
+		return drm_intel_gem_bo_unmap_gtt(batch->bo);
+}
+
+/* On the execbuffer2 path the batch holds a reference to every target. */
+static void
+release_relocs(struct intel_batchbuffer *batch)
+{
+	int i;
+
+	if (batch->fd >= 0)
+		for (i = 0; i < batch->num_relocs; i++)
+			drm_intel_bo_unreference(batch->relocs[i].target);
+	batch->num_relocs = 0;
+
+	for (i = 0; i < batch->num_deps; i++)
+		drm_intel_bo_unreference(batch->deps[i]);
+	batch->num_deps = 0;
+	batch->deps_write = 0;
+}
+
 void
 intel_batchbuffer_reset(struct intel_batchbuffer *batch)
 {
+	release_relocs(batch);
+
 	if (batch->bo != NULL) {
+		batch_unmap(batch);
 		drm_intel_bo_unreference(batch->bo);
 		batch->bo = NULL;
 	}
 
-	batch->bo = drm_intel_bo_alloc(batch->bufmgr, "batchbuffer",
-				       BATCH_SZ, 4096);
+	batch->bo = pool_get(batch);
+
+	if (batch->mapping == INTEL_BATCH_STAGED) {
+		batch->buffer = batch->staging;
+	} else {
+		batch->buffer = batch_map(batch, batch->bo);
+		batch->mapped = 1;
+	}
 
 	batch->ptr = batch->buffer;
 }
@@ -60,6 +177,11 @@ intel_batchbuffer_alloc(drm_intel_bufmgr *bufmgr, uint32_t devid)
 
 	batch->bufmgr = bufmgr;
 	batch->devid = devid;
+	batch->size = batch->max_size = BATCH_SZ;
+	batch->pool_max = BATCH_POOL_SIZE;
+	batch->fd = -1;
+	batch->staging = malloc(batch->size);
+	assert(batch->staging);
 	intel_batchbuffer_reset(batch);
 
 	return batch;
@@ -68,19 +190,365 @@ intel_batchbuffer_alloc(drm_intel_bufmgr *bufmgr, uint32_t devid)
 void
 intel_batchbuffer_free(struct intel_batchbuffer *batch)
 {
+	release_relocs(batch);
+	batch_unmap(batch);
 	drm_intel_bo_unreference(batch->bo);
 	batch->bo = NULL;
+	pool_fini(batch);
+	if (batch->render_state)
+		drm_intel_bo_unreference(batch->render_state);
+	free(batch->relocs);
+	free(batch->exec_objects);
+	free(batch->exec_relocs);
+	free(batch->exec_bos);
+	free(batch->exec_lut);
+	free(batch->staging);
 	free(batch);
 }
 
+/*
+ * Choose between writing commands to a malloced staging buffer that is
+ * copied into the bo with pwrite at flush time (the default, which works
+ * everywhere), or straight into a mapping of the batch bo.  CPU maps are
+ * only coherent with the GPU on LLC parts, elsewhere use the GTT map.  Must
+ * be called while the batch is empty.
+ */
+void
+intel_batchbuffer_set_mapping(struct intel_batchbuffer *batch,
+			      enum intel_batchbuffer_mapping mapping)
+{
+	assert(batch->ptr == batch->buffer);
+
+	batch_unmap(batch);
+
+	if (mapping == INTEL_BATCH_STAGED) {
+		batch->staging = realloc(batch->staging, batch->size);
+		assert(batch->staging);
+		batch->buffer = batch->staging;
+	}
+
+	batch->mapping = mapping;
+	if (mapping != INTEL_BATCH_STAGED) {
+		batch->buffer = batch_map(batch, batch->bo);
+		batch->mapped = 1;
+	}
+
+	batch->ptr = batch->buffer;
+}
+
+/*
+ * Make the first used bytes of the batch visible to the GPU before
+ * submitting it.  Only the staged mode has anything to copy.
+ */
+int
+intel_batchbuffer_upload(struct intel_batchbuffer *batch, unsigned int used)
+{
+	batch->upload_size = used;
+
+	if (batch->mapping == INTEL_BATCH_STAGED)
+		return drm_intel_bo_subdata(batch->bo, 0, used, batch->buffer);
+
+	return batch_unmap(batch);
+}
+
+/*
+ * Set how many batch bos are kept around for reuse, at most BATCH_POOL_SIZE.
+ * 0 disables the pool and allocates a new bo for every batch.
+ */
+void
+intel_batchbuffer_set_pool_size(struct intel_batchbuffer *batch, int pool_max)
+{
+	assert(pool_max >= 0 && pool_max <= BATCH_POOL_SIZE);
+	pool_fini(batch);
+	batch->pool_max = pool_max;
+}
+
+/*
+ * Allow the batch to grow up to max_size bytes instead of being flushed
+ * every BATCH_SZ bytes, so that long command sequences end up in a single
+ * execbuffer.  The size reached is kept across flushes.  Relocations added
+ * with drm_intel_bo_emit_reloc() directly on batch->bo are not carried over
+ * when growing, so users doing that must leave this disabled.
+ */
+void
+intel_batchbuffer_set_max_size(struct intel_batchbuffer *batch,
+			       unsigned int max_size)
+{
+	assert(max_size >= BATCH_SZ);
+	batch->max_size = max_size;
+}
+
+/* Hand the recorded relocations over to libdrm for bo. */
+static void
+emit_drm_relocs(struct intel_batchbuffer *batch, drm_intel_bo *bo)
+{
+	int i;
+
+	for (i = 0; i < batch->num_relocs; i++) {
+		struct intel_batchbuffer_reloc *reloc = &batch->relocs[i];
+		int ret;
+
+		if (reloc->fenced)
+			ret = drm_intel_bo_emit_reloc_fence(bo, reloc->offset,
+							    reloc->target,
+							    reloc->delta,
+							    reloc->read_domains,
+							    reloc->write_domain);
+		else
+			ret = drm_intel_bo_emit_reloc(bo, reloc->offset,
+						      reloc->target,
+						      reloc->delta,
+						      reloc->read_domains,
+						      reloc->write_domain);
+		assert(ret == 0);
+	}
+}
+
+/*
+ * Submit batches on fd with an execbuffer2 object list built by the batch
+ * itself: relocations use HANDLE_LUT indices and NO_RELOC is set whenever
+ * every presumed offset written into the batch is still where the kernel
+ * last put the target, so the kernel can skip relocation processing
+ * entirely.  Returns false, leaving the batch on libdrm's relocation path,
+ * if the kernel does not support that.  fd = -1 forces libdrm's path, e.g.
+ * for comparison.  Must be called while the batch is empty.
+ */
+bool
+intel_batchbuffer_set_exec_fd(struct intel_batchbuffer *batch, int fd)
+{
+	assert(batch->ptr == batch->buffer && batch->num_relocs == 0);
+
+	if (fd >= 0 && !gem_has_exec_lut(fd))
+		fd = -1;
+	batch->fd = fd;
+
+	return fd >= 0;
+}
+
+static int
+exec_add(struct intel_batchbuffer *batch, drm_intel_bo *bo)
+{
+	unsigned int mask = batch->exec_lut_size - 1;
+	unsigned int h = bo->handle & mask;
+	int i;
+
+	while ((i = batch->exec_lut[h]) != 0) {
+		if (batch->exec_bos[i - 1] == bo)
+			return i - 1;
+		h = (h + 1) & mask;
+	}
+
+	i = batch->num_exec++;
+	batch->exec_lut[h] = i + 1;
+	batch->exec_bos[i] = bo;
+	memset(&batch->exec_objects[i], 0, sizeof(batch->exec_objects[i]));
+	batch->exec_objects[i].handle = bo->handle;
+	batch->exec_objects[i].offset = bo->offset;
+
+	return i;
+}
+
+static void
+exec_reserve(struct intel_batchbuffer *batch)
+{
+	int count = batch->num_relocs + 1;
+	unsigned int lut_size = 64;
+
+	if (count > batch->max_exec) {
+		while (batch->max_exec < count)
+			batch->max_exec = batch->max_exec ? 2 * batch->max_exec : 64;
+		batch->exec_objects = realloc(batch->exec_objects,
+					      batch->max_exec *
+					      sizeof(*batch->exec_objects));
+		batch->exec_bos = realloc(batch->exec_bos,
+					  batch->max_exec *
+					  sizeof(*batch->exec_bos));
+		assert(batch->exec_objects && batch->exec_bos);
+	}
+
+	if (batch->num_relocs > batch->max_exec_relocs) {
+		batch->max_exec_relocs = batch->max_relocs;
+		batch->exec_relocs = realloc(batch->exec_relocs,
+					     batch->max_exec_relocs *
+					     sizeof(*batch->exec_relocs));
+		assert(batch->exec_relocs);
+	}
+
+	/* Keep the handle hash at most half full. */
+	while (lut_size < 2 * (unsigned int)count)
+		lut_size *= 2;
+	if (lut_size > batch->exec_lut_size) {
+		free(batch->exec_lut);
+		batch->exec_lut = malloc(lut_size * sizeof(*batch->exec_lut));
+		assert(batch->exec_lut);
+		batch->exec_lut_size = lut_size;
+	}
+	memset(batch->exec_lut, 0, batch->exec_lut_size * sizeof(*batch->exec_lut));
+
+	batch->num_exec = 0;
+}
+
+static int
+exec_lut(struct intel_batchbuffer *batch, unsigned int used, int ring)
+{
+	struct drm_i915_gem_execbuffer2 execbuf;
+	struct drm_i915_gem_exec_object2 *obj;
+	int no_reloc = 1, i, idx;
+
+	exec_reserve(batch);
+
+	/* The batch has to be the last object, so add all the targets
+	 * first; relocations pointing back into the batch find it in the
+	 * lookup below. */
+	for (i = 0; i < batch->num_relocs; i++) {
+		struct intel_batchbuffer_reloc *reloc = &batch->relocs[i];
+
+		if (reloc->target == batch->bo)
+			continue;
+
+		idx = exec_add(batch, reloc->target);
+		if (reloc->fenced)
+			batch->exec_objects[idx].flags |= EXEC_OBJECT_NEEDS_FENCE;
+	}
+	obj = &batch->exec_objects[exec_add(batch, batch->bo)];
+
+	for (i = 0; i < batch->num_relocs; i++) {
+		struct intel_batchbuffer_reloc *reloc = &batch->relocs[i];
+		struct drm_i915_gem_relocation_entry *entry = &batch->exec_relocs[i];
+
+		entry->target_handle = exec_add(batch, reloc->target);
+		entry->offset = reloc->offset;
+		entry->delta = reloc->delta;
+		entry->presumed_offset = reloc->presumed;
+		entry->read_domains = reloc->read_domains;
+		entry->write_domain = reloc->write_domain;
+
+		/* With NO_RELOC the kernel doesn't look at the relocations at
+		 * all, this is the only way it learns what the GPU writes. */
+		if (reloc->write_domain)
+			batch->exec_objects[entry->target_handle].flags |=
+				LOCAL_EXEC_OBJECT_WRITE;
+
+		if (reloc->presumed != reloc->target->offset)
+			no_reloc = 0;
+	}
+	obj->relocation_count = batch->num_relocs;
+	obj->relocs_ptr = (uintptr_t)batch->exec_relocs;
+
+	memset(&execbuf, 0, sizeof(execbuf));
+	execbuf.buffers_ptr = (uintptr_t)batch->exec_objects;
+	execbuf.buffer_count = batch->num_exec;
+	execbuf.batch_len = used;
+	execbuf.flags = ring | LOCAL_I915_EXEC_HANDLE_LUT;
+	if (no_reloc) {
+		execbuf.flags |= LOCAL_I915_EXEC_NO_RELOC;
+		batch->exec_no_relocs++;
+	}
+
+	if (drmIoctl(batch->fd, DRM_IOCTL_I915_GEM_EXECBUFFER2, &execbuf))
+		return -errno;
+
+	/* Remember where everything ended up for the next batch. */
+	for (i = 0; i < batch->num_exec; i++)
+		batch->exec_bos[i]->offset = batch->exec_objects[i].offset;
+
+	return 0;
+}
+
+/*
+ * Submit the first used bytes of the batch, which must already have been
+ * uploaded, on ring.
+ */
+int
+intel_batchbuffer_exec(struct intel_batchbuffer *batch,
+		       unsigned int used, int ring)
+{
+	intel_batch_capture(batch, used, ring, NULL);
+
+	if (batch->fd >= 0)
+		return exec_lut(batch, used, ring);
+
+	return drm_intel_bo_mrb_exec(batch->bo, used, NULL, 0, 0, ring);
+}
+
+/*
+ * Make room for sz more bytes by doubling the batch, moving what has been
+ * emitted so far to a new bo along with its relocations.  Relocations
+ * pointing back into the batch itself follow it to the new bo.  Returns 0
+ * if the batch is already at max_size.
+ */
+int
+intel_batchbuffer_grow(struct intel_batchbuffer *batch, unsigned int sz)
+{
+	unsigned int used = batch->ptr - batch->buffer;
+	unsigned int size = batch->size;
+	drm_intel_bo *bo;
+	uint8_t *buffer;
+	int i;
+
+	/* Same room as intel_batchbuffer_space() keeps aside, including the
+	 * semaphore waits of the dependencies. */
+	sz += BATCH_RESERVED + 4 * batch->num_deps;
+
+	while (size - used < sz && size < batch->max_size)
+		size *= 2;
+	if (size > batch->max_size)
+		size = batch->max_size;
+	if (size == batch->size || size - used < sz)
+		return 0;
+
+	bo = drm_intel_bo_alloc(batch->bufmgr, "batchbuffer", size, 4096);
+	assert(bo);
+	if (batch->mapping == INTEL_BATCH_STAGED) {
+		buffer = batch->staging = realloc(batch->staging, size);
+		assert(buffer);
+	} else {
+		buffer = batch_map(batch, bo);
+		memcpy(buffer, batch->buffer, used);
+	}
+
+	for (i = 0; i < batch->num_relocs; i++) {
+		struct intel_batchbuffer_reloc *reloc = &batch->relocs[i];
+
+		if (reloc->target != batch->bo)
+			continue;
+
+		reloc->target = bo;
+		reloc->presumed = bo->offset;
+		*(uint32_t *)(buffer + reloc->offset) = bo->offset + reloc->delta;
+		if (batch->fd >= 0) {
+			drm_intel_bo_reference(bo);
+			drm_intel_bo_unreference(batch->bo);
+		}
+	}
+	if (batch->fd < 0)
+		emit_drm_relocs(batch, bo);
+
+	batch_unmap(batch);
+	drm_intel_bo_unreference(batch->bo);
+	batch->bo = bo;
+	batch->mapped = batch->mapping != INTEL_BATCH_STAGED;
+
+	if (batch->state)
+		batch->state = buffer + (batch->state - batch->buffer);
+	batch->ptr = buffer + used;
+	batch->buffer = buffer;
+	batch->size = size;
+
+	return 1;
+}
+
 #define CMD_POLY_STIPPLE_OFFSET       0x7906
 
 static unsigned int
 flush_on_ring_common(struct intel_batchbuffer *batch, int ring)
 {
 	unsigned int used = batch->ptr - batch->buffer;
+	int i;
 
-	if (used == 0)
+	/* A batch with only dependencies still has to be submitted, the rings
+	 * synchronised against it are waiting for it. */
+	if (used == 0 && batch->num_deps == 0)
 		return 0;
 
 	if (IS_GEN5(batch->devid)) {
@@ -100,7 +568,22 @@ flush_on_ring_common(struct intel_batchbuffer *batch, int ring)
 	/* Mark the end of the buffer. */
 	*(uint32_t *)(batch->ptr) = MI_BATCH_BUFFER_END; /* noop */
 	batch->ptr += 4;
-	return batch->ptr - batch->buffer;
+	used = batch->ptr - batch->buffer;
+
+	/* Dependencies live past the end, only their relocations matter. */
+	for (i = 0; i < batch->num_deps; i++) {
+		uint32_t write = batch->deps_write & (1 << i) ?
+			I915_GEM_DOMAIN_RENDER : 0;
+
+		intel_batchbuffer_emit_reloc_at(batch,
+						batch->ptr - batch->buffer,
+						batch->deps[i], 0,
+						I915_GEM_DOMAIN_RENDER, write,
+						0);
+		batch->ptr += 4;
+	}
+
+	return used;
 }
 
 void
@@ -111,11 +594,11 @@ intel_batchbuffer_flush_on_ring(struct intel_batchbuffer *batch, int ring)
 	if (used == 0)
 		return;
 
-	do_or_die(drm_intel_bo_subdata(batch->bo, 0, used, batch->buffer));
+	do_or_die(intel_batchbuffer_upload(batch, batch->ptr - batch->buffer));
 
 	batch->ptr = NULL;
 
-	do_or_die(drm_intel_bo_mrb_exec(batch->bo, used, NULL, 0, 0, ring));
+	do_or_die(intel_batchbuffer_exec(batch, used, ring));
 
 	intel_batchbuffer_reset(batch);
 }
@@ -130,11 +613,17 @@ intel_batchbuffer_flush_with_context(struct intel_batchbuffer *batch,
 	if (used == 0)
 		return;
 
-	ret = drm_intel_bo_subdata(batch->bo, 0, used, batch->buffer);
+	ret = intel_batchbuffer_upload(batch, batch->ptr - batch->buffer);
 	assert(ret == 0);
 
 	batch->ptr = NULL;
 
+	/* libdrm has no way to name the context for our own execbuffer. */
+	if (batch->fd >= 0)
+		emit_drm_relocs(batch, batch->bo);
+
+	intel_batch_capture(batch, used, I915_EXEC_RENDER, context);
+
 	ret = drm_intel_gem_bo_context_exec(batch->bo, context, used,
 					    I915_EXEC_RENDER);
 	assert(ret == 0);
@@ -145,8 +634,8 @@ intel_batchbuffer_flush_with_context(struct intel_batchbuffer *batch,
 void
 intel_batchbuffer_flush(struct intel_batchbuffer *batch)
 {
-	int ring = 0;
-	if (HAS_BLT_RING(batch->devid))
+	int ring = batch->ring;
+	if (ring == 0 && HAS_BLT_RING(batch->devid))
 		ring = I915_EXEC_BLT;
 	intel_batchbuffer_flush_on_ring(batch, ring);
 }
@@ -154,32 +643,106 @@ intel_batchbuffer_flush(struct intel_batchbuffer *batch)
 
 /*  This is the only way buffers get added to the validate list.
  */
+/*
+ * Relocate the dword at offset in the batch to point at buffer + delta,
+ * writing the presumed address into it.  The dword must already have been
+ * reserved, which lets whole packets and indirect state be emitted before
+ * their relocations.
+ */
 void
-intel_batchbuffer_emit_reloc(struct intel_batchbuffer *batch,
-                             drm_intel_bo *buffer, uint32_t delta,
-			     uint32_t read_domains, uint32_t write_domain,
-			     int fenced)
+intel_batchbuffer_emit_reloc_at(struct intel_batchbuffer *batch,
+				uint32_t offset,
+				drm_intel_bo *buffer, uint32_t delta,
+				uint32_t read_domains, uint32_t write_domain,
+				int fenced)
 {
+	struct intel_batchbuffer_reloc *reloc;
 	int ret;
 
-	if (batch->ptr - batch->buffer > BATCH_SZ)
-		printf("bad relocation ptr %p map %p offset %d size %d\n",
-		       batch->ptr, batch->buffer,
-		       (int)(batch->ptr - batch->buffer),
-		       BATCH_SZ);
+	assert(offset + 4 <= batch->size);
+
+	if (batch->num_relocs == batch->max_relocs) {
+		batch->max_relocs = batch->max_relocs ? 2 * batch->max_relocs : 64;
+		batch->relocs = realloc(batch->relocs,
+					batch->max_relocs * sizeof(*reloc));
+		assert(batch->relocs);
+	}
+	reloc = &batch->relocs[batch->num_relocs++];
+	reloc->target = buffer;
+	reloc->offset = offset;
+	reloc->delta = delta;
+	reloc->read_domains = read_domains;
+	reloc->write_domain = write_domain;
+	reloc->fenced = fenced;
+	reloc->presumed = buffer->offset;
+
+	*(uint32_t *)(batch->buffer + offset) = buffer->offset + delta;
+
+	if (batch->fd >= 0) {
+		drm_intel_bo_reference(buffer);
+		return;
+	}
 
 	if (fenced)
-		ret = drm_intel_bo_emit_reloc_fence(batch->bo, batch->ptr - batch->buffer,
+		ret = drm_intel_bo_emit_reloc_fence(batch->bo, offset,
 						    buffer, delta,
 						    read_domains, write_domain);
 	else
-		ret = drm_intel_bo_emit_reloc(batch->bo, batch->ptr - batch->buffer,
+		ret = drm_intel_bo_emit_reloc(batch->bo, offset,
 					      buffer, delta,
 					      read_domains, write_domain);
-	intel_batchbuffer_emit_dword(batch, buffer->offset + delta);
 	assert(ret == 0);
 }
 
+void
+intel_batchbuffer_emit_reloc(struct intel_batchbuffer *batch,
+                             drm_intel_bo *buffer, uint32_t delta,
+			     uint32_t read_domains, uint32_t write_domain,
+			     int fenced)
+{
+	if ((unsigned int)(batch->ptr - batch->buffer) > batch->size)
+		printf("bad relocation ptr %p map %p offset %d size %d\n",
+		       batch->ptr, batch->buffer,
+		       (int)(batch->ptr - batch->buffer),
+		       batch->size);
+
+	assert(intel_batchbuffer_space(batch) >= 4);
+	batch->ptr += 4;
+	intel_batchbuffer_emit_reloc_at(batch, batch->ptr - batch->buffer - 4,
+					buffer, delta,
+					read_domains, write_domain, fenced);
+}
+
+/*
+ * Make the next submission of the batch use bo, for writing if write is set,
+ * without the GPU ever accessing it.  The kernel then orders the submission
+ * against other rings using bo, which is how batches on different rings are
+ * synchronised.  Each dependency takes a dword after MI_BATCH_BUFFER_END to
+ * carry its relocation.
+ */
+void
+intel_batchbuffer_add_dependency(struct intel_batchbuffer *batch,
+				 drm_intel_bo *bo, int write)
+{
+	int i;
+
+	for (i = 0; i < batch->num_deps; i++) {
+		if (batch->deps[i] == bo) {
+			if (write)
+				batch->deps_write |= 1 << i;
+			return;
+		}
+	}
+
+	assert(batch->num_deps < BATCH_MAX_DEPS);
+	intel_batchbuffer_require_space(batch, 4);
+
+	drm_intel_bo_reference(bo);
+	if (write)
+		batch->deps_write |= 1 << batch->num_deps;
+	batch->deps[batch->num_deps++] = bo;
+}
+
 void
 intel_batchbuffer_data(struct intel_batchbuffer *batch,
                        const void *data, unsigned int bytes)
@@ -198,6 +761,8 @@ intel_copy_bo(struct intel_batchbuffer *batch,
 	uint32_t src_tiling, dst_tiling, swizzle;
 	uint32_t src_pitch, dst_pitch;
 	uint32_t cmd_bits = 0;
+	struct xy_src_copy_blt blt;
+	uint32_t offset;
 
 	drm_intel_bo_get_tiling(src_bo, &src_tiling, &swizzle);
 	drm_intel_bo_get_tiling(dst_bo, &dst_tiling, &swizzle);
@@ -214,21 +779,24 @@ intel_copy_bo(struct intel_batchbuffer *batch,
 		cmd_bits |= XY_SRC_COPY_BLT_DST_TILED;
 	}
 
-	BEGIN_BATCH(8);
-	OUT_BATCH(XY_SRC_COPY_BLT_CMD |
-		  XY_SRC_COPY_BLT_WRITE_ALPHA |
-		  XY_SRC_COPY_BLT_WRITE_RGB |
-		  cmd_bits);
-	OUT_BATCH((3 << 24) | /* 32 bits */
-		  (0xcc << 16) | /* copy ROP */
-		  dst_pitch);
-	OUT_BATCH(0); /* dst x1,y1 */
-	OUT_BATCH((height << 16) | width); /* dst x2,y2 */
-	OUT_RELOC(dst_bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
-	OUT_BATCH(0); /* src x1,y1 */
-	OUT_BATCH(src_pitch);
-	OUT_RELOC(src_bo, I915_GEM_DOMAIN_RENDER, 0, 0);
-	ADVANCE_BATCH();
+	blt = (struct xy_src_copy_blt) {
+		.cmd = XY_SRC_COPY_BLT_CMD |
+		       XY_SRC_COPY_BLT_WRITE_ALPHA |
+		       XY_SRC_COPY_BLT_WRITE_RGB |
+		       cmd_bits,
+		.br13 = (3 << 24) | /* 32 bits */
+			(0xcc << 16) | /* copy ROP */
+			dst_pitch,
+		.dst_x1y1 = BLT_XY(0, 0),
+		.dst_x2y2 = BLT_XY(width, height),
+		.src_x1y1 = BLT_XY(0, 0),
+		.src_pitch = src_pitch,
+	};
+	offset = OUT_PACKET(blt);
+	OUT_PACKET_RELOC(offset, blt, dst, dst_bo,
+			 I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+	OUT_PACKET_RELOC(offset, blt, src, src_bo,
+			 I915_GEM_DOMAIN_RENDER, 0, 0);
 
 	intel_batchbuffer_flush(batch);
 }
@@ -2,20 +2,94 @@
 #define INTEL_BATCHBUFFER_H
 
 #include <assert.h>
+#include <stdbool.h>
 #include "intel_bufmgr.h"
 
 #define BATCH_SZ 4096
 #define BATCH_RESERVED 16
+#define BATCH_POOL_SIZE 8
+#define BATCH_MAX_DEPS 8
+
+/* Relocations emitted through intel_batchbuffer_emit_reloc(), kept so that
+ * they can be moved over when the batch grows into a larger bo. */
+struct intel_batchbuffer_reloc {
+	drm_intel_bo *target;
+	uint32_t offset;
+	uint32_t delta;
+	uint32_t read_domains;
+	uint32_t write_domain;
+	uint32_t presumed;	/* target offset written into the batch */
+	int fenced;
+};
+
+/* Where commands are written before submission, see
+ * intel_batchbuffer_set_mapping(). */
+enum intel_batchbuffer_mapping {
+	INTEL_BATCH_STAGED,	/* malloced buffer, pwritten at flush */
+	INTEL_BATCH_CPU_MAP,	/* CPU mmap of the bo, for LLC parts */
+	INTEL_BATCH_GTT_MAP,	/* write-combined GTT mmap of the bo */
+};
 
 struct intel_batchbuffer {
 	drm_intel_bufmgr *bufmgr;
 	uint32_t devid;
 
+	/* Ring for intel_batchbuffer_flush(), which includes the implicit
+	 * flushes when the batch runs out of space.  0 picks blt where
+	 * there is one and render elsewhere. */
+	int ring;
+
 	drm_intel_bo *bo;
 
-	uint8_t buffer[BATCH_SZ];
+	enum intel_batchbuffer_mapping mapping;
+	int mapped;		/* bo is mapped at buffer */
+	uint8_t *staging;
+
+	uint8_t *buffer;
 	uint8_t *ptr;
 	uint8_t *state;
+
+	/* Current size of buffer and bo, and how far they may grow before
+	 * intel_batchbuffer_require_space() flushes instead. */
+	unsigned int size;
+	unsigned int max_size;
+
+	unsigned int upload_size;	/* bytes made visible by the last upload */
+
+	struct intel_batchbuffer_reloc *relocs;
+	int num_relocs, max_relocs;
+
+	/* Batch bos are recycled round robin, oldest first, once idle.  The
+	 * pool only grows up to pool_max when the oldest bo is still busy. */
+	drm_intel_bo *pool[BATCH_POOL_SIZE];
+	int pool_count, pool_next, pool_max;
+
+	unsigned long pool_allocs;	/* new bos allocated */
+	unsigned long pool_reuses;	/* idle bos reused */
+	unsigned long pool_waits;	/* stalls on a busy bo */
+
+	/* With an fd set, batches are submitted with our own execbuffer2
+	 * object list in HANDLE_LUT form instead of libdrm's, see
+	 * intel_batchbuffer_set_exec_fd(). */
+	int fd;
+	struct drm_i915_gem_exec_object2 *exec_objects;
+	struct drm_i915_gem_relocation_entry *exec_relocs;
+	drm_intel_bo **exec_bos;
+	int num_exec, max_exec, max_exec_relocs;
+	int *exec_lut;			/* handle hash -> exec index + 1 */
+	unsigned int exec_lut_size;
+
+	unsigned long exec_no_relocs;	/* submitted with NO_RELOC */
+
+	/* Invariant state and kernels of the gen6+ render copies, uploaded
+	 * on first use and shared by all later copies. */
+	drm_intel_bo *render_state;
+
+	/* Objects the next submission is ordered against without the GPU
+	 * touching them, see intel_batchbuffer_add_dependency(). */
+	drm_intel_bo *deps[BATCH_MAX_DEPS];
+	uint32_t deps_write;		/* bit i: deps[i] is written */
+	int num_deps;
 };
 
 struct intel_batchbuffer *intel_batchbuffer_alloc(drm_intel_bufmgr *bufmgr,
@@ -23,6 +97,19 @@ struct intel_batchbuffer *intel_batchbuffer_alloc(drm_intel_bufmgr *bufmgr,
 
 void intel_batchbuffer_free(struct intel_batchbuffer *batch);
 
+void intel_batchbuffer_set_max_size(struct intel_batchbuffer *batch,
+				    unsigned int max_size);
+int intel_batchbuffer_grow(struct intel_batchbuffer *batch, unsigned int sz);
+void intel_batchbuffer_set_pool_size(struct intel_batchbuffer *batch,
+				     int pool_max);
+void intel_batchbuffer_set_mapping(struct intel_batchbuffer *batch,
+				   enum intel_batchbuffer_mapping mapping);
+int intel_batchbuffer_upload(struct intel_batchbuffer *batch,
+			     unsigned int used);
+bool intel_batchbuffer_set_exec_fd(struct intel_batchbuffer *batch, int fd);
+int intel_batchbuffer_exec(struct intel_batchbuffer *batch,
+			   unsigned int used, int ring);
+
 
 void intel_batchbuffer_flush(struct intel_batchbuffer *batch);
 void intel_batchbuffer_flush_on_ring(struct intel_batchbuffer *batch, int ring);
@@ -40,17 +127,26 @@ void intel_batchbuffer_emit_reloc(struct intel_batchbuffer *batch,
 				  uint32_t read_domains,
 				  uint32_t write_domain,
 				  int fenced);
+void intel_batchbuffer_emit_reloc_at(struct intel_batchbuffer *batch,
+				     uint32_t offset,
+				     drm_intel_bo *buffer,
+				     uint32_t delta,
+				     uint32_t read_domains,
+				     uint32_t write_domain,
+				     int fenced);
+void intel_batchbuffer_add_dependency(struct intel_batchbuffer *batch,
+				      drm_intel_bo *bo, int write);
 
 /* Inline functions - might actually be better off with these
- * non-inlined.  Certainly better off switching all command packets to
- * be passed as structs rather than dwords, but that's a little bit of
- * work...
+ * non-inlined.  Command packets are better passed as structs rather
+ * than dwords, see intel_batch_packets.h.
  */
 #pragma GCC diagnostic ignored "-Winline"
 static inline int
 intel_batchbuffer_space(struct intel_batchbuffer *batch)
 {
-	return (BATCH_SZ - BATCH_RESERVED) - (batch->ptr - batch->buffer);
+	return (batch->size - BATCH_RESERVED - 4 * batch->num_deps) -
+		(batch->ptr - batch->buffer);
 }
 
 
@@ -62,13 +158,19 @@ intel_batchbuffer_emit_dword(struct intel_batchbuffer *batch, uint32_t dword)
 	batch->ptr += 4;
 }
 
-static inline void
+/* Returns true when room had to be made by flushing, which loses any state
+ * emitted into the batch so far. */
+static inline bool
 intel_batchbuffer_require_space(struct intel_batchbuffer *batch,
                                 unsigned int sz)
 {
-	assert(sz < BATCH_SZ - BATCH_RESERVED);
-	if (intel_batchbuffer_space(batch) < sz)
-		intel_batchbuffer_flush(batch);
+	assert(sz < batch->max_size - BATCH_RESERVED);
+	if (intel_batchbuffer_space(batch) >= sz ||
+	    intel_batchbuffer_grow(batch, sz))
+		return false;
+
+	intel_batchbuffer_flush(batch);
+	return true;
 }
 
 /* Here are the crusty old macros, to be removed:
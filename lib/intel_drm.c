@@ -45,6 +45,7 @@
 #include <sys/swap.h>
 #endif
 
+#include "xf86drm.h"
 #include "intel_gpu_tools.h"
 #include "i915_drm.h"
 
@@ -58,7 +59,7 @@ intel_get_drm_devid(int fd)
 	gp.param = I915_PARAM_CHIPSET_ID;
 	gp.value = (int *)&devid;
 
-	ret = ioctl(fd, DRM_IOCTL_I915_GETPARAM, &gp, sizeof(gp));
+	ret = drmIoctl(fd, DRM_IOCTL_I915_GETPARAM, &gp);
 	assert(ret == 0);
 
 	return devid;
@@ -90,6 +90,7 @@ uint64_t intel_get_total_ram_mb(void);
 uint64_t intel_get_total_swap_mb(void);
 
 void intel_map_file(char *);
+int intel_mmio_load_snapshot(const char *file);
 
 enum pch_type {
 	PCH_IBX,
@@ -98,6 +99,7 @@ enum pch_type {
 
 extern enum pch_type pch;
 void intel_check_pch(void);
+enum pch_type intel_devid_to_pch(uint32_t devid);
 
 #define HAS_CPT (pch == PCH_CPT)
 
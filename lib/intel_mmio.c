@@ -77,6 +77,75 @@ intel_map_file(char *file)
 	close(fd);
 }
 
+/*
+ * Register snapshots (as written by intel_reg_snapshot) are read into one
+ * private buffer that is reused across calls, so that tools can decode a
+ * large number of snapshots in a single run.  The buffer always covers the
+ * largest MMIO BAR, with anything the snapshot does not contain reading
+ * back as zero.
+ */
+#define SNAPSHOT_MIN_SIZE	(2*1024*1024)
+
+static char *snapshot_buf;
+static size_t snapshot_size, snapshot_len;
+
+int
+intel_mmio_load_snapshot(const char *file)
+{
+	struct stat st;
+	size_t size, len = 0;
+	ssize_t ret;
+	int fd;
+
+	fd = open(file, O_RDONLY);
+	if (fd == -1)
+		return -1;
+
+	if (fstat(fd, &st)) {
+		close(fd);
+		return -1;
+	}
+
+	size = st.st_size;
+	if (size < SNAPSHOT_MIN_SIZE)
+		size = SNAPSHOT_MIN_SIZE;
+	if (size > snapshot_size) {
+		char *buf = realloc(snapshot_buf, size);
+
+		if (!buf) {
+			close(fd);
+			errno = ENOMEM;
+			return -1;
+		}
+		memset(buf + snapshot_size, 0, size - snapshot_size);
+		snapshot_buf = buf;
+		snapshot_size = size;
+	}
+
+	while (len < (size_t)st.st_size) {
+		ret = read(fd, snapshot_buf + len, st.st_size - len);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0) {
+			if (len > snapshot_len)
+				snapshot_len = len;
+			close(fd);
+			return -1;
+		}
+		if (ret == 0)
+			break;
+		len += ret;
+	}
+	close(fd);
+
+	if (len < snapshot_len)
+		memset(snapshot_buf + len, 0, snapshot_len - len);
+	snapshot_len = len;
+
+	mmio = snapshot_buf;
+	return 0;
+}
+
 void
 intel_get_mmio(struct pci_device *pci_dev)
 {
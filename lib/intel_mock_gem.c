@@ -0,0 +1,956 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "xf86drm.h"
+#include "i915_drm.h"
+#include "intel_chipset.h"
+#include "intel_gpu_tools.h"
+#include "intel_mock_gem.h"
+
+#define LOCAL_I915_PARAM_HAS_ALIASING_PPGTT	18
+#define LOCAL_I915_PARAM_HAS_WAIT_TIMEOUT	19
+#define LOCAL_I915_PARAM_HAS_EXEC_NO_RELOC	25
+#define LOCAL_I915_PARAM_HAS_EXEC_HANDLE_LUT	26
+
+#define LOCAL_I915_EXEC_NO_RELOC	(1<<11)
+#define LOCAL_I915_EXEC_HANDLE_LUT	(1<<12)
+#define LOCAL_EXEC_OBJECT_WRITE		(1<<2)
+
+/* Newer libdrm submits through the read-write flavour of the ioctl. */
+#define LOCAL_DRM_IOCTL_I915_GEM_EXECBUFFER2_WR \
+	DRM_IOWR(DRM_COMMAND_BASE + DRM_I915_GEM_EXECBUFFER2, struct drm_i915_gem_execbuffer2)
+
+struct local_drm_i915_gem_cacheing {
+	uint32_t handle;
+	uint32_t cacheing;
+};
+
+#define LOCAL_DRM_I915_GEM_SET_CACHEING    0x2f
+#define LOCAL_DRM_I915_GEM_GET_CACHEING    0x30
+#define LOCAL_DRM_IOCTL_I915_GEM_SET_CACHEING \
+	DRM_IOW(DRM_COMMAND_BASE + LOCAL_DRM_I915_GEM_SET_CACHEING, struct local_drm_i915_gem_cacheing)
+#define LOCAL_DRM_IOCTL_I915_GEM_GET_CACHEING \
+	DRM_IOWR(DRM_COMMAND_BASE + LOCAL_DRM_I915_GEM_GET_CACHEING, struct local_drm_i915_gem_cacheing)
+
+/* Objects are bound at a fixed distance from their place in the backing
+ * file, keeping offset 0 free so that no object looks unbound to libdrm. */
+#define MOCK_GTT_BASE		(1 << 20)
+#define MOCK_GTT_END		(1ull << 32)
+#define MOCK_APERTURE_SIZE	(256 << 20)
+#define MOCK_PAGE_SIZE		4096
+
+#define to_ptr(x) ((void *)(uintptr_t)(x))
+
+struct mock_object {
+	uint64_t offset;	/* in the backing file */
+	uint64_t size;
+	void *cpu;		/* our own mapping, for pread/pwrite and relocs */
+
+	uint32_t tiling, stride;
+	uint32_t cacheing;
+	uint32_t name;		/* flink name, 0 if none */
+	int handle_count;
+
+	/* Last execbuffer this object was part of, to catch duplicates and
+	 * relocations against objects missing from the list. */
+	unsigned long exec_seqno;
+	unsigned long write_seqno;	/* ... and had a write relocation */
+
+	bool gpu_write;		/* written by a batch nobody waited for */
+	uint32_t write_ring;	/* ... submitted to this ring */
+};
+
+struct mock_extent {
+	uint64_t offset, size;
+};
+
+struct mock_device {
+	struct mock_device *next;
+
+	int fd;
+	dev_t st_dev;
+	ino_t st_ino;
+
+	uint32_t devid;
+	int gen;
+
+	/* Backing file space, freed ranges are reused first fit. */
+	uint64_t file_size;
+	struct mock_extent *free_list;
+	uint32_t num_free, max_free;
+
+	struct mock_object **handles;	/* indexed by handle, 0 unused */
+	uint32_t num_handles, max_handles;
+	uint32_t *free_handles;
+	uint32_t num_free_handles, max_free_handles;
+
+	struct mock_object **names;	/* indexed by flink name, 0 unused */
+	uint32_t num_names, max_names;
+
+	struct mock_object **exec_objects;
+	uint32_t max_exec_objects;
+	unsigned long exec_seqno;
+
+	uint32_t num_contexts;
+
+	struct intel_mock_gem_stats stats;
+};
+
+static struct mock_device *devices;
+
+/* Makes room for at least count elements of size bytes in *ptr. */
+static int grow_array(void *ptr, uint32_t *max, uint32_t count, size_t size)
+{
+	void **array = ptr;
+	uint32_t new_max;
+	void *tmp;
+
+	if (count <= *max)
+		return 0;
+
+	new_max = *max ? 2 * *max : 64;
+	while (new_max < count)
+		new_max *= 2;
+
+	tmp = realloc(*array, new_max * size);
+	if (!tmp)
+		return ENOMEM;
+
+	*array = tmp;
+	*max = new_max;
+	return 0;
+}
+
+static int backing_alloc(struct mock_device *dev, uint64_t size,
+			 uint64_t *offset)
+{
+	uint32_t i;
+
+	for (i = 0; i < dev->num_free; i++) {
+		struct mock_extent *e = &dev->free_list[i];
+
+		if (e->size < size)
+			continue;
+
+		*offset = e->offset;
+		e->offset += size;
+		e->size -= size;
+		if (e->size == 0) {
+			memmove(e, e + 1, (dev->num_free - i - 1) * sizeof(*e));
+			dev->num_free--;
+		}
+		return 0;
+	}
+
+	if (MOCK_GTT_BASE + dev->file_size + size > MOCK_GTT_END)
+		return ENOSPC;
+
+	if (ftruncate(dev->fd, dev->file_size + size))
+		return errno;
+
+	*offset = dev->file_size;
+	dev->file_size += size;
+	return 0;
+}
+
+static void backing_free(struct mock_device *dev, uint64_t offset,
+			 uint64_t size)
+{
+	struct mock_extent *list;
+	uint32_t i;
+
+	for (i = 0; i < dev->num_free; i++)
+		if (dev->free_list[i].offset > offset)
+			break;
+	list = dev->free_list;
+
+	if (i > 0 && list[i-1].offset + list[i-1].size == offset) {
+		list[i-1].size += size;
+		if (i < dev->num_free &&
+		    list[i-1].offset + list[i-1].size == list[i].offset) {
+			list[i-1].size += list[i].size;
+			memmove(&list[i], &list[i+1],
+				(dev->num_free - i - 1) * sizeof(*list));
+			dev->num_free--;
+		}
+		return;
+	}
+
+	if (i < dev->num_free && offset + size == list[i].offset) {
+		list[i].offset = offset;
+		list[i].size += size;
+		return;
+	}
+
+	/* Without room to track the range it is simply never reused. */
+	if (grow_array(&dev->free_list, &dev->max_free, dev->num_free + 1,
+		       sizeof(*list)))
+		return;
+	list = dev->free_list;
+
+	memmove(&list[i+1], &list[i], (dev->num_free - i) * sizeof(*list));
+	list[i].offset = offset;
+	list[i].size = size;
+	dev->num_free++;
+}
+
+static struct mock_object *lookup_handle(struct mock_device *dev,
+					 uint32_t handle)
+{
+	if (handle == 0 || handle >= dev->num_handles)
+		return NULL;
+
+	return dev->handles[handle];
+}
+
+static int handle_alloc(struct mock_device *dev, struct mock_object *obj,
+			uint32_t *handle)
+{
+	if (dev->num_free_handles) {
+		*handle = dev->free_handles[--dev->num_free_handles];
+	} else {
+		if (grow_array(&dev->handles, &dev->max_handles,
+			       dev->num_handles + 1, sizeof(*dev->handles)))
+			return ENOMEM;
+		*handle = dev->num_handles++;
+	}
+
+	dev->handles[*handle] = obj;
+	obj->handle_count++;
+	return 0;
+}
+
+static void object_free(struct mock_device *dev, struct mock_object *obj)
+{
+	if (obj->name)
+		dev->names[obj->name] = NULL;
+
+	/* Freed ranges must read back as zeroes once reused, like any new
+	 * object.  Punching a hole also returns the pages to the system. */
+#ifdef FALLOC_FL_PUNCH_HOLE
+	if (fallocate(dev->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+		      obj->offset, obj->size))
+#endif
+		memset(obj->cpu, 0, obj->size);
+
+	munmap(obj->cpu, obj->size);
+	backing_free(dev, obj->offset, obj->size);
+
+	dev->stats.objects--;
+	dev->stats.bytes -= obj->size;
+	free(obj);
+}
+
+static int handle_close(struct mock_device *dev, uint32_t handle)
+{
+	struct mock_object *obj = lookup_handle(dev, handle);
+
+	if (!obj)
+		return EINVAL;
+
+	/* Keep the freed handle whenever possible, losing it is harmless. */
+	dev->handles[handle] = NULL;
+	if (grow_array(&dev->free_handles, &dev->max_free_handles,
+		       dev->num_free_handles + 1, sizeof(*dev->free_handles)) == 0)
+		dev->free_handles[dev->num_free_handles++] = handle;
+
+	if (--obj->handle_count == 0)
+		object_free(dev, obj);
+
+	return 0;
+}
+
+static int mock_getparam(struct mock_device *dev, drm_i915_getparam_t *gp)
+{
+	int val;
+
+	switch (gp->param) {
+	case I915_PARAM_CHIPSET_ID:
+		val = dev->devid;
+		break;
+	case I915_PARAM_HAS_GEM:
+	case I915_PARAM_HAS_EXECBUF2:
+	case I915_PARAM_HAS_RELAXED_FENCING:
+	case LOCAL_I915_PARAM_HAS_WAIT_TIMEOUT:
+	case LOCAL_I915_PARAM_HAS_EXEC_NO_RELOC:
+	case LOCAL_I915_PARAM_HAS_EXEC_HANDLE_LUT:
+		val = 1;
+		break;
+	case I915_PARAM_NUM_FENCES_AVAIL:
+		val = dev->gen >= 4 ? 16 : 8;
+		break;
+	case I915_PARAM_HAS_BSD:
+		val = dev->gen >= 5 || IS_G4X(dev->devid);
+		break;
+	case I915_PARAM_HAS_BLT:
+	case I915_PARAM_HAS_LLC:
+	case LOCAL_I915_PARAM_HAS_ALIASING_PPGTT:
+		val = dev->gen >= 6;
+		break;
+	default:
+		return EINVAL;
+	}
+
+	*gp->value = val;
+	return 0;
+}
+
+static int mock_create(struct mock_device *dev,
+		       struct drm_i915_gem_create *create)
+{
+	struct mock_object *obj;
+	uint64_t size;
+	int ret;
+
+	if (create->size == 0)
+		return EINVAL;
+	size = (create->size + MOCK_PAGE_SIZE - 1) & ~(uint64_t)(MOCK_PAGE_SIZE - 1);
+
+	obj = calloc(1, sizeof(*obj));
+	if (!obj)
+		return ENOMEM;
+
+	ret = backing_alloc(dev, size, &obj->offset);
+	if (ret)
+		goto err_free;
+	obj->size = size;
+
+	obj->cpu = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			dev->fd, obj->offset);
+	if (obj->cpu == MAP_FAILED) {
+		ret = errno;
+		goto err_backing;
+	}
+
+	ret = handle_alloc(dev, obj, &create->handle);
+	if (ret)
+		goto err_unmap;
+
+	dev->stats.objects++;
+	dev->stats.bytes += size;
+	return 0;
+
+err_unmap:
+	munmap(obj->cpu, size);
+err_backing:
+	backing_free(dev, obj->offset, size);
+err_free:
+	free(obj);
+	return ret;
+}
+
+static int mock_flink(struct mock_device *dev, struct drm_gem_flink *flink)
+{
+	struct mock_object *obj = lookup_handle(dev, flink->handle);
+
+	if (!obj)
+		return ENOENT;
+
+	if (!obj->name) {
+		if (dev->num_names == 0)
+			dev->num_names = 1;
+		if (grow_array(&dev->names, &dev->max_names,
+			       dev->num_names + 1, sizeof(*dev->names)))
+			return ENOMEM;
+		obj->name = dev->num_names++;
+		dev->names[obj->name] = obj;
+	}
+
+	flink->name = obj->name;
+	return 0;
+}
+
+static int mock_open(struct mock_device *dev, struct drm_gem_open *open_arg)
+{
+	struct mock_object *obj = NULL;
+
+	if (open_arg->name && open_arg->name < dev->num_names)
+		obj = dev->names[open_arg->name];
+	if (!obj)
+		return ENOENT;
+
+	open_arg->size = obj->size;
+	return handle_alloc(dev, obj, &open_arg->handle);
+}
+
+/* The CPU is about to access obj: count the times the kernel would have
+ * had to wait for the GPU to finish writing to it first. */
+static void cpu_access(struct mock_device *dev, struct mock_object *obj)
+{
+	if (obj->gpu_write) {
+		dev->stats.write_waits++;
+		obj->gpu_write = false;
+	}
+}
+
+static int mock_pwrite(struct mock_device *dev,
+		       struct drm_i915_gem_pwrite *pwrite)
+{
+	struct mock_object *obj = lookup_handle(dev, pwrite->handle);
+
+	if (!obj)
+		return ENOENT;
+	if (pwrite->offset > obj->size || pwrite->size > obj->size - pwrite->offset)
+		return EINVAL;
+
+	cpu_access(dev, obj);
+
+	memcpy((char *)obj->cpu + pwrite->offset, to_ptr(pwrite->data_ptr),
+	       pwrite->size);
+	return 0;
+}
+
+static int mock_pread(struct mock_device *dev,
+		      struct drm_i915_gem_pread *pread)
+{
+	struct mock_object *obj = lookup_handle(dev, pread->handle);
+
+	if (!obj)
+		return ENOENT;
+	if (pread->offset > obj->size || pread->size > obj->size - pread->offset)
+		return EINVAL;
+
+	cpu_access(dev, obj);
+
+	memcpy(to_ptr(pread->data_ptr), (char *)obj->cpu + pread->offset,
+	       pread->size);
+	return 0;
+}
+
+static int mock_mmap(struct mock_device *dev, struct drm_i915_gem_mmap *map)
+{
+	struct mock_object *obj = lookup_handle(dev, map->handle);
+	void *ptr;
+
+	if (!obj)
+		return ENOENT;
+	if (map->offset & (MOCK_PAGE_SIZE - 1) ||
+	    map->offset > obj->size || map->size > obj->size - map->offset)
+		return EINVAL;
+
+	ptr = mmap(NULL, map->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   dev->fd, obj->offset + map->offset);
+	if (ptr == MAP_FAILED)
+		return errno;
+
+	map->addr_ptr = (uintptr_t)ptr;
+	return 0;
+}
+
+static int mock_set_tiling(struct mock_device *dev,
+			   struct drm_i915_gem_set_tiling *tiling)
+{
+	struct mock_object *obj = lookup_handle(dev, tiling->handle);
+
+	if (!obj)
+		return ENOENT;
+	if (tiling->tiling_mode > I915_TILING_Y)
+		return EINVAL;
+
+	/* Nothing is ever detiled, every view of an object is linear. */
+	obj->tiling = tiling->tiling_mode;
+	obj->stride = obj->tiling ? tiling->stride : 0;
+	tiling->stride = obj->stride;
+	tiling->swizzle_mode = I915_BIT_6_SWIZZLE_NONE;
+	return 0;
+}
+
+static int mock_execbuffer2(struct mock_device *dev,
+			    struct drm_i915_gem_execbuffer2 *execbuf)
+{
+	struct drm_i915_gem_exec_object2 *exec = to_ptr(execbuf->buffers_ptr);
+	uint32_t count = execbuf->buffer_count;
+	bool lut = execbuf->flags & LOCAL_I915_EXEC_HANDLE_LUT;
+	bool no_reloc = execbuf->flags & LOCAL_I915_EXEC_NO_RELOC;
+	struct mock_object **objects, *batch;
+	uint32_t ring = execbuf->flags & I915_EXEC_RING_MASK;
+	bool need_relocs = !no_reloc;
+	uint32_t i, j;
+
+	if (count == 0)
+		return EINVAL;
+
+	switch (ring) {
+	case I915_EXEC_DEFAULT:
+		ring = I915_EXEC_RENDER;
+		break;
+	case I915_EXEC_RENDER:
+		break;
+	case I915_EXEC_BSD:
+		if (!(dev->gen >= 5 || IS_G4X(dev->devid)))
+			return EINVAL;
+		if (i915_execbuffer2_get_context_id(*execbuf))
+			return EINVAL;
+		break;
+	case I915_EXEC_BLT:
+		if (dev->gen < 6)
+			return EINVAL;
+		if (i915_execbuffer2_get_context_id(*execbuf))
+			return EINVAL;
+		break;
+	default:
+		return EINVAL;
+	}
+
+	if (i915_execbuffer2_get_context_id(*execbuf) > dev->num_contexts)
+		return ENOENT;
+
+	if (grow_array(&dev->exec_objects, &dev->max_exec_objects, count,
+		       sizeof(*dev->exec_objects)))
+		return ENOMEM;
+	objects = dev->exec_objects;
+
+	dev->exec_seqno++;
+	for (i = 0; i < count; i++) {
+		struct mock_object *obj = lookup_handle(dev, exec[i].handle);
+
+		if (!obj)
+			return ENOENT;
+		if (obj->exec_seqno == dev->exec_seqno)
+			return EINVAL;
+
+		obj->exec_seqno = dev->exec_seqno;
+		objects[i] = obj;
+	}
+
+	batch = objects[count - 1];
+	if (execbuf->batch_start_offset > batch->size ||
+	    execbuf->batch_len > batch->size - execbuf->batch_start_offset)
+		return EINVAL;
+
+	for (i = 0; i < count; i++) {
+		struct drm_i915_gem_relocation_entry *reloc =
+			to_ptr(exec[i].relocs_ptr);
+		struct mock_object *obj = objects[i];
+
+		for (j = 0; j < exec[i].relocation_count; j++) {
+			struct mock_object *target;
+			uint64_t address;
+
+			if (lut) {
+				if (reloc[j].target_handle >= count)
+					return ENOENT;
+				target = objects[reloc[j].target_handle];
+			} else {
+				target = lookup_handle(dev, reloc[j].target_handle);
+				if (!target || target->exec_seqno != dev->exec_seqno)
+					return ENOENT;
+			}
+
+			if (reloc[j].offset & 3 || reloc[j].offset + 4 > obj->size)
+				return EINVAL;
+			if (reloc[j].write_domain &&
+			    reloc[j].write_domain & (reloc[j].write_domain - 1))
+				return EINVAL;
+
+			dev->stats.relocs++;
+			if (reloc[j].write_domain)
+				target->write_seqno = dev->exec_seqno;
+
+			address = MOCK_GTT_BASE + target->offset;
+			if (reloc[j].presumed_offset != address)
+				need_relocs = true;
+			if (no_reloc && reloc[j].presumed_offset == address) {
+				dev->stats.relocs_skipped++;
+				continue;
+			}
+
+			*(uint32_t *)((char *)obj->cpu + reloc[j].offset) =
+				address + reloc[j].delta;
+			reloc[j].presumed_offset = address;
+		}
+	}
+
+	/* Like the kernel, only look at the write domains if the
+	 * relocations had to be processed, EXEC_OBJECT_WRITE otherwise. */
+	for (i = 0; i < count; i++) {
+		struct mock_object *obj = objects[i];
+
+		exec[i].offset = MOCK_GTT_BASE + obj->offset;
+
+		if (obj->gpu_write && obj->write_ring != ring)
+			dev->stats.ring_syncs++;
+
+		if (exec[i].flags & LOCAL_EXEC_OBJECT_WRITE ||
+		    (need_relocs && obj->write_seqno == dev->exec_seqno)) {
+			obj->gpu_write = true;
+			obj->write_ring = ring;
+		}
+	}
+
+	dev->stats.execs++;
+	return 0;
+}
+
+static int mock_ioctl(struct mock_device *dev, unsigned long request,
+		      void *arg)
+{
+	struct mock_object *obj;
+
+	dev->stats.ioctls++;
+
+	switch (request) {
+	case DRM_IOCTL_I915_GETPARAM:
+		return mock_getparam(dev, arg);
+
+	case DRM_IOCTL_I915_GEM_GET_APERTURE: {
+		struct drm_i915_gem_get_aperture *aperture = arg;
+
+		aperture->aper_size = MOCK_APERTURE_SIZE;
+		aperture->aper_available_size =
+			dev->stats.bytes < MOCK_APERTURE_SIZE ?
+			MOCK_APERTURE_SIZE - dev->stats.bytes : 0;
+		return 0;
+	}
+
+	case DRM_IOCTL_I915_GEM_CREATE:
+		return mock_create(dev, arg);
+	case DRM_IOCTL_GEM_CLOSE:
+		return handle_close(dev, ((struct drm_gem_close *)arg)->handle);
+	case DRM_IOCTL_GEM_FLINK:
+		return mock_flink(dev, arg);
+	case DRM_IOCTL_GEM_OPEN:
+		return mock_open(dev, arg);
+
+	case DRM_IOCTL_I915_GEM_PWRITE:
+		return mock_pwrite(dev, arg);
+	case DRM_IOCTL_I915_GEM_PREAD:
+		return mock_pread(dev, arg);
+	case DRM_IOCTL_I915_GEM_MMAP:
+		return mock_mmap(dev, arg);
+
+	case DRM_IOCTL_I915_GEM_MMAP_GTT: {
+		struct drm_i915_gem_mmap_gtt *map = arg;
+
+		/* The fake mmap offset is the object's place in the backing
+		 * file, so mmap() on the device fd maps it directly. */
+		obj = lookup_handle(dev, map->handle);
+		if (!obj)
+			return ENOENT;
+		map->offset = obj->offset;
+		return 0;
+	}
+
+	/* Nothing ever runs, so every object is always idle and coherent.
+	 * Only the waits the kernel would have done are counted. */
+	case DRM_IOCTL_I915_GEM_SET_DOMAIN:
+		obj = lookup_handle(dev, ((struct drm_i915_gem_set_domain *)arg)->handle);
+		if (!obj)
+			return ENOENT;
+		cpu_access(dev, obj);
+		return 0;
+	case DRM_IOCTL_I915_GEM_SW_FINISH:
+		obj = lookup_handle(dev, ((struct drm_i915_gem_sw_finish *)arg)->handle);
+		return obj ? 0 : ENOENT;
+	case DRM_IOCTL_I915_GEM_WAIT:
+		obj = lookup_handle(dev, ((struct drm_i915_gem_wait *)arg)->bo_handle);
+		if (!obj)
+			return ENOENT;
+		cpu_access(dev, obj);
+		return 0;
+	case DRM_IOCTL_I915_GEM_BUSY: {
+		struct drm_i915_gem_busy *busy = arg;
+
+		if (!lookup_handle(dev, busy->handle))
+			return ENOENT;
+		busy->busy = 0;
+		return 0;
+	}
+	case DRM_IOCTL_I915_GEM_THROTTLE:
+		return 0;
+
+	case DRM_IOCTL_I915_GEM_MADVISE: {
+		struct drm_i915_gem_madvise *madv = arg;
+
+		if (!lookup_handle(dev, madv->handle))
+			return ENOENT;
+		madv->retained = 1;
+		return 0;
+	}
+
+	case DRM_IOCTL_I915_GEM_SET_TILING:
+		return mock_set_tiling(dev, arg);
+	case DRM_IOCTL_I915_GEM_GET_TILING: {
+		struct drm_i915_gem_get_tiling *tiling = arg;
+
+		obj = lookup_handle(dev, tiling->handle);
+		if (!obj)
+			return ENOENT;
+		tiling->tiling_mode = obj->tiling;
+		tiling->swizzle_mode = I915_BIT_6_SWIZZLE_NONE;
+		return 0;
+	}
+
+	case LOCAL_DRM_IOCTL_I915_GEM_SET_CACHEING: {
+		struct local_drm_i915_gem_cacheing *cacheing = arg;
+
+		obj = lookup_handle(dev, cacheing->handle);
+		if (!obj)
+			return ENOENT;
+		obj->cacheing = cacheing->cacheing;
+		return 0;
+	}
+	case LOCAL_DRM_IOCTL_I915_GEM_GET_CACHEING: {
+		struct local_drm_i915_gem_cacheing *cacheing = arg;
+
+		obj = lookup_handle(dev, cacheing->handle);
+		if (!obj)
+			return ENOENT;
+		cacheing->cacheing = obj->cacheing;
+		return 0;
+	}
+
+	case DRM_IOCTL_I915_GEM_CONTEXT_CREATE:
+		if (dev->gen < 6)
+			return ENODEV;
+		((struct drm_i915_gem_context_create *)arg)->ctx_id =
+			++dev->num_contexts;
+		return 0;
+	case DRM_IOCTL_I915_GEM_CONTEXT_DESTROY: {
+		uint32_t ctx_id = ((struct drm_i915_gem_context_destroy *)arg)->ctx_id;
+
+		return ctx_id && ctx_id <= dev->num_contexts ? 0 : ENOENT;
+	}
+
+	case DRM_IOCTL_I915_GEM_EXECBUFFER2:
+	case LOCAL_DRM_IOCTL_I915_GEM_EXECBUFFER2_WR:
+		return mock_execbuffer2(dev, arg);
+
+	default:
+		return EINVAL;
+	}
+}
+
+static void device_destroy(struct mock_device *dev)
+{
+	struct mock_device **prev;
+	uint32_t i;
+
+	for (prev = &devices; *prev != dev; prev = &(*prev)->next)
+		;
+	*prev = dev->next;
+
+	for (i = 1; i < dev->num_handles; i++) {
+		struct mock_object *obj = dev->handles[i];
+
+		if (obj && --obj->handle_count == 0) {
+			munmap(obj->cpu, obj->size);
+			free(obj);
+		}
+	}
+
+	free(dev->handles);
+	free(dev->free_handles);
+	free(dev->names);
+	free(dev->free_list);
+	free(dev->exec_objects);
+	free(dev);
+}
+
+/*
+ * Nothing tells us when the device fd gets closed, so check that the fd still
+ * refers to our backing file before trusting it.  The extra fstat() stands in
+ * for the syscall a real ioctl would have cost.
+ */
+static struct mock_device *lookup_device(int fd)
+{
+	struct mock_device *dev;
+	struct stat st;
+
+	for (dev = devices; dev; dev = dev->next) {
+		if (dev->fd != fd)
+			continue;
+
+		if (fstat(fd, &st) == 0 &&
+		    st.st_dev == dev->st_dev && st.st_ino == dev->st_ino)
+			return dev;
+
+		device_destroy(dev);
+		return NULL;
+	}
+
+	return NULL;
+}
+
+static int create_backing_file(void)
+{
+	static const char * const dirs[] = { "/dev/shm", "/tmp" };
+	char path[64];
+	unsigned i;
+	int fd;
+
+	for (i = 0; i < sizeof(dirs) / sizeof(dirs[0]); i++) {
+		snprintf(path, sizeof(path), "%s/intel-mock-gem-XXXXXX", dirs[i]);
+		fd = mkstemp(path);
+		if (fd >= 0) {
+			unlink(path);
+			return fd;
+		}
+	}
+
+	return -1;
+}
+
+/**
+ * intel_mock_gem_open:
+ * @devid: pci id of the device to pretend to be
+ *
+ * Creates a new mock GEM device, see intel_mock_gem.h.  The device goes away
+ * once the returned fd is closed.
+ *
+ * Returns: the device fd, or -1 with errno set on failure.
+ */
+int intel_mock_gem_open(uint32_t devid)
+{
+	struct mock_device *dev;
+	struct stat st;
+	int fd;
+
+	if (!IS_INTEL(devid)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	fd = create_backing_file();
+	if (fd < 0)
+		return -1;
+
+	dev = calloc(1, sizeof(*dev));
+	if (!dev || fstat(fd, &st)) {
+		free(dev);
+		close(fd);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	/* A stale entry for a closed fd of the same number must not linger. */
+	lookup_device(fd);
+
+	dev->fd = fd;
+	dev->st_dev = st.st_dev;
+	dev->st_ino = st.st_ino;
+	dev->devid = devid;
+	dev->gen = intel_gen(devid);
+	dev->num_handles = 1;
+
+	dev->next = devices;
+	devices = dev;
+
+	return fd;
+}
+
+static uint32_t enabled_devid;
+
+/**
+ * intel_mock_gem_enable() - make drm_open_any() return a mock GEM device
+ *
+ * @devid: pci id the mock device reports, 0 to go back to real hardware
+ *
+ * Setting INTEL_MOCK_GEM=<devid> in the environment does the same for
+ * programs that don't call this.
+ */
+void intel_mock_gem_enable(uint32_t devid)
+{
+	enabled_devid = devid;
+}
+
+/**
+ * intel_mock_gem_enabled() - devid drm_open_any() should open a mock for
+ *
+ * Returns: the devid from intel_mock_gem_enable() or INTEL_MOCK_GEM, 0 for
+ * real hardware.
+ */
+uint32_t intel_mock_gem_enabled(void)
+{
+	const char *env;
+	uint32_t devid;
+
+	if (enabled_devid)
+		return enabled_devid;
+
+	env = getenv("INTEL_MOCK_GEM");
+	if (!env)
+		return 0;
+
+	devid = strtoul(env, NULL, 0);
+	return devid ? devid : PCI_CHIP_IVYBRIDGE_GT2;
+}
+
+bool intel_mock_gem_is_mock(int fd)
+{
+	return lookup_device(fd) != NULL;
+}
+
+bool intel_mock_gem_get_stats(int fd, struct intel_mock_gem_stats *stats)
+{
+	struct mock_device *dev = lookup_device(fd);
+
+	if (!dev)
+		return false;
+
+	*stats = dev->stats;
+	return true;
+}
+
+/*
+ * Replaces libdrm's drmIoctl() for the whole program, libdrm_intel included,
+ * so that mock fds can be driven through the unmodified bufmgr.  That is why
+ * the mock is a library of its own: only the programs linked with it get
+ * this.  Real fds get the same restarting ioctl loop as libdrm's version.
+ */
+int drmIoctl(int fd, unsigned long request, void *arg)
+{
+	struct mock_device *dev = NULL;
+	int ret;
+
+	if (devices)
+		dev = lookup_device(fd);
+
+	if (dev) {
+		ret = mock_ioctl(dev, request, arg);
+		if (ret) {
+			errno = ret;
+			return -1;
+		}
+		return 0;
+	}
+
+	do {
+		ret = ioctl(fd, request, arg);
+	} while (ret == -1 && (errno == EINTR || errno == EAGAIN));
+
+	return ret;
+}
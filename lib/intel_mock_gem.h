@@ -0,0 +1,73 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_MOCK_GEM_H
+#define INTEL_MOCK_GEM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Userspace stand-in for an i915 GEM device.
+ *
+ * intel_mock_gem_open() returns an fd that drmIoctl() (and so libdrm_intel,
+ * intel_batchbuffer and the drmtest gem helpers) treats as an i915 device of
+ * the given devid.  Objects are backed by ranges of an unlinked shm file so
+ * that both CPU and GTT mmaps of them work unmodified.  Execbuffer does not
+ * execute anything: it validates the request, applies the relocations
+ * exactly like the kernel would and reports every object idle afterwards.
+ * It does track which objects the kernel would consider written by the GPU,
+ * from the relocations or from EXEC_OBJECT_WRITE under NO_RELOC, and counts
+ * the CPU accesses and the batches on other rings that would have had to
+ * wait for those writes.
+ *
+ * There is no tiling or swizzling, all mappings are linear views, and the
+ * device is single threaded.
+ *
+ * The mock is built as libintel_mock_gem, separate from libintel_tools,
+ * because it has to replace drmIoctl() for the whole program.  Only the
+ * programs that want mock devices link it, ahead of libintel_tools.  In
+ * those drm_open_any() returns a mock device after intel_mock_gem_enable()
+ * or when INTEL_MOCK_GEM=<devid> is set.  Programs built without it ignore
+ * INTEL_MOCK_GEM and always open the hardware.
+ */
+
+struct intel_mock_gem_stats {
+	unsigned long ioctls;
+	unsigned long execs;
+	unsigned long relocs;		/* relocation entries processed */
+	unsigned long relocs_skipped;	/* of which left alone by NO_RELOC */
+	unsigned long write_waits;	/* CPU accesses waiting for GPU writes */
+	unsigned long ring_syncs;	/* objects waited for from another ring */
+	unsigned long objects;		/* currently allocated */
+	uint64_t bytes;			/* backing store in use */
+};
+
+int intel_mock_gem_open(uint32_t devid);
+void intel_mock_gem_enable(uint32_t devid);
+uint32_t intel_mock_gem_enabled(void);
+bool intel_mock_gem_is_mock(int fd);
+bool intel_mock_gem_get_stats(int fd, struct intel_mock_gem_stats *stats);
+
+#endif /* INTEL_MOCK_GEM_H */
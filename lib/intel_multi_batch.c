@@ -0,0 +1,159 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "drm.h"
+#include "i915_drm.h"
+#include "intel_chipset.h"
+#include "intel_multi_batch.h"
+
+static const struct {
+	const char *name;
+	int exec_flag;
+} rings[INTEL_NUM_RINGS] = {
+	[INTEL_RING_RENDER] = { "render", I915_EXEC_RENDER },
+	[INTEL_RING_BSD] = { "bsd", I915_EXEC_BSD },
+	[INTEL_RING_BLT] = { "blt", I915_EXEC_BLT },
+};
+
+int
+intel_ring_exec_flag(enum intel_ring ring)
+{
+	return rings[ring].exec_flag;
+}
+
+const char *
+intel_ring_name(enum intel_ring ring)
+{
+	return rings[ring].name;
+}
+
+struct intel_multi_batch *
+intel_multi_batch_alloc(drm_intel_bufmgr *bufmgr, uint32_t devid)
+{
+	struct intel_multi_batch *mb = calloc(sizeof(*mb), 1);
+	int ring;
+
+	assert(mb);
+	mb->bufmgr = bufmgr;
+	mb->devid = devid;
+
+	for (ring = 0; ring < INTEL_NUM_RINGS; ring++) {
+		if (ring == INTEL_RING_BSD && !HAS_BSD_RING(devid))
+			continue;
+		if (ring == INTEL_RING_BLT && !HAS_BLT_RING(devid))
+			continue;
+
+		mb->batch[ring] = intel_batchbuffer_alloc(bufmgr, devid);
+		mb->batch[ring]->ring = rings[ring].exec_flag;
+	}
+
+	return mb;
+}
+
+void
+intel_multi_batch_free(struct intel_multi_batch *mb)
+{
+	int ring;
+
+	for (ring = 0; ring < INTEL_NUM_RINGS; ring++) {
+		if (mb->batch[ring])
+			intel_batchbuffer_free(mb->batch[ring]);
+		if (mb->sync_bo[ring])
+			drm_intel_bo_unreference(mb->sync_bo[ring]);
+	}
+	free(mb);
+}
+
+/* See intel_batchbuffer_set_exec_fd(), applied to every ring. */
+bool
+intel_multi_batch_set_exec_fd(struct intel_multi_batch *mb, int fd)
+{
+	bool ret = true;
+	int ring;
+
+	for (ring = 0; ring < INTEL_NUM_RINGS; ring++)
+		if (mb->batch[ring])
+			ret &= intel_batchbuffer_set_exec_fd(mb->batch[ring], fd);
+
+	return ret;
+}
+
+/*
+ * Make the next batch flushed on waiter execute only after everything
+ * emitted so far on signaller has completed.
+ */
+void
+intel_multi_batch_sync(struct intel_multi_batch *mb,
+		       enum intel_ring waiter, enum intel_ring signaller)
+{
+	assert(mb->batch[waiter] && mb->batch[signaller]);
+	if (waiter == signaller)
+		return;
+
+	if (!mb->sync_bo[signaller]) {
+		mb->sync_bo[signaller] = drm_intel_bo_alloc(mb->bufmgr,
+							    "ring sync",
+							    4096, 4096);
+		assert(mb->sync_bo[signaller]);
+	}
+
+	intel_batchbuffer_add_dependency(mb->batch[signaller],
+					 mb->sync_bo[signaller], 1);
+	intel_batchbuffer_add_dependency(mb->batch[waiter],
+					 mb->sync_bo[signaller], 0);
+	mb->waits[waiter] |= 1 << signaller;
+}
+
+void
+intel_multi_batch_flush_ring(struct intel_multi_batch *mb,
+			     enum intel_ring ring)
+{
+	unsigned int waits = mb->waits[ring];
+	int other;
+
+	assert(mb->batch[ring]);
+
+	/* Clearing first also stops a sync cycle from recursing forever. */
+	mb->waits[ring] = 0;
+	for (other = 0; other < INTEL_NUM_RINGS; other++)
+		if (waits & (1 << other))
+			intel_multi_batch_flush_ring(mb, other);
+
+	intel_batchbuffer_flush_on_ring(mb->batch[ring],
+					rings[ring].exec_flag);
+}
+
+/* Flush every ring with anything in its batch, honouring the syncs. */
+void
+intel_multi_batch_flush(struct intel_multi_batch *mb)
+{
+	int ring;
+
+	for (ring = 0; ring < INTEL_NUM_RINGS; ring++)
+		if (mb->batch[ring])
+			intel_multi_batch_flush_ring(mb, ring);
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_MULTI_BATCH_H
+#define INTEL_MULTI_BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "intel_bufmgr.h"
+#include "intel_batchbuffer.h"
+
+/*
+ * One intel_batchbuffer per ring, so that commands for render, bsd and blt
+ * can be built up side by side and flushed together or one ring at a time.
+ *
+ * intel_multi_batch_sync() orders a ring after another one: both batches
+ * get a dummy relocation to a bo owned by the signalling ring, which makes
+ * the kernel insert a semaphore wait (or stall) when the waiting batch is
+ * submitted.  Flushing a ring flushes the rings it waits on first.
+ */
+
+enum intel_ring {
+	INTEL_RING_RENDER,
+	INTEL_RING_BSD,
+	INTEL_RING_BLT,
+	INTEL_NUM_RINGS
+};
+
+struct intel_multi_batch {
+	drm_intel_bufmgr *bufmgr;
+	uint32_t devid;
+
+	/* NULL for rings the device doesn't have. */
+	struct intel_batchbuffer *batch[INTEL_NUM_RINGS];
+
+	/* Written by each ring for others to wait on, allocated on first
+	 * use. */
+	drm_intel_bo *sync_bo[INTEL_NUM_RINGS];
+	unsigned int waits[INTEL_NUM_RINGS];	/* bit r: flush ring r first */
+};
+
+struct intel_multi_batch *intel_multi_batch_alloc(drm_intel_bufmgr *bufmgr,
+						  uint32_t devid);
+void intel_multi_batch_free(struct intel_multi_batch *mb);
+bool intel_multi_batch_set_exec_fd(struct intel_multi_batch *mb, int fd);
+
+int intel_ring_exec_flag(enum intel_ring ring);
+const char *intel_ring_name(enum intel_ring ring);
+
+static inline struct intel_batchbuffer *
+intel_multi_batch_get(struct intel_multi_batch *mb, enum intel_ring ring)
+{
+	return mb->batch[ring];
+}
+
+void intel_multi_batch_sync(struct intel_multi_batch *mb,
+			    enum intel_ring waiter, enum intel_ring signaller);
+void intel_multi_batch_flush_ring(struct intel_multi_batch *mb,
+				  enum intel_ring ring);
+void intel_multi_batch_flush(struct intel_multi_batch *mb);
+
+#endif /* INTEL_MULTI_BATCH_H */
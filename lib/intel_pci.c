@@ -106,3 +106,14 @@ intel_check_pch(void)
 		pch = PCH_CPT;
 }
 
+/* The PCH that goes with devid, for decoding registers of a machine other
+ * than this one where intel_check_pch() can't look at the PCH itself. */
+enum pch_type
+intel_devid_to_pch(uint32_t devid)
+{
+	/* Ironlake pairs with Ibex Peak, later generations with Cougar
+	 * Point or newer PCHs using the same register layout.  Without a PCH
+	 * this is the same PCH_IBX default as intel_check_pch() leaves. */
+	return HAS_PCH_SPLIT(devid) && !IS_GEN5(devid) ? PCH_CPT : PCH_IBX;
+}
+
@@ -0,0 +1,970 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "drm.h"
+#include "i915_drm.h"
+#include "intel_tiling.h"
+
+/* The kernels need the target attribute and the intrinsics to work with
+ * it, so the library doesn't have to be built with -mavx2. */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HAVE_TILING_SIMD 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Within a tile row of X tiling, and within a column of Y tiling, address
+ * bits 9 and up don't change, so the swizzle either flips bit 6 for all of
+ * it or for none of it.  The kernels are handed that as swap: the 64 byte
+ * chunk index to xor for X, the row index for Y.
+ */
+struct tiling_funcs {
+	/* count whole 64 byte chunks of a tile row starting at first */
+	void (*x_to_tiled)(uint8_t *row, const uint8_t *linear,
+			   unsigned first, unsigned count, unsigned swap);
+	void (*x_from_tiled)(uint8_t *linear, const uint8_t *row,
+			     unsigned first, unsigned count, unsigned swap);
+	/* count rows of a 16 byte Y tile column starting at row first */
+	void (*y_to_tiled)(uint8_t *column, const uint8_t *linear,
+			   uint32_t stride, unsigned first, unsigned count,
+			   unsigned swap);
+	void (*y_from_tiled)(uint8_t *linear, uint32_t stride,
+			     const uint8_t *column, unsigned first,
+			     unsigned count, unsigned swap);
+	/* orders the non-temporal stores, if any */
+	void (*fence)(void);
+};
+
+static void
+x_to_tiled_c(uint8_t *row, const uint8_t *linear,
+	     unsigned first, unsigned count, unsigned swap)
+{
+	unsigned i;
+
+	for (i = first; i < first + count; i++, linear += 64)
+		memcpy(row + (i ^ swap) * 64, linear, 64);
+}
+
+static void
+x_from_tiled_c(uint8_t *linear, const uint8_t *row,
+	       unsigned first, unsigned count, unsigned swap)
+{
+	unsigned i;
+
+	for (i = first; i < first + count; i++, linear += 64)
+		memcpy(linear, row + (i ^ swap) * 64, 64);
+}
+
+static void
+y_to_tiled_c(uint8_t *column, const uint8_t *linear, uint32_t stride,
+	     unsigned first, unsigned count, unsigned swap)
+{
+	unsigned i;
+
+	for (i = first; i < first + count; i++, linear += stride)
+		memcpy(column + (i ^ swap) * 16, linear, 16);
+}
+
+static void
+y_from_tiled_c(uint8_t *linear, uint32_t stride, const uint8_t *column,
+	       unsigned first, unsigned count, unsigned swap)
+{
+	unsigned i;
+
+	for (i = first; i < first + count; i++, linear += stride)
+		memcpy(linear, column + (i ^ swap) * 16, 16);
+}
+
+static void
+fence_none(void)
+{
+}
+
+static const struct tiling_funcs tiling_c = {
+	.x_to_tiled = x_to_tiled_c,
+	.x_from_tiled = x_from_tiled_c,
+	.y_to_tiled = y_to_tiled_c,
+	.y_from_tiled = y_from_tiled_c,
+	.fence = fence_none,
+};
+
+#ifdef HAVE_TILING_SIMD
+__attribute__((target("sse2"))) static void
+x_to_tiled_sse2(uint8_t *row, const uint8_t *linear,
+		unsigned first, unsigned count, unsigned swap)
+{
+	unsigned i;
+
+	for (i = first; i < first + count; i++, linear += 64) {
+		__m128i *dst = (__m128i *)(row + (i ^ swap) * 64);
+		const __m128i *src = (const __m128i *)linear;
+		__m128i a = _mm_loadu_si128(src);
+		__m128i b = _mm_loadu_si128(src + 1);
+		__m128i c = _mm_loadu_si128(src + 2);
+		__m128i d = _mm_loadu_si128(src + 3);
+
+		_mm_stream_si128(dst, a);
+		_mm_stream_si128(dst + 1, b);
+		_mm_stream_si128(dst + 2, c);
+		_mm_stream_si128(dst + 3, d);
+	}
+}
+
+__attribute__((target("sse2"))) static void
+x_from_tiled_sse2(uint8_t *linear, const uint8_t *row,
+		  unsigned first, unsigned count, unsigned swap)
+{
+	unsigned i;
+
+	for (i = first; i < first + count; i++, linear += 64) {
+		const __m128i *src = (const __m128i *)(row + (i ^ swap) * 64);
+		__m128i *dst = (__m128i *)linear;
+		__m128i a = _mm_load_si128(src);
+		__m128i b = _mm_load_si128(src + 1);
+		__m128i c = _mm_load_si128(src + 2);
+		__m128i d = _mm_load_si128(src + 3);
+
+		_mm_storeu_si128(dst, a);
+		_mm_storeu_si128(dst + 1, b);
+		_mm_storeu_si128(dst + 2, c);
+		_mm_storeu_si128(dst + 3, d);
+	}
+}
+
+__attribute__((target("sse2"))) static void
+y_to_tiled_sse2(uint8_t *column, const uint8_t *linear, uint32_t stride,
+		unsigned first, unsigned count, unsigned swap)
+{
+	unsigned i;
+
+	for (i = first; i < first + count; i++, linear += stride)
+		_mm_stream_si128((__m128i *)(column + (i ^ swap) * 16),
+				 _mm_loadu_si128((const __m128i *)linear));
+}
+
+__attribute__((target("sse2"))) static void
+y_from_tiled_sse2(uint8_t *linear, uint32_t stride, const uint8_t *column,
+		  unsigned first, unsigned count, unsigned swap)
+{
+	unsigned i;
+
+	for (i = first; i < first + count; i++, linear += stride)
+		_mm_storeu_si128((__m128i *)linear,
+				 _mm_load_si128((const __m128i *)(column + (i ^ swap) * 16)));
+}
+
+__attribute__((target("sse2"))) static void
+fence_sse2(void)
+{
+	_mm_sfence();
+}
+
+static const struct tiling_funcs tiling_sse2 = {
+	.x_to_tiled = x_to_tiled_sse2,
+	.x_from_tiled = x_from_tiled_sse2,
+	.y_to_tiled = y_to_tiled_sse2,
+	.y_from_tiled = y_from_tiled_sse2,
+	.fence = fence_sse2,
+};
+
+__attribute__((target("avx2"))) static void
+x_to_tiled_avx2(uint8_t *row, const uint8_t *linear,
+		unsigned first, unsigned count, unsigned swap)
+{
+	unsigned i;
+
+	for (i = first; i < first + count; i++, linear += 64) {
+		__m256i *dst = (__m256i *)(row + (i ^ swap) * 64);
+		const __m256i *src = (const __m256i *)linear;
+		__m256i a = _mm256_loadu_si256(src);
+		__m256i b = _mm256_loadu_si256(src + 1);
+
+		_mm256_stream_si256(dst, a);
+		_mm256_stream_si256(dst + 1, b);
+	}
+}
+
+__attribute__((target("avx2"))) static void
+x_from_tiled_avx2(uint8_t *linear, const uint8_t *row,
+		  unsigned first, unsigned count, unsigned swap)
+{
+	unsigned i;
+
+	for (i = first; i < first + count; i++, linear += 64) {
+		__m256i *src = (__m256i *)(row + (i ^ swap) * 64);
+		__m256i *dst = (__m256i *)linear;
+		__m256i a = _mm256_stream_load_si256(src);
+		__m256i b = _mm256_stream_load_si256(src + 1);
+
+		_mm256_storeu_si256(dst, a);
+		_mm256_storeu_si256(dst + 1, b);
+	}
+}
+
+/* An even row and the one after it are next to each other in the column,
+ * whatever the swizzle, so they go as one 32 byte access. */
+__attribute__((target("avx2"))) static void
+y_to_tiled_avx2(uint8_t *column, const uint8_t *linear, uint32_t stride,
+		unsigned first, unsigned count, unsigned swap)
+{
+	unsigned i = first, end = first + count;
+
+	if (i & 1) {
+		_mm_stream_si128((__m128i *)(column + (i ^ swap) * 16),
+				 _mm_loadu_si128((const __m128i *)linear));
+		linear += stride;
+		i++;
+	}
+
+	for (; i + 1 < end; i += 2, linear += 2 * stride) {
+		__m128i a = _mm_loadu_si128((const __m128i *)linear);
+		__m128i b = _mm_loadu_si128((const __m128i *)(linear + stride));
+
+		_mm256_stream_si256((__m256i *)(column + (i ^ swap) * 16),
+				    _mm256_inserti128_si256(_mm256_castsi128_si256(a),
+							    b, 1));
+	}
+
+	if (i < end)
+		_mm_stream_si128((__m128i *)(column + (i ^ swap) * 16),
+				 _mm_loadu_si128((const __m128i *)linear));
+}
+
+__attribute__((target("avx2"))) static void
+y_from_tiled_avx2(uint8_t *linear, uint32_t stride, const uint8_t *column,
+		  unsigned first, unsigned count, unsigned swap)
+{
+	unsigned i = first, end = first + count;
+
+	if (i & 1) {
+		_mm_storeu_si128((__m128i *)linear,
+				 _mm_load_si128((const __m128i *)(column + (i ^ swap) * 16)));
+		linear += stride;
+		i++;
+	}
+
+	for (; i + 1 < end; i += 2, linear += 2 * stride) {
+		__m256i v = _mm256_stream_load_si256((__m256i *)(column + (i ^ swap) * 16));
+
+		_mm_storeu_si128((__m128i *)linear, _mm256_castsi256_si128(v));
+		_mm_storeu_si128((__m128i *)(linear + stride),
+				 _mm256_extracti128_si256(v, 1));
+	}
+
+	if (i < end)
+		_mm_storeu_si128((__m128i *)linear,
+				 _mm_load_si128((const __m128i *)(column + (i ^ swap) * 16)));
+}
+
+static const struct tiling_funcs tiling_avx2 = {
+	.x_to_tiled = x_to_tiled_avx2,
+	.x_from_tiled = x_from_tiled_avx2,
+	.y_to_tiled = y_to_tiled_avx2,
+	.y_from_tiled = y_from_tiled_avx2,
+	.fence = fence_sse2,
+};
+#endif
+
+static const struct tiling_funcs *tiling_funcs[INTEL_TILING_NUM_IMPLS] = {
+	[INTEL_TILING_IMPL_C] = &tiling_c,
+};
+
+static const struct tiling_funcs *funcs = &tiling_c;
+static pthread_once_t funcs_once = PTHREAD_ONCE_INIT;
+
+static void
+select_funcs(void)
+{
+#ifdef HAVE_TILING_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		tiling_funcs[INTEL_TILING_IMPL_SSE2] = &tiling_sse2;
+	if (__builtin_cpu_supports("avx2"))
+		tiling_funcs[INTEL_TILING_IMPL_AVX2] = &tiling_avx2;
+#endif
+
+	if (tiling_funcs[INTEL_TILING_IMPL_AVX2])
+		funcs = tiling_funcs[INTEL_TILING_IMPL_AVX2];
+	else if (tiling_funcs[INTEL_TILING_IMPL_SSE2])
+		funcs = tiling_funcs[INTEL_TILING_IMPL_SSE2];
+}
+
+int intel_tiling_set_impl(enum intel_tiling_impl impl)
+{
+	pthread_once(&funcs_once, select_funcs);
+
+	if (impl >= INTEL_TILING_NUM_IMPLS || !tiling_funcs[impl])
+		return -1;
+
+	funcs = tiling_funcs[impl];
+	return 0;
+}
+
+const char *intel_tiling_impl_name(enum intel_tiling_impl impl)
+{
+	static const char *names[INTEL_TILING_NUM_IMPLS] = {
+		[INTEL_TILING_IMPL_C] = "c",
+		[INTEL_TILING_IMPL_SSE2] = "sse2",
+		[INTEL_TILING_IMPL_AVX2] = "avx2",
+	};
+
+	return impl < INTEL_TILING_NUM_IMPLS ? names[impl] : "unknown";
+}
+
+void intel_tile_dims(const struct intel_tiled_surface *surf,
+		     unsigned *width, unsigned *height)
+{
+	switch (surf->tiling) {
+	case I915_TILING_NONE:
+		*width = 1;
+		*height = 1;
+		break;
+	case I915_TILING_X:
+		*width = surf->gen == 2 ? 128 : 512;
+		*height = surf->gen == 2 ? 16 : 8;
+		break;
+	case I915_TILING_Y:
+		assert(surf->gen != 2);
+		*width = 128;
+		*height = 32;
+		break;
+	default:
+		assert(0);
+	}
+}
+
+/* Whether the memory controller flips bit 6 of the tiled offset. */
+static unsigned
+swizzle_bit6(const struct intel_tiled_surface *surf, uint32_t offset)
+{
+	unsigned bit17 = surf->bit17 ? surf->bit17[offset >> 12] & 1 : 0;
+
+	switch (surf->swizzle) {
+	case I915_BIT_6_SWIZZLE_NONE:
+		return 0;
+	case I915_BIT_6_SWIZZLE_9:
+		return offset >> 9 & 1;
+	case I915_BIT_6_SWIZZLE_9_10:
+		return (offset >> 9 ^ offset >> 10) & 1;
+	case I915_BIT_6_SWIZZLE_9_11:
+		return (offset >> 9 ^ offset >> 11) & 1;
+	case I915_BIT_6_SWIZZLE_9_10_11:
+		return (offset >> 9 ^ offset >> 10 ^ offset >> 11) & 1;
+	case I915_BIT_6_SWIZZLE_9_17:
+		return (offset >> 9 & 1) ^ bit17;
+	case I915_BIT_6_SWIZZLE_9_10_17:
+		return ((offset >> 9 ^ offset >> 10) & 1) ^ bit17;
+	default:
+		assert(0);
+		return 0;
+	}
+}
+
+/* The offset of byte (x, y) before swizzling. */
+static uint32_t
+tile_offset(const struct intel_tiled_surface *surf, unsigned x, unsigned y)
+{
+	unsigned tw, th;
+	uint32_t tile;
+
+	intel_tile_dims(surf, &tw, &th);
+	if (surf->tiling == I915_TILING_NONE)
+		return y * surf->stride + x;
+
+	tile = (y / th * (surf->stride / tw) + x / tw) * tw * th;
+	if (surf->tiling == I915_TILING_X)
+		return tile + y % th * tw + x % tw;
+	else
+		return tile + x % tw / 16 * 512 + y % th * 16 + x % 16;
+}
+
+uint32_t intel_tiled_offset(const struct intel_tiled_surface *surf,
+			    unsigned x, unsigned y)
+{
+	uint32_t offset = tile_offset(surf, x, y);
+
+	/* only tiled surfaces are swizzled */
+	if (surf->tiling == I915_TILING_NONE)
+		return offset;
+
+	return offset ^ swizzle_bit6(surf, offset) << 6;
+}
+
+/* Moves width bytes at byte in of an X tile row, in the linear order. */
+static void
+copy_x_span(const struct tiling_funcs *f, uint8_t *row, unsigned in,
+	    uint8_t *linear, unsigned width, unsigned swap, bool to_tiled)
+{
+	unsigned n, chunks;
+
+	while (width) {
+		if (in % 64 || width < 64) {
+			n = 64 - in % 64;
+			if (n > width)
+				n = width;
+
+			if (to_tiled)
+				memcpy(row + (in ^ swap << 6), linear, n);
+			else
+				memcpy(linear, row + (in ^ swap << 6), n);
+		} else {
+			chunks = width / 64;
+			if (to_tiled)
+				f->x_to_tiled(row, linear, in / 64, chunks, swap);
+			else
+				f->x_from_tiled(linear, row, in / 64, chunks, swap);
+			n = chunks * 64;
+		}
+
+		in += n;
+		linear += n;
+		width -= n;
+	}
+}
+
+static void
+copy_x(const struct tiling_funcs *f, const struct intel_tiled_surface *surf,
+       unsigned x, unsigned y, uint8_t *linear, uint32_t stride,
+       unsigned width, unsigned height, bool to_tiled)
+{
+	unsigned tw, th, tx, n, i;
+	uint32_t offset;
+
+	intel_tile_dims(surf, &tw, &th);
+
+	for (i = 0; i < height; i++, y++, linear += stride) {
+		uint8_t *l = linear;
+
+		for (tx = x; tx < x + width; tx += n, l += n) {
+			n = tw - tx % tw;
+			if (n > x + width - tx)
+				n = x + width - tx;
+
+			offset = tile_offset(surf, tx - tx % tw, y);
+			copy_x_span(f, (uint8_t *)surf->ptr + offset, tx % tw,
+				    l, n, swizzle_bit6(surf, offset), to_tiled);
+		}
+	}
+}
+
+static void
+copy_y(const struct tiling_funcs *f, const struct intel_tiled_surface *surf,
+       unsigned x, unsigned y, uint8_t *linear, uint32_t stride,
+       unsigned width, unsigned height, bool to_tiled)
+{
+	unsigned rows, tx, n, i, r, swap;
+	uint32_t offset;
+
+	for (i = 0; i < height; i += rows, y += rows) {
+		uint8_t *l = linear + i * stride;
+
+		rows = 32 - y % 32;
+		if (rows > height - i)
+			rows = height - i;
+
+		for (tx = x; tx < x + width; tx += n, l += n) {
+			uint8_t *column;
+
+			n = 16 - tx % 16;
+			if (n > x + width - tx)
+				n = x + width - tx;
+
+			offset = tile_offset(surf, tx - tx % 16, y - y % 32);
+			column = (uint8_t *)surf->ptr + offset;
+			swap = swizzle_bit6(surf, offset) << 2;
+
+			if (n == 16) {
+				if (to_tiled)
+					f->y_to_tiled(column, l, stride,
+						      y % 32, rows, swap);
+				else
+					f->y_from_tiled(l, stride, column,
+							y % 32, rows, swap);
+				continue;
+			}
+
+			for (r = 0; r < rows; r++) {
+				uint8_t *t = column + ((y % 32 + r) ^ swap) * 16 +
+					     tx % 16;
+
+				if (to_tiled)
+					memcpy(t, l + r * stride, n);
+				else
+					memcpy(l + r * stride, t, n);
+			}
+		}
+	}
+}
+
+static void
+copy_linear(const struct intel_tiled_surface *surf, unsigned x, unsigned y,
+	    uint8_t *linear, uint32_t stride, unsigned width, unsigned height,
+	    bool to_tiled)
+{
+	uint8_t *row = (uint8_t *)surf->ptr + y * surf->stride + x;
+	unsigned i;
+
+	for (i = 0; i < height; i++, row += surf->stride, linear += stride) {
+		if (to_tiled)
+			memcpy(row, linear, width);
+		else
+			memcpy(linear, row, width);
+	}
+}
+
+static void
+tiling_copy(const struct intel_tiled_surface *surf, unsigned x, unsigned y,
+	    uint8_t *linear, uint32_t stride, unsigned width, unsigned height,
+	    bool to_tiled)
+{
+	const struct tiling_funcs *f;
+
+	pthread_once(&funcs_once, select_funcs);
+
+	/* The SIMD kernels use aligned accesses on the tiled side, which
+	 * holds for any bo mapping. */
+	f = (uintptr_t)surf->ptr & 31 ? &tiling_c : funcs;
+
+	switch (surf->tiling) {
+	case I915_TILING_NONE:
+		copy_linear(surf, x, y, linear, stride, width, height,
+			    to_tiled);
+		break;
+	case I915_TILING_X:
+		copy_x(f, surf, x, y, linear, stride, width, height, to_tiled);
+		break;
+	case I915_TILING_Y:
+		assert(surf->gen != 2);
+		copy_y(f, surf, x, y, linear, stride, width, height, to_tiled);
+		break;
+	default:
+		assert(0);
+	}
+
+	if (to_tiled)
+		f->fence();
+}
+
+/*
+ * Big copies are split into bands of whole tile rows and spread over a pool
+ * of threads.  Bands never share a tile, so no two threads write to the same
+ * cache lines on the tiled side.  A band is about BAND_SIZE bytes of tiles:
+ * small enough that both sides of it stay in the L2 of the thread working
+ * on it and that there are a few bands per thread to even out the load,
+ * large enough that handing them out under the lock doesn't show.  Bands
+ * are handed out in address order, so each thread streams through whole
+ * pages rather than interleaving with the others.
+ */
+#define BAND_SIZE (256 * 1024)
+
+/* Past a handful of threads the copies are limited by memory bandwidth. */
+#define MAX_DEFAULT_THREADS 8
+
+struct intel_tiling_job {
+	struct intel_tiled_surface surf;
+	unsigned x, y, width, height;
+	uint8_t *linear;
+	uint32_t stride;
+	bool to_tiled;
+
+	unsigned band_rows;	/* a multiple of the tile height */
+	unsigned num_bands;
+	unsigned next_band;	/* the next one to hand out */
+	unsigned done_bands;
+	struct intel_tiling_job *next;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work;	/* a job was queued, or stop was set */
+	pthread_cond_t done;	/* a job completed */
+	/* jobs with bands left to hand out */
+	struct intel_tiling_job *queue;
+	pthread_t *workers;
+	unsigned num_workers;
+	unsigned threads;	/* including the caller, 0 until first used */
+	bool stop;
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void
+job_init(struct intel_tiling_job *job, const struct intel_tiled_surface *surf,
+	 unsigned x, unsigned y, uint8_t *linear, uint32_t stride,
+	 unsigned width, unsigned height, bool to_tiled)
+{
+	unsigned tw, th, rows, first;
+	uint32_t tile_row_size;
+
+	memset(job, 0, sizeof(*job));
+	job->surf = *surf;
+	job->x = x;
+	job->y = y;
+	job->width = width;
+	job->height = height;
+	job->linear = linear;
+	job->stride = stride;
+	job->to_tiled = to_tiled;
+
+	intel_tile_dims(surf, &tw, &th);
+	tile_row_size = ((x + width + tw - 1) / tw - x / tw) * tw * th;
+	rows = BAND_SIZE / (tile_row_size ? tile_row_size : 1);
+	job->band_rows = th * (rows ? rows : 1);
+
+	first = y - y % job->band_rows;
+	job->num_bands = (y + height - first + job->band_rows - 1) /
+			 job->band_rows;
+}
+
+static void
+run_band(struct intel_tiling_job *job, unsigned band)
+{
+	unsigned start = job->y - job->y % job->band_rows +
+			 band * job->band_rows;
+	unsigned end = start + job->band_rows;
+
+	if (start < job->y)
+		start = job->y;
+	if (end > job->y + job->height)
+		end = job->y + job->height;
+
+	tiling_copy(&job->surf, job->x, start,
+		    job->linear + (start - job->y) * job->stride, job->stride,
+		    job->width, end - start, job->to_tiled);
+}
+
+/* Hands out the next band of job, unqueueing it with the last one.  Called
+ * with the lock held. */
+static unsigned
+take_band(struct intel_tiling_job *job)
+{
+	struct intel_tiling_job **p;
+	unsigned band = job->next_band++;
+
+	if (job->next_band == job->num_bands) {
+		for (p = &pool.queue; *p != job; p = &(*p)->next)
+			;
+		*p = job->next;
+	}
+
+	return band;
+}
+
+/* Called with the lock held. */
+static void
+band_done(struct intel_tiling_job *job)
+{
+	if (++job->done_bands == job->num_bands)
+		pthread_cond_broadcast(&pool.done);
+}
+
+static void *
+worker(void *arg)
+{
+	struct intel_tiling_job *job;
+	unsigned band;
+
+	pthread_mutex_lock(&pool.lock);
+	for (;;) {
+		job = pool.queue;
+		if (job == NULL) {
+			if (pool.stop)
+				break;
+			pthread_cond_wait(&pool.work, &pool.lock);
+			continue;
+		}
+
+		band = take_band(job);
+		pthread_mutex_unlock(&pool.lock);
+		run_band(job, band);
+		pthread_mutex_lock(&pool.lock);
+		band_done(job);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return NULL;
+}
+
+static unsigned
+default_threads(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (cpus < 1)
+		return 1;
+
+	return cpus < MAX_DEFAULT_THREADS ? cpus : MAX_DEFAULT_THREADS;
+}
+
+static void
+pool_prepare_fork(void)
+{
+	pthread_mutex_lock(&pool.lock);
+}
+
+static void
+pool_parent_fork(void)
+{
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/* The workers don't survive into the child, start over there. */
+static void
+pool_child_fork(void)
+{
+	free(pool.workers);
+	pool.workers = NULL;
+	pool.num_workers = 0;
+	pool.queue = NULL;
+	pthread_mutex_unlock(&pool.lock);
+}
+
+static void
+pool_init(void)
+{
+	pthread_atfork(pool_prepare_fork, pool_parent_fork, pool_child_fork);
+}
+
+/* Tops up the workers to one less than the thread count, the caller of the
+ * synchronous functions being the last one.  Called with the lock held. */
+static void
+start_workers(void)
+{
+	sigset_t all, old;
+	pthread_t *workers;
+
+	if (pool.threads == 0)
+		pool.threads = default_threads();
+	if (pool.num_workers >= pool.threads - 1)
+		return;
+
+	workers = realloc(pool.workers,
+			  (pool.threads - 1) * sizeof(*pool.workers));
+	if (workers == NULL)
+		return;
+	pool.workers = workers;
+
+	/* Leave the signals to the test's own threads. */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	while (pool.num_workers < pool.threads - 1) {
+		if (pthread_create(&pool.workers[pool.num_workers], NULL,
+				   worker, NULL))
+			break;
+		pool.num_workers++;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+/* Queues job for the workers, returns false if there are none. */
+static bool
+submit(struct intel_tiling_job *job)
+{
+	struct intel_tiling_job **p;
+
+	pthread_once(&pool_once, pool_init);
+
+	pthread_mutex_lock(&pool.lock);
+	start_workers();
+	if (pool.num_workers == 0) {
+		pthread_mutex_unlock(&pool.lock);
+		return false;
+	}
+
+	for (p = &pool.queue; *p; p = &(*p)->next)
+		;
+	*p = job;
+	pthread_cond_broadcast(&pool.work);
+	pthread_mutex_unlock(&pool.lock);
+
+	return true;
+}
+
+/* Works on the bands nobody took yet, then waits for the others. */
+static void
+finish(struct intel_tiling_job *job)
+{
+	unsigned band;
+
+	pthread_mutex_lock(&pool.lock);
+	while (job->next_band < job->num_bands) {
+		band = take_band(job);
+		pthread_mutex_unlock(&pool.lock);
+		run_band(job, band);
+		pthread_mutex_lock(&pool.lock);
+		band_done(job);
+	}
+
+	while (job->done_bands < job->num_bands)
+		pthread_cond_wait(&pool.done, &pool.lock);
+	pthread_mutex_unlock(&pool.lock);
+}
+
+static void
+copy_sync(const struct intel_tiled_surface *surf, unsigned x, unsigned y,
+	  uint8_t *linear, uint32_t stride, unsigned width, unsigned height,
+	  bool to_tiled)
+{
+	struct intel_tiling_job job;
+
+	job_init(&job, surf, x, y, linear, stride, width, height, to_tiled);
+	if (job.num_bands > 1 && submit(&job)) {
+		finish(&job);
+		return;
+	}
+
+	tiling_copy(surf, x, y, linear, stride, width, height, to_tiled);
+}
+
+static struct intel_tiling_job *
+copy_async(const struct intel_tiled_surface *surf, unsigned x, unsigned y,
+	   uint8_t *linear, uint32_t stride, unsigned width, unsigned height,
+	   bool to_tiled)
+{
+	struct intel_tiling_job *job;
+
+	job = malloc(sizeof(*job));
+	if (job == NULL) {
+		tiling_copy(surf, x, y, linear, stride, width, height,
+			    to_tiled);
+		return NULL;
+	}
+
+	job_init(job, surf, x, y, linear, stride, width, height, to_tiled);
+	if (job->num_bands == 0 || !submit(job)) {
+		tiling_copy(surf, x, y, linear, stride, width, height,
+			    to_tiled);
+		job->next_band = job->done_bands = job->num_bands;
+	}
+
+	return job;
+}
+
+void intel_linear_to_tiled(const struct intel_tiled_surface *dst,
+			   unsigned dst_x, unsigned dst_y,
+			   const void *src, uint32_t src_stride,
+			   unsigned width, unsigned height)
+{
+	copy_sync(dst, dst_x, dst_y, (uint8_t *)src, src_stride,
+		  width, height, true);
+}
+
+void intel_tiled_to_linear(void *dst, uint32_t dst_stride,
+			   const struct intel_tiled_surface *src,
+			   unsigned src_x, unsigned src_y,
+			   unsigned width, unsigned height)
+{
+	copy_sync(src, src_x, src_y, dst, dst_stride, width, height, false);
+}
+
+struct intel_tiling_job *
+intel_linear_to_tiled_async(const struct intel_tiled_surface *dst,
+			    unsigned dst_x, unsigned dst_y,
+			    const void *src, uint32_t src_stride,
+			    unsigned width, unsigned height)
+{
+	return copy_async(dst, dst_x, dst_y, (uint8_t *)src, src_stride,
+			  width, height, true);
+}
+
+struct intel_tiling_job *
+intel_tiled_to_linear_async(void *dst, uint32_t dst_stride,
+			    const struct intel_tiled_surface *src,
+			    unsigned src_x, unsigned src_y,
+			    unsigned width, unsigned height)
+{
+	return copy_async(src, src_x, src_y, dst, dst_stride, width, height,
+			  false);
+}
+
+bool intel_tiling_job_busy(struct intel_tiling_job *job)
+{
+	bool busy;
+
+	if (job == NULL)
+		return false;
+
+	pthread_mutex_lock(&pool.lock);
+	busy = job->done_bands < job->num_bands;
+	pthread_mutex_unlock(&pool.lock);
+
+	return busy;
+}
+
+void intel_tiling_job_wait(struct intel_tiling_job *job)
+{
+	if (job == NULL)
+		return;
+
+	finish(job);
+	free(job);
+}
+
+void intel_tiling_set_threads(unsigned threads)
+{
+	unsigned i;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.stop = true;
+	pthread_cond_broadcast(&pool.work);
+	pthread_mutex_unlock(&pool.lock);
+
+	/* the workers leave once the queue is empty */
+	for (i = 0; i < pool.num_workers; i++)
+		pthread_join(pool.workers[i], NULL);
+
+	pthread_mutex_lock(&pool.lock);
+	free(pool.workers);
+	pool.workers = NULL;
+	pool.num_workers = 0;
+	pool.stop = false;
+	pool.threads = threads ? threads : default_threads();
+	pthread_mutex_unlock(&pool.lock);
+}
+
+unsigned intel_tiling_get_threads(void)
+{
+	unsigned threads;
+
+	pthread_mutex_lock(&pool.lock);
+	if (pool.threads == 0)
+		pool.threads = default_threads();
+	threads = pool.threads;
+	pthread_mutex_unlock(&pool.lock);
+
+	return threads;
+}
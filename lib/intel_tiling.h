@@ -0,0 +1,111 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef INTEL_TILING_H
+#define INTEL_TILING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * CPU conversion between linear buffers and the layout of tiled bos as seen
+ * through a CPU mmap or pread/pwrite, i.e. without a fence detiling them.
+ *
+ * X tiles are 512 bytes x 8 rows stored row by row, 2KiB 128 x 16 tiles on
+ * gen2.  Y tiles are 128 bytes x 32 rows stored as 16 byte wide columns.
+ * Tiles follow each other left to right across the stride.  On top of that
+ * the memory controller flips bit 6 of the address with the bits given by
+ * the swizzle mode GET_TILING reports.  The _17 modes also use bit 17 of the
+ * physical address, which userspace can't know: bit17 gives it for each
+ * page of the bo, NULL treats it as 0, which is what pread and pwrite
+ * present.  Gen2 has no Y tiling here.
+ *
+ * x and width are in bytes throughout.  Copies go through SSE2 or AVX2 with
+ * non-temporal stores to the tiled side when the CPU has them.  Copies of
+ * more than a few hundred KiB are split by tile rows over a pool of threads.
+ */
+
+struct intel_tiled_surface {
+	void *ptr;		/* start of the bo */
+	uint32_t stride;	/* a multiple of the tile width */
+	uint32_t tiling;	/* I915_TILING_* */
+	uint32_t swizzle;	/* I915_BIT_6_SWIZZLE_* */
+	int gen;		/* intel_gen() of the device, 0 is as gen3+ */
+	const uint8_t *bit17;	/* bit 0: bit 17 of each page's address */
+};
+
+enum intel_tiling_impl {
+	INTEL_TILING_IMPL_C,
+	INTEL_TILING_IMPL_SSE2,
+	INTEL_TILING_IMPL_AVX2,
+	INTEL_TILING_NUM_IMPLS
+};
+
+void intel_tile_dims(const struct intel_tiled_surface *surf,
+		     unsigned *width, unsigned *height);
+uint32_t intel_tiled_offset(const struct intel_tiled_surface *surf,
+			    unsigned x, unsigned y);
+
+void intel_linear_to_tiled(const struct intel_tiled_surface *dst,
+			   unsigned dst_x, unsigned dst_y,
+			   const void *src, uint32_t src_stride,
+			   unsigned width, unsigned height);
+void intel_tiled_to_linear(void *dst, uint32_t dst_stride,
+			   const struct intel_tiled_surface *src,
+			   unsigned src_x, unsigned src_y,
+			   unsigned width, unsigned height);
+
+/*
+ * The asynchronous versions return as soon as the copy is queued for the
+ * pool, or NULL if it had to be done before returning.  The surface
+ * description is copied, the memory on both sides has to stay around until
+ * intel_tiling_job_wait(), which helps with what's left of the copy, waits
+ * for the rest and frees the job.
+ */
+struct intel_tiling_job;
+
+struct intel_tiling_job *
+intel_linear_to_tiled_async(const struct intel_tiled_surface *dst,
+			    unsigned dst_x, unsigned dst_y,
+			    const void *src, uint32_t src_stride,
+			    unsigned width, unsigned height);
+struct intel_tiling_job *
+intel_tiled_to_linear_async(void *dst, uint32_t dst_stride,
+			    const struct intel_tiled_surface *src,
+			    unsigned src_x, unsigned src_y,
+			    unsigned width, unsigned height);
+bool intel_tiling_job_busy(struct intel_tiling_job *job);
+void intel_tiling_job_wait(struct intel_tiling_job *job);
+
+/* Threads used for big copies, including the caller's.  The default of 0 is
+ * the number of CPUs, up to 8.  Not to be called with copies in flight. */
+void intel_tiling_set_threads(unsigned threads);
+unsigned intel_tiling_get_threads(void);
+
+/* The best implementation the CPU supports is used by default, this is for
+ * comparing them.  Returns -1 if impl isn't available. */
+int intel_tiling_set_impl(enum intel_tiling_impl impl);
+const char *intel_tiling_impl_name(enum intel_tiling_impl impl);
+
+#endif /* INTEL_TILING_H */
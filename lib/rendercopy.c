@@ -0,0 +1,198 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * The generation independent parts of rendercopy: picking the backend for
+ * a device, the blitter fill used where the render engine can't fill, and
+ * the sorting of copy lists shared by the backends.
+ */
+
+#include "rendercopy.h"
+#include "intel_batch_packets.h"
+
+render_copyfunc_t get_render_copyfunc(int devid)
+{
+	render_copyfunc_t copy = NULL;
+
+	if (IS_GEN2(devid))
+		copy = gen2_render_copyfunc;
+	else if (IS_GEN3(devid))
+		copy = gen3_render_copyfunc;
+	else if (IS_GEN6(devid))
+		copy = gen6_render_copyfunc;
+	else if (IS_GEN7(devid))
+		copy = gen7_render_copyfunc;
+
+	return copy;
+}
+
+render_copylistfunc_t get_render_copylistfunc(int devid)
+{
+	render_copylistfunc_t copy = NULL;
+
+	if (IS_GEN2(devid))
+		copy = gen2_render_copylist;
+	else if (IS_GEN3(devid))
+		copy = gen3_render_copylist;
+	else if (IS_GEN6(devid))
+		copy = gen6_render_copylist;
+	else if (IS_GEN7(devid))
+		copy = gen7_render_copylist;
+
+	return copy;
+}
+
+render_fillfunc_t get_render_fillfunc(int devid)
+{
+	render_fillfunc_t fill = blt_render_fillfunc;
+
+	if (IS_GEN6(devid))
+		fill = gen6_render_fillfunc;
+	else if (IS_GEN7(devid))
+		fill = gen7_render_fillfunc;
+
+	return fill;
+}
+
+render_convertfunc_t get_render_convertfunc(int devid)
+{
+	render_convertfunc_t convert = NULL;
+
+	if (IS_GEN7(devid))
+		convert = gen7_render_convert;
+
+	return convert;
+}
+
+void blt_render_fillfunc(struct intel_batchbuffer *batch,
+			 struct scratch_buf *dst,
+			 const struct render_rect *rects, int count,
+			 uint32_t color)
+{
+	struct xy_color_blt blt;
+	uint32_t cmd_bits = 0, pitch = dst->stride, offset;
+	int i;
+
+	/* From gen4 the blitter takes the tiling from the command rather than
+	 * the fence, and XY_COLOR_BLT_TILED only means X. */
+	if (IS_965(batch->devid) && dst->tiling != I915_TILING_NONE) {
+		assert(dst->tiling == I915_TILING_X);
+		pitch /= 4;
+		cmd_bits |= XY_COLOR_BLT_TILED;
+	}
+
+	for (i = 0; i < count; i++) {
+		const struct render_rect *r = &rects[i];
+
+		blt = (struct xy_color_blt) {
+			.cmd = XY_COLOR_BLT_CMD |
+			       XY_COLOR_BLT_WRITE_ALPHA |
+			       XY_COLOR_BLT_WRITE_RGB |
+			       cmd_bits,
+			.br13 = (3 << 24) | /* 32 bits */
+				(0xf0 << 16) | /* pattern copy ROP */
+				pitch,
+			.dst_x1y1 = BLT_XY(r->x, r->y),
+			.dst_x2y2 = BLT_XY(r->x + r->width, r->y + r->height),
+			.color = color,
+		};
+		offset = OUT_PACKET(blt);
+		OUT_PACKET_RELOC_FENCED(offset, blt, dst, dst->bo,
+					I915_GEM_DOMAIN_RENDER,
+					I915_GEM_DOMAIN_RENDER, 0);
+	}
+
+	intel_batchbuffer_flush(batch);
+}
+
+/* Fills all of dst with color. */
+void render_clear(struct intel_batchbuffer *batch,
+		  struct scratch_buf *dst, uint32_t color)
+{
+	struct render_rect rect = {
+		0, 0, buf_width(dst), buf_height(dst)
+	};
+
+	get_render_fillfunc(batch->devid)(batch, dst, &rect, 1, color);
+}
+
+static int surface_cmp(const struct scratch_buf *a, const struct scratch_buf *b)
+{
+	if (a->bo != b->bo)
+		return (uintptr_t)a->bo < (uintptr_t)b->bo ? -1 : 1;
+	if (a->stride != b->stride)
+		return a->stride < b->stride ? -1 : 1;
+	if (a->tiling != b->tiling)
+		return a->tiling < b->tiling ? -1 : 1;
+	if (a->size != b->size)
+		return a->size < b->size ? -1 : 1;
+	return 0;
+}
+
+static int render_copy_cmp(const void *A, const void *B)
+{
+	const struct render_copy *a = *(const struct render_copy **)A;
+	const struct render_copy *b = *(const struct render_copy **)B;
+	int ret;
+
+	ret = surface_cmp(a->src, b->src);
+	if (ret == 0)
+		ret = surface_cmp(a->dst, b->dst);
+	if (ret == 0) /* keep list order within a group */
+		ret = a < b ? -1 : a > b;
+
+	return ret;
+}
+
+/*
+ * Returns the copies reordered so that those between the same pair of
+ * surfaces are next to each other, to be freed by the caller.
+ */
+const struct render_copy **render_copy_sort(const struct render_copy *copies,
+					    int count)
+{
+	const struct render_copy **order;
+	int i;
+
+	order = malloc(count * sizeof(*order));
+	assert(order);
+	for (i = 0; i < count; i++)
+		order[i] = &copies[i];
+	qsort(order, count, sizeof(*order), render_copy_cmp);
+
+	return order;
+}
+
+/* How many of the sorted copies share the first one's surfaces. */
+int render_copy_group(const struct render_copy **copies, int count)
+{
+	int n = 1;
+
+	while (n < count &&
+	       surface_cmp(copies[n]->src, copies[0]->src) == 0 &&
+	       surface_cmp(copies[n]->dst, copies[0]->dst) == 0)
+		n++;
+
+	return n;
+}
@@ -65,6 +65,111 @@ typedef void (*render_copyfunc_t)(struct intel_batchbuffer *batch,
 
 render_copyfunc_t get_render_copyfunc(int devid);
 
+/* One rectangle of a render copy list. */
+struct render_copy {
+	struct scratch_buf *src;
+	unsigned src_x, src_y;
+	unsigned width, height;
+	struct scratch_buf *dst;
+	unsigned dst_x, dst_y;
+};
+
+/*
+ * Copies count rectangles and submits them.  The copies must be independent
+ * of each other: none may read what another one in the same list writes.
+ * That lets them be regrouped by surface pair, each group drawn as a single
+ * rectlist, and the batch only flushed when it fills up.
+ */
+typedef void (*render_copylistfunc_t)(struct intel_batchbuffer *batch,
+				      const struct render_copy *copies,
+				      int count);
+
+render_copylistfunc_t get_render_copylistfunc(int devid);
+
+const struct render_copy **render_copy_sort(const struct render_copy *copies,
+					    int count);
+int render_copy_group(const struct render_copy **copies, int count);
+
+/* One rectangle of a render fill. */
+struct render_rect {
+	unsigned x, y;
+	unsigned width, height;
+};
+
+/* Channel c (0 red, 1 green, 2 blue, 3 alpha) of a B8G8R8A8 colour. */
+static inline float color_channel(uint32_t color, int c)
+{
+	static const int shift[4] = { 16, 8, 0, 24 };
+
+	return (color >> shift[c] & 0xff) / 255.f;
+}
+
+/*
+ * Fills count rectangles of dst with color, a B8G8R8A8 pixel value, and
+ * submits them.  Every generation has one: where the render engine can't be
+ * used the rectangles are filled with the blitter, which can't fill Y-tiled
+ * surfaces on gen4 and gen5.
+ */
+typedef void (*render_fillfunc_t)(struct intel_batchbuffer *batch,
+				  struct scratch_buf *dst,
+				  const struct render_rect *rects, int count,
+				  uint32_t color);
+
+render_fillfunc_t get_render_fillfunc(int devid);
+
+void render_clear(struct intel_batchbuffer *batch,
+		  struct scratch_buf *dst, uint32_t color);
+
+/*
+ * Pixel formats for render_convertfunc_t.  The planar YUV formats keep all
+ * their planes in one linear buffer: the full size luma plane with the
+ * buffer's stride, then the 2x2 subsampled chroma, U and V planes at half
+ * the stride for I420 and one interleaved UV plane at the full stride for
+ * NV12.  They can only be read and are converted to RGB with the BT.601
+ * limited range matrix.
+ */
+enum render_format {
+	RENDER_FORMAT_ARGB8888,
+	RENDER_FORMAT_RGB565,
+	RENDER_FORMAT_ARGB2101010,
+	RENDER_FORMAT_I420,
+	RENDER_FORMAT_NV12,
+};
+
+unsigned render_format_width(struct scratch_buf *buf,
+			     enum render_format format);
+unsigned render_format_height(struct scratch_buf *buf,
+			      enum render_format format);
+bool render_format_is_yuv(enum render_format format);
+
+/*
+ * Copies a src_width x src_height rectangle of src to a dst_width x
+ * dst_height one of dst, converting between the formats and scaling with
+ * bilinear filtering when the sizes differ, and submits it.
+ */
+typedef void (*render_convertfunc_t)(struct intel_batchbuffer *batch,
+				     struct scratch_buf *src,
+				     enum render_format src_format,
+				     unsigned src_x, unsigned src_y,
+				     unsigned src_width, unsigned src_height,
+				     struct scratch_buf *dst,
+				     enum render_format dst_format,
+				     unsigned dst_x, unsigned dst_y,
+				     unsigned dst_width, unsigned dst_height);
+
+render_convertfunc_t get_render_convertfunc(int devid);
+
+/* The same conversion on the CPU, through src->data and dst->data, for
+ * checking the GPU results against. */
+void render_convert_reference(struct scratch_buf *src,
+			      enum render_format src_format,
+			      unsigned src_x, unsigned src_y,
+			      unsigned src_width, unsigned src_height,
+			      struct scratch_buf *dst,
+			      enum render_format dst_format,
+			      unsigned dst_x, unsigned dst_y,
+			      unsigned dst_width, unsigned dst_height);
+
 void gen7_render_copyfunc(struct intel_batchbuffer *batch,
 			  struct scratch_buf *src, unsigned src_x, unsigned src_y,
 			  unsigned width, unsigned height,
@@ -81,3 +186,35 @@ void gen2_render_copyfunc(struct intel_batchbuffer *batch,
 			  struct scratch_buf *src, unsigned src_x, unsigned src_y,
 			  unsigned width, unsigned height,
 			  struct scratch_buf *dst, unsigned dst_x, unsigned dst_y);
+
+void gen7_render_copylist(struct intel_batchbuffer *batch,
+			  const struct render_copy *copies, int count);
+void gen6_render_copylist(struct intel_batchbuffer *batch,
+			  const struct render_copy *copies, int count);
+void gen3_render_copylist(struct intel_batchbuffer *batch,
+			  const struct render_copy *copies, int count);
+void gen2_render_copylist(struct intel_batchbuffer *batch,
+			  const struct render_copy *copies, int count);
+
+void gen7_render_fillfunc(struct intel_batchbuffer *batch,
+			  struct scratch_buf *dst,
+			  const struct render_rect *rects, int count,
+			  uint32_t color);
+void gen6_render_fillfunc(struct intel_batchbuffer *batch,
+			  struct scratch_buf *dst,
+			  const struct render_rect *rects, int count,
+			  uint32_t color);
+void blt_render_fillfunc(struct intel_batchbuffer *batch,
+			 struct scratch_buf *dst,
+			 const struct render_rect *rects, int count,
+			 uint32_t color);
+
+void gen7_render_convert(struct intel_batchbuffer *batch,
+			 struct scratch_buf *src,
+			 enum render_format src_format,
+			 unsigned src_x, unsigned src_y,
+			 unsigned src_width, unsigned src_height,
+			 struct scratch_buf *dst,
+			 enum render_format dst_format,
+			 unsigned dst_x, unsigned dst_y,
+			 unsigned dst_width, unsigned dst_height);
@@ -2,6 +2,7 @@
 #include "gen6_render.h"
 
 #include <assert.h>
+#include <pthread.h>
 
 #define ALIGN(x, y) (((x) + (y)-1) & ~((y)-1))
 #define VERTEX_SIZE (3*4)
@@ -33,6 +34,27 @@ static const uint32_t ps_kernel_nomask_affine[][4] = {
 	{ 0x0000007e, 0x00000000, 0x00000000, 0x00000000 },
 };
 
+/* Writes a constant colour, patched into the mov immediates (R, R, G, G,
+ * B, B, A, A) by gen6_create_fill_kernel(). */
+static const uint32_t ps_kernel_fill[][4] = {
+	{ 0x00600201, 0x204003fe, 0x00000000, 0x00000000 },
+	{ 0x00600201, 0x206003fe, 0x00000000, 0x00000000 },
+	{ 0x00600201, 0x208003fe, 0x00000000, 0x00000000 },
+	{ 0x00600201, 0x20a003fe, 0x00000000, 0x00000000 },
+	{ 0x00600201, 0x20c003fe, 0x00000000, 0x00000000 },
+	{ 0x00600201, 0x20e003fe, 0x00000000, 0x00000000 },
+	{ 0x00600201, 0x210003fe, 0x00000000, 0x00000000 },
+	{ 0x00600201, 0x212003fe, 0x00000000, 0x00000000 },
+	{ 0x05800031, 0x24001cc8, 0x00000040, 0x90019000 },
+	{ 0x0000007e, 0x00000000, 0x00000000, 0x00000000 },
+	{ 0x0000007e, 0x00000000, 0x00000000, 0x00000000 },
+	{ 0x0000007e, 0x00000000, 0x00000000, 0x00000000 },
+	{ 0x0000007e, 0x00000000, 0x00000000, 0x00000000 },
+	{ 0x0000007e, 0x00000000, 0x00000000, 0x00000000 },
+	{ 0x0000007e, 0x00000000, 0x00000000, 0x00000000 },
+	{ 0x0000007e, 0x00000000, 0x00000000, 0x00000000 },
+};
+
 static uint32_t
 batch_used(struct intel_batchbuffer *batch)
 {
@@ -77,25 +99,44 @@ batch_copy(struct intel_batchbuffer *batch, const void *ptr, uint32_t size, uint
 	return batch_offset(batch, memcpy(batch_alloc(batch, size, align), ptr, size));
 }
 
+/* Where the invariant state lives in batch->render_state, and the invariant
+ * commands pointing at it.  Both come out the same for every batch, so they
+ * are only stored by the first one, under the lock as batches may be used
+ * from several threads. */
+static struct {
+	pthread_mutex_t lock;
+	int have_offsets;
+
+	uint32_t cc_state;
+	uint32_t wm_kernel;
+	uint32_t wm_state;
+	uint32_t cc_vp;
+	uint32_t cc_blend;
+
+	uint32_t cmds[128];
+	unsigned int num_cmds;
+} gen6_state = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
 static void
-gen6_render_flush(struct intel_batchbuffer *batch, uint32_t batch_end)
+gen6_render_flush(struct intel_batchbuffer *batch,
+		  uint32_t batch_end, uint32_t size)
 {
 	int ret;
 
-	ret = drm_intel_bo_subdata(batch->bo, 0, 4096, batch->buffer);
+	ret = intel_batchbuffer_upload(batch, size);
 	if (ret == 0)
-		ret = drm_intel_bo_mrb_exec(batch->bo, batch_end,
-					    NULL, 0, 0, 0);
+		ret = intel_batchbuffer_exec(batch, batch_end, 0);
 	assert(ret == 0);
 }
 
 static uint32_t
-gen6_bind_buf(struct intel_batchbuffer *batch, struct scratch_buf *buf,
-	      uint32_t format, int is_dst)
+gen6_emit_surface(struct intel_batchbuffer *batch,
+		  struct gen6_surface_state *ss, struct scratch_buf *buf,
+		  uint32_t format, int is_dst)
 {
-	struct gen6_surface_state *ss;
 	uint32_t write_domain, read_domain;
-	int ret;
 
 	if (is_dst) {
 		write_domain = read_domain = I915_GEM_DOMAIN_RENDER;
@@ -104,7 +145,6 @@ gen6_bind_buf(struct intel_batchbuffer *batch, struct scratch_buf *buf,
 		read_domain = I915_GEM_DOMAIN_SAMPLER;
 	}
 
-	ss = batch_alloc(batch, sizeof(*ss), 32);
 	ss->ss0.surface_type = GEN6_SURFACE_2D;
 	ss->ss0.surface_format = format;
 
@@ -112,11 +152,9 @@ gen6_bind_buf(struct intel_batchbuffer *batch, struct scratch_buf *buf,
 	ss->ss0.color_blend = 1;
 	ss->ss1.base_addr = buf->bo->offset;
 
-	ret = drm_intel_bo_emit_reloc(batch->bo,
-				      batch_offset(batch, ss) + 4,
-				      buf->bo, 0,
-				      read_domain, write_domain);
-	assert(ret == 0);
+	intel_batchbuffer_emit_reloc_at(batch, batch_offset(batch, ss) + 4,
+					buf->bo, 0,
+					read_domain, write_domain, 0);
 
 	ss->ss2.height = buf_height(buf) - 1;
 	ss->ss2.width  = buf_width(buf) - 1;
@@ -127,6 +165,14 @@ gen6_bind_buf(struct intel_batchbuffer *batch, struct scratch_buf *buf,
 	return batch_offset(batch, ss);
 }
 
+static uint32_t
+gen6_bind_buf(struct intel_batchbuffer *batch, struct scratch_buf *buf,
+	      uint32_t format, int is_dst)
+{
+	return gen6_emit_surface(batch, batch_alloc(batch, 32, 32),
+				 buf, format, is_dst);
+}
+
 static uint32_t
 gen6_bind_surfaces(struct intel_batchbuffer *batch,
 		   struct scratch_buf *src,
@@ -162,18 +208,19 @@ gen6_emit_urb(struct intel_batchbuffer *batch)
 }
 
 static void
-gen6_emit_state_base_address(struct intel_batchbuffer *batch)
+gen6_emit_state_base_address(struct intel_batchbuffer *batch,
+			     drm_intel_bo *instruction)
 {
 	OUT_BATCH(GEN6_STATE_BASE_ADDRESS | (10 - 2));
 	OUT_BATCH(0); /* general */
 	OUT_RELOC(batch->bo, /* surface */
 		  I915_GEM_DOMAIN_INSTRUCTION, 0,
 		  BASE_ADDRESS_MODIFY);
-	OUT_RELOC(batch->bo, /* instruction */
+	OUT_RELOC(batch->render_state, /* dynamic */
 		  I915_GEM_DOMAIN_INSTRUCTION, 0,
 		  BASE_ADDRESS_MODIFY);
 	OUT_BATCH(0); /* indirect */
-	OUT_RELOC(batch->bo, /* dynamic */
+	OUT_RELOC(instruction, /* instruction */
 		  I915_GEM_DOMAIN_INSTRUCTION, 0,
 		  BASE_ADDRESS_MODIFY);
 
@@ -287,8 +334,8 @@ gen6_emit_cc(struct intel_batchbuffer *batch, uint32_t blend)
 {
 	OUT_BATCH(GEN6_3DSTATE_CC_STATE_POINTERS | (4 - 2));
 	OUT_BATCH(blend | 1);
-	OUT_BATCH(1024 | 1);
-	OUT_BATCH(1024 | 1);
+	OUT_BATCH(gen6_state.cc_state | 1);
+	OUT_BATCH(gen6_state.cc_state | 1);
 }
 
 static void
@@ -498,6 +545,7 @@ gen6_create_sampler(struct intel_batchbuffer *batch,
 	return batch_offset(batch, ss);
 }
 
+/* Vertex buffer 0 is the whole batch, vertices are found by index. */
 static void gen6_emit_vertex_buffer(struct intel_batchbuffer *batch)
 {
 	OUT_BATCH(GEN6_3DSTATE_VERTEX_BUFFERS | 3);
@@ -528,49 +576,110 @@ static uint32_t gen6_emit_primitive(struct intel_batchbuffer *batch)
 	return offset;
 }
 
-void gen6_render_copyfunc(struct intel_batchbuffer *batch,
-			  struct scratch_buf *src, unsigned src_x, unsigned src_y,
-			  unsigned width, unsigned height,
-			  struct scratch_buf *dst, unsigned dst_x, unsigned dst_y)
+/*
+ * Lay the invariant state out in the empty batch with the usual helpers and
+ * move it to a bo of its own, which all later copies through this batch
+ * point at instead of carrying their own copy.
+ */
+static void
+gen6_create_render_state(struct intel_batchbuffer *batch)
 {
-	uint32_t wm_state, wm_kernel, wm_table;
-	uint32_t cc_vp, cc_blend, offset;
-	uint32_t batch_end;
-
-	intel_batchbuffer_flush(batch);
+	uint32_t cc_state, wm_kernel, wm_state, cc_vp, cc_blend;
+	uint32_t size;
 
-	batch->ptr = batch->buffer + 1024;
-	batch_alloc(batch, 64, 64);
-	wm_table  = gen6_bind_surfaces(batch, src, dst);
+	batch->ptr = batch->buffer;
+	cc_state = batch_offset(batch, batch_alloc(batch, 64, 64));
 	wm_kernel = gen6_create_kernel(batch);
-	wm_state  = gen6_create_sampler(batch,
-					SAMPLER_FILTER_NEAREST,
-					SAMPLER_EXTEND_NONE);
-
+	wm_state = gen6_create_sampler(batch,
+				       SAMPLER_FILTER_NEAREST,
+				       SAMPLER_EXTEND_NONE);
 	cc_vp = gen6_create_cc_viewport(batch);
 	cc_blend = gen6_create_cc_blend(batch);
+	size = batch_used(batch);
+
+	pthread_mutex_lock(&gen6_state.lock);
+	if (!gen6_state.have_offsets) {
+		gen6_state.cc_state = cc_state;
+		gen6_state.wm_kernel = wm_kernel;
+		gen6_state.wm_state = wm_state;
+		gen6_state.cc_vp = cc_vp;
+		gen6_state.cc_blend = cc_blend;
+		gen6_state.have_offsets = 1;
+	}
+	assert(gen6_state.cc_blend == cc_blend);
+	pthread_mutex_unlock(&gen6_state.lock);
+
+	batch->render_state = drm_intel_bo_alloc(batch->bufmgr, "render state",
+						 ALIGN(size, 4096), 4096);
+	assert(batch->render_state);
+	do_or_die(drm_intel_bo_subdata(batch->render_state, 0, size,
+				       batch->buffer));
 
 	batch->ptr = batch->buffer;
+}
 
-	gen6_emit_invariant(batch);
-	gen6_emit_state_base_address(batch);
+/* Everything between STATE_BASE_ADDRESS and the per-copy commands.  None of
+ * it changes, so after the first copy it is replayed from gen6_state. */
+static void
+gen6_emit_static_state(struct intel_batchbuffer *batch)
+{
+	uint8_t *start = batch->ptr;
+
+	pthread_mutex_lock(&gen6_state.lock);
+	if (gen6_state.num_cmds) {
+		intel_batchbuffer_data(batch, gen6_state.cmds,
+				       4 * gen6_state.num_cmds);
+		pthread_mutex_unlock(&gen6_state.lock);
+		return;
+	}
 
 	gen6_emit_sip(batch);
 	gen6_emit_urb(batch);
 
-	gen6_emit_viewports(batch, cc_vp);
+	gen6_emit_viewports(batch, gen6_state.cc_vp);
 	gen6_emit_vs(batch);
 	gen6_emit_gs(batch);
 	gen6_emit_clip(batch);
 	gen6_emit_wm_constants(batch);
 	gen6_emit_null_depth_buffer(batch);
 
-	gen6_emit_drawing_rectangle(batch, dst);
-	gen6_emit_cc(batch, cc_blend);
-	gen6_emit_sampler(batch, wm_state);
+	gen6_emit_cc(batch, gen6_state.cc_blend);
+	gen6_emit_sampler(batch, gen6_state.wm_state);
 	gen6_emit_sf(batch);
-	gen6_emit_wm(batch, wm_kernel);
+	gen6_emit_wm(batch, gen6_state.wm_kernel);
 	gen6_emit_vertex_elements(batch);
+
+	assert(batch->ptr - start <= sizeof(gen6_state.cmds));
+	memcpy(gen6_state.cmds, start, batch->ptr - start);
+	gen6_state.num_cmds = (batch->ptr - start) / 4;
+	pthread_mutex_unlock(&gen6_state.lock);
+}
+
+#define BATCH_STATE_SPLIT 1024
+void gen6_render_copyfunc(struct intel_batchbuffer *batch,
+			  struct scratch_buf *src, unsigned src_x, unsigned src_y,
+			  unsigned width, unsigned height,
+			  struct scratch_buf *dst, unsigned dst_x, unsigned dst_y)
+{
+	uint32_t wm_table, offset;
+	uint32_t batch_end, state_end;
+
+	intel_batchbuffer_flush(batch);
+
+	if (!batch->render_state)
+		gen6_create_render_state(batch);
+
+	batch->ptr = batch->buffer + BATCH_STATE_SPLIT;
+	wm_table  = gen6_bind_surfaces(batch, src, dst);
+	state_end = batch_used(batch);
+
+	batch->ptr = batch->buffer;
+
+	gen6_emit_invariant(batch);
+	gen6_emit_state_base_address(batch, batch->render_state);
+	gen6_emit_static_state(batch);
+
+	gen6_emit_drawing_rectangle(batch, dst);
 	gen6_emit_binding_table(batch, wm_table);
 
 	gen6_emit_vertex_buffer(batch);
@@ -593,7 +702,259 @@ void gen6_render_copyfunc(struct intel_batchbuffer *batch,
 	emit_vertex_2s(batch, dst_x, dst_y);
 	emit_vertex_normalized(batch, src_x, buf_width(src));
 	emit_vertex_normalized(batch, src_y, buf_height(src));
+	assert(batch_used(batch) <= BATCH_STATE_SPLIT);
+
+	gen6_render_flush(batch, batch_end, state_end);
+	intel_batchbuffer_reset(batch);
+}
+
+/*
+ * The list variant fills the batch from both ends: commands grow up from
+ * the start as usual, surface state and vertices grow down from the end
+ * through batch->state.  The batch is submitted when they would meet.
+ */
+static void *
+state_alloc(struct intel_batchbuffer *batch, uint32_t size, uint32_t align)
+{
+	uint32_t offset = batch->state - batch->buffer;
+
+	assert(offset >= size);
+	offset = (offset - size) / align * align;
+	batch->state = batch->buffer + offset;
+
+	return memset(batch->state, 0, size);
+}
+
+static uint32_t
+state_space(struct intel_batchbuffer *batch)
+{
+	return batch->state - batch->ptr;
+}
+
+/* Commands for a group (binding table, drawing rectangle and primitive)
+ * with the batch end, the state to bind its surfaces including alignment,
+ * and one rectangle. */
+#define GEN6_GROUP_SPACE	(14*4 + 8)
+#define GEN6_BIND_SPACE		(3*32 + 32 + VERTEX_SIZE)
+#define GEN6_RECT_SPACE		(3*VERTEX_SIZE)
+
+static void
+gen6_start_list(struct intel_batchbuffer *batch, drm_intel_bo *instruction)
+{
+	batch->ptr = batch->buffer;
+	batch->state = batch->buffer + batch->size;
+
+	gen6_emit_invariant(batch);
+	gen6_emit_state_base_address(batch, instruction);
+	gen6_emit_static_state(batch);
+	gen6_emit_vertex_buffer(batch);
+}
+
+static void
+gen6_submit_list(struct intel_batchbuffer *batch)
+{
+	uint32_t batch_end;
 
-	gen6_render_flush(batch, batch_end);
+	OUT_BATCH(MI_BATCH_BUFFER_END);
+	batch_end = batch_align(batch, 8);
+	assert(batch_end <= batch->state - batch->buffer);
+
+	gen6_render_flush(batch, batch_end, batch->size);
 	intel_batchbuffer_reset(batch);
 }
+
+static uint32_t
+float_bits(float f)
+{
+	union { float f; uint32_t ui; } u;
+
+	u.f = f;
+	return u.ui;
+}
+
+static void
+gen6_emit_rectlist(struct intel_batchbuffer *batch, void *vertices, int count)
+{
+	OUT_BATCH(GEN6_3DPRIMITIVE |
+		  GEN6_3DPRIMITIVE_VERTEX_SEQUENTIAL |
+		  _3DPRIM_RECTLIST << GEN6_3DPRIMITIVE_TOPOLOGY_SHIFT |
+		  0 << 9 |
+		  4);
+	OUT_BATCH(3 * count);	/* vertex count */
+	OUT_BATCH(batch_offset(batch, vertices) / VERTEX_SIZE);
+	OUT_BATCH(1);	/* single instance */
+	OUT_BATCH(0);	/* start instance location */
+	OUT_BATCH(0);	/* index buffer offset, ignored */
+}
+
+static void
+gen6_emit_rects(struct intel_batchbuffer *batch,
+		const struct render_copy **copies, int count)
+{
+	struct scratch_buf *src = copies[0]->src;
+	float w = buf_width(src), h = buf_height(src);
+	uint32_t *v;
+	int i;
+
+	v = state_alloc(batch, count * GEN6_RECT_SPACE, VERTEX_SIZE);
+	gen6_emit_rectlist(batch, v, count);
+
+	for (i = 0; i < count; i++) {
+		const struct render_copy *c = copies[i];
+
+		*v++ = (c->dst_y + c->height) << 16 | (c->dst_x + c->width);
+		*v++ = float_bits((c->src_x + c->width) / w);
+		*v++ = float_bits((c->src_y + c->height) / h);
+
+		*v++ = (c->dst_y + c->height) << 16 | c->dst_x;
+		*v++ = float_bits(c->src_x / w);
+		*v++ = float_bits((c->src_y + c->height) / h);
+
+		*v++ = c->dst_y << 16 | c->dst_x;
+		*v++ = float_bits(c->src_x / w);
+		*v++ = float_bits(c->src_y / h);
+	}
+}
+
+void gen6_render_copylist(struct intel_batchbuffer *batch,
+			  const struct render_copy *copies, int count)
+{
+	const struct render_copy **order;
+	struct gen6_surface_state *ss;
+	uint32_t *binding_table;
+	int i, n, fit;
+
+	if (count == 0)
+		return;
+
+	order = render_copy_sort(copies, count);
+
+	intel_batchbuffer_flush(batch);
+	if (!batch->render_state)
+		gen6_create_render_state(batch);
+	gen6_start_list(batch, batch->render_state);
+
+	for (i = 0; i < count; i += n) {
+		n = render_copy_group(order + i, count - i);
+
+		if (state_space(batch) < GEN6_GROUP_SPACE + GEN6_BIND_SPACE +
+		    GEN6_RECT_SPACE) {
+			gen6_submit_list(batch);
+			gen6_start_list(batch, batch->render_state);
+		}
+
+		binding_table = state_alloc(batch, 32, 32);
+		ss = state_alloc(batch, 32, 32);
+		binding_table[0] = gen6_emit_surface(batch, ss, order[i]->dst,
+						     GEN6_SURFACEFORMAT_B8G8R8A8_UNORM, 1);
+		ss = state_alloc(batch, 32, 32);
+		binding_table[1] = gen6_emit_surface(batch, ss, order[i]->src,
+						     GEN6_SURFACEFORMAT_B8G8R8A8_UNORM, 0);
+
+		gen6_emit_drawing_rectangle(batch, order[i]->dst);
+		gen6_emit_binding_table(batch, batch_offset(batch, binding_table));
+
+		/* Whatever doesn't fit is left for the next batch. */
+		fit = (state_space(batch) - GEN6_GROUP_SPACE - VERTEX_SIZE) /
+			GEN6_RECT_SPACE;
+		if (n > fit)
+			n = fit;
+		gen6_emit_rects(batch, order + i, n);
+	}
+
+	gen6_submit_list(batch);
+	free(order);
+}
+
+/*
+ * Fills go through the same list layout, with the fill kernel in the batch
+ * since the colour is part of it.  Instruction state therefore points at
+ * the batch, and the WM state from gen6_state is overridden to match.
+ */
+static uint32_t
+gen6_create_fill_kernel(struct intel_batchbuffer *batch, uint32_t color)
+{
+	uint32_t (*kernel)[4];
+	int i;
+
+	kernel = state_alloc(batch, sizeof(ps_kernel_fill), 64);
+	memcpy(kernel, ps_kernel_fill, sizeof(ps_kernel_fill));
+	for (i = 0; i < 8; i++)
+		kernel[i][3] = float_bits(color_channel(color, i / 2));
+
+	return batch_offset(batch, kernel);
+}
+
+static void
+gen6_start_fill(struct intel_batchbuffer *batch,
+		struct scratch_buf *dst, uint32_t color)
+{
+	struct gen6_surface_state *ss;
+	uint32_t *binding_table;
+
+	gen6_start_list(batch, batch->bo);
+	gen6_emit_wm(batch, gen6_create_fill_kernel(batch, color));
+
+	binding_table = state_alloc(batch, 32, 32);
+	ss = state_alloc(batch, 32, 32);
+	binding_table[0] = gen6_emit_surface(batch, ss, dst,
+					     GEN6_SURFACEFORMAT_B8G8R8A8_UNORM, 1);
+
+	gen6_emit_drawing_rectangle(batch, dst);
+	gen6_emit_binding_table(batch, batch_offset(batch, binding_table));
+}
+
+static void
+gen6_emit_fill_rects(struct intel_batchbuffer *batch,
+		     const struct render_rect *rects, int count)
+{
+	uint32_t *v;
+	int i;
+
+	v = state_alloc(batch, count * GEN6_RECT_SPACE, VERTEX_SIZE);
+	gen6_emit_rectlist(batch, v, count);
+
+	/* The texture coordinates are ignored by the fill kernel. */
+	for (i = 0; i < count; i++) {
+		const struct render_rect *r = &rects[i];
+
+		*v++ = (r->y + r->height) << 16 | (r->x + r->width);
+		*v++ = 0;
+		*v++ = 0;
+
+		*v++ = (r->y + r->height) << 16 | r->x;
+		*v++ = 0;
+		*v++ = 0;
+
+		*v++ = r->y << 16 | r->x;
+		*v++ = 0;
+		*v++ = 0;
+	}
+}
+
+void gen6_render_fillfunc(struct intel_batchbuffer *batch,
+			  struct scratch_buf *dst,
+			  const struct render_rect *rects, int count,
+			  uint32_t color)
+{
+	int i, n;
+
+	if (count == 0)
+		return;
+
+	intel_batchbuffer_flush(batch);
+	if (!batch->render_state)
+		gen6_create_render_state(batch);
+
+	for (i = 0; i < count; i += n) {
+		gen6_start_fill(batch, dst, color);
+
+		n = (state_space(batch) - GEN6_GROUP_SPACE - VERTEX_SIZE) /
+			GEN6_RECT_SPACE;
+		if (n > count - i)
+			n = count - i;
+		gen6_emit_fill_rects(batch, rects + i, n);
+
+		gen6_submit_list(batch);
+	}
+}
@@ -2,6 +2,7 @@
 #include "gen7_render.h"
 
 #include <assert.h>
+#include <pthread.h>
 
 #define ALIGN(x, y) (((x) + (y)-1) & ~((y)-1))
 
@@ -45,6 +46,145 @@ static const uint32_t ps_kernel[][4] = {
 	{ 0x05800031, 0x20001e3c, 0x00000e00, 0x90031000 },
 };
 
+/* Writes a constant colour, patched into the mov immediates (R, G, B, A) by
+ * gen7_create_fill_kernel().
+ *
+ * ../shaders/ps/fill.g7a
+ */
+static const uint32_t ps_kernel_fill[][4] = {
+	/* mov (16) g112<1>F R:F { align1, NoMask }; */
+	{ 0x00800201, 0x2e0003fd, 0x00000000, 0x00000000 },
+	/* mov (16) g114<1>F G:F { align1, NoMask }; */
+	{ 0x00800201, 0x2e4003fd, 0x00000000, 0x00000000 },
+	/* mov (16) g116<1>F B:F { align1, NoMask }; */
+	{ 0x00800201, 0x2e8003fd, 0x00000000, 0x00000000 },
+	/* mov (16) g118<1>F A:F { align1, NoMask }; */
+	{ 0x00800201, 0x2ec003fd, 0x00000000, 0x00000000 },
+	/* send (16) null g112 0x25 0x10031000 { align1, EOT }; */
+	{ 0x05800031, 0x20001e3c, 0x00000e00, 0x90031000 },
+};
+
+/* Planar YUV to RGB: luma is sampled at the pixel, chroma at half its
+ * coordinates from the subsampled planes, and the result converted with the
+ * BT.601 limited range matrix.  Surface 1 is the luma plane, surfaces 2 and
+ * 3 the U and V planes.
+ *
+ * ../shaders/ps/yuv_i420.g7a
+ */
+static const uint32_t ps_kernel_i420[][4] = {
+	/* pln (16) g10 g6<0,1,0>F g2<8,8,1>F { align1 }; */
+	{ 0x0080005a, 0x214077bd, 0x000000c0, 0x008d0040 },
+	/* pln (16) g12 g6.16<0,1,0>F g2<8,8,1>F { align1 }; */
+	{ 0x0080005a, 0x218077bd, 0x000000d0, 0x008d0040 },
+	/* send (16) g20 g10 0x2 0x8840001 { align1 }; */
+	{ 0x02800031, 0x22801e3d, 0x00000140, 0x08840001 },
+	/* mul (16) g14<1>F g10<8,8,1>F 0.5F { align1 }; */
+	{ 0x00800041, 0x21c07fbd, 0x008d0140, 0x3f000000 },
+	/* mul (16) g16<1>F g12<8,8,1>F 0.5F { align1 }; */
+	{ 0x00800041, 0x22007fbd, 0x008d0180, 0x3f000000 },
+	/* send (16) g28 g14 0x2 0x8840002 { align1 }; */
+	{ 0x02800031, 0x23801e3d, 0x000001c0, 0x08840002 },
+	/* send (16) g36 g14 0x2 0x8840003 { align1 }; */
+	{ 0x02800031, 0x24801e3d, 0x000001c0, 0x08840003 },
+	/* add (16) g20<1>F g20<8,8,1>F -0.0627451F { align1 }; */
+	{ 0x00800040, 0x22807fbd, 0x008d0280, 0xbd808081 },
+	/* mul (16) g20<1>F g20<8,8,1>F 1.164F { align1 }; */
+	{ 0x00800041, 0x22807fbd, 0x008d0280, 0x3f94fdf4 },
+	/* add (16) g28<1>F g28<8,8,1>F -0.5F { align1 }; */
+	{ 0x00800040, 0x23807fbd, 0x008d0380, 0xbf000000 },
+	/* add (16) g36<1>F g36<8,8,1>F -0.5F { align1 }; */
+	{ 0x00800040, 0x24807fbd, 0x008d0480, 0xbf000000 },
+	/* mul (16) g112<1>F g36<8,8,1>F 1.596F { align1 }; */
+	{ 0x00800041, 0x2e007fbd, 0x008d0480, 0x3fcc49ba },
+	/* add (16) g112<1>F g112<8,8,1>F g20<8,8,1>F { align1 }; */
+	{ 0x00800040, 0x2e0077bd, 0x008d0e00, 0x008d0280 },
+	/* mul (16) g114<1>F g28<8,8,1>F -0.391F { align1 }; */
+	{ 0x00800041, 0x2e407fbd, 0x008d0380, 0xbec83127 },
+	/* mul (16) g44<1>F g36<8,8,1>F -0.813F { align1 }; */
+	{ 0x00800041, 0x25807fbd, 0x008d0480, 0xbf5020c5 },
+	/* add (16) g114<1>F g114<8,8,1>F g44<8,8,1>F { align1 }; */
+	{ 0x00800040, 0x2e4077bd, 0x008d0e40, 0x008d0580 },
+	/* add (16) g114<1>F g114<8,8,1>F g20<8,8,1>F { align1 }; */
+	{ 0x00800040, 0x2e4077bd, 0x008d0e40, 0x008d0280 },
+	/* mul (16) g116<1>F g28<8,8,1>F 2.018F { align1 }; */
+	{ 0x00800041, 0x2e807fbd, 0x008d0380, 0x400126e9 },
+	/* add (16) g116<1>F g116<8,8,1>F g20<8,8,1>F { align1 }; */
+	{ 0x00800040, 0x2e8077bd, 0x008d0e80, 0x008d0280 },
+	/* mov (16) g118<1>F 1.0F { align1, NoMask }; */
+	{ 0x00800201, 0x2ec003fd, 0x00000000, 0x3f800000 },
+	/* send (16) null g112 0x25 0x10031000 { align1, EOT }; */
+	{ 0x05800031, 0x20001e3c, 0x00000e00, 0x90031000 },
+};
+
+/* As ps_kernel_i420, with U and V interleaved in surface 2.
+ *
+ * ../shaders/ps/yuv_nv12.g7a
+ */
+static const uint32_t ps_kernel_nv12[][4] = {
+	/* pln (16) g10 g6<0,1,0>F g2<8,8,1>F { align1 }; */
+	{ 0x0080005a, 0x214077bd, 0x000000c0, 0x008d0040 },
+	/* pln (16) g12 g6.16<0,1,0>F g2<8,8,1>F { align1 }; */
+	{ 0x0080005a, 0x218077bd, 0x000000d0, 0x008d0040 },
+	/* send (16) g20 g10 0x2 0x8840001 { align1 }; */
+	{ 0x02800031, 0x22801e3d, 0x00000140, 0x08840001 },
+	/* mul (16) g14<1>F g10<8,8,1>F 0.5F { align1 }; */
+	{ 0x00800041, 0x21c07fbd, 0x008d0140, 0x3f000000 },
+	/* mul (16) g16<1>F g12<8,8,1>F 0.5F { align1 }; */
+	{ 0x00800041, 0x22007fbd, 0x008d0180, 0x3f000000 },
+	/* send (16) g28 g14 0x2 0x8840002 { align1 }; */
+	{ 0x02800031, 0x23801e3d, 0x000001c0, 0x08840002 },
+	/* add (16) g20<1>F g20<8,8,1>F -0.0627451F { align1 }; */
+	{ 0x00800040, 0x22807fbd, 0x008d0280, 0xbd808081 },
+	/* mul (16) g20<1>F g20<8,8,1>F 1.164F { align1 }; */
+	{ 0x00800041, 0x22807fbd, 0x008d0280, 0x3f94fdf4 },
+	/* add (16) g28<1>F g28<8,8,1>F -0.5F { align1 }; */
+	{ 0x00800040, 0x23807fbd, 0x008d0380, 0xbf000000 },
+	/* add (16) g30<1>F g30<8,8,1>F -0.5F { align1 }; */
+	{ 0x00800040, 0x23c07fbd, 0x008d03c0, 0xbf000000 },
+	/* mul (16) g112<1>F g30<8,8,1>F 1.596F { align1 }; */
+	{ 0x00800041, 0x2e007fbd, 0x008d03c0, 0x3fcc49ba },
+	/* add (16) g112<1>F g112<8,8,1>F g20<8,8,1>F { align1 }; */
+	{ 0x00800040, 0x2e0077bd, 0x008d0e00, 0x008d0280 },
+	/* mul (16) g114<1>F g28<8,8,1>F -0.391F { align1 }; */
+	{ 0x00800041, 0x2e407fbd, 0x008d0380, 0xbec83127 },
+	/* mul (16) g44<1>F g30<8,8,1>F -0.813F { align1 }; */
+	{ 0x00800041, 0x25807fbd, 0x008d03c0, 0xbf5020c5 },
+	/* add (16) g114<1>F g114<8,8,1>F g44<8,8,1>F { align1 }; */
+	{ 0x00800040, 0x2e4077bd, 0x008d0e40, 0x008d0580 },
+	/* add (16) g114<1>F g114<8,8,1>F g20<8,8,1>F { align1 }; */
+	{ 0x00800040, 0x2e4077bd, 0x008d0e40, 0x008d0280 },
+	/* mul (16) g116<1>F g28<8,8,1>F 2.018F { align1 }; */
+	{ 0x00800041, 0x2e807fbd, 0x008d0380, 0x400126e9 },
+	/* add (16) g116<1>F g116<8,8,1>F g20<8,8,1>F { align1 }; */
+	{ 0x00800040, 0x2e8077bd, 0x008d0e80, 0x008d0280 },
+	/* mov (16) g118<1>F 1.0F { align1, NoMask }; */
+	{ 0x00800201, 0x2ec003fd, 0x00000000, 0x3f800000 },
+	/* send (16) null g112 0x25 0x10031000 { align1, EOT }; */
+	{ 0x05800031, 0x20001e3c, 0x00000e00, 0x90031000 },
+};
+
+/* Where the invariant state lives in batch->render_state, and the invariant
+ * commands pointing at it.  Both come out the same for every batch, so they
+ * are only stored by the first one, under the lock as batches may be used
+ * from several threads. */
+static struct {
+	pthread_mutex_t lock;
+	int have_offsets;
+
+	uint32_t blend;
+	uint32_t cc_viewport;
+	uint32_t sampler;
+	uint32_t sampler_linear;
+	uint32_t kernel;
+	uint32_t kernel_i420;
+	uint32_t kernel_nv12;
+
+	uint32_t cmds[160];
+	unsigned int num_cmds;
+} gen7_state = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
 static uint32_t
 batch_used(struct intel_batchbuffer *batch)
 {
@@ -85,14 +225,18 @@ batch_copy(struct intel_batchbuffer *batch, const void *ptr, uint32_t size, uint
 /******************************************************************************/
 
 static void
-gen7_emit_state_base_address(struct intel_batchbuffer *batch)
+gen7_emit_state_base_address(struct intel_batchbuffer *batch,
+			     drm_intel_bo *instruction)
 {
 	OUT_BATCH(GEN7_STATE_BASE_ADDRESS | (10 - 2));
 	OUT_BATCH(0);
-	OUT_RELOC(batch->bo, I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);
-	OUT_RELOC(batch->bo, I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);
+	OUT_RELOC(batch->bo, /* surface */
+		  I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);
+	OUT_RELOC(batch->render_state, /* dynamic */
+		  I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);
 	OUT_BATCH(0);
-	OUT_RELOC(batch->bo, I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);
+	OUT_RELOC(instruction, /* instruction */
+		  I915_GEM_DOMAIN_INSTRUCTION, 0, BASE_ADDRESS_MODIFY);
 
 	OUT_BATCH(0);
 	OUT_BATCH(0 | BASE_ADDRESS_MODIFY);
@@ -342,23 +486,23 @@ gen7_emit_cc(struct intel_batchbuffer *batch)
 	/* The 3DSTATE_BLEND_STATE_POINTERS command is used to set up the
 	 * pointers to the color calculator state. */
         OUT_BATCH(GEN7_3DSTATE_BLEND_STATE_POINTERS | (2 - 2));
-        OUT_BATCH(gen7_create_blend_state(batch));
+        OUT_BATCH(gen7_state.blend);
 
 	/* The 3DSTATE_VIEWPORT_STATE_POINTERS_CC command is used to define the
 	 * location of fixed functions’ viewport state table. */
         OUT_BATCH(GEN7_3DSTATE_VIEWPORT_STATE_POINTERS_CC | (2 - 2));
-	OUT_BATCH(gen7_create_cc_viewport(batch));
+	OUT_BATCH(gen7_state.cc_viewport);
 }
 
-static struct gen7_sampler_state *
-gen7_create_sampler(struct intel_batchbuffer *batch)
+static uint32_t
+gen7_create_sampler(struct intel_batchbuffer *batch, uint32_t filter)
 {
 	struct gen7_sampler_state *ss;
 
 	ss = batch_alloc(batch, sizeof(*ss), 32);
 
-	ss->ss0.min_filter = GEN7_MAPFILTER_NEAREST;
-	ss->ss0.mag_filter = GEN7_MAPFILTER_NEAREST;
+	ss->ss0.min_filter = filter;
+	ss->ss0.mag_filter = filter;
 
 	ss->ss3.r_wrap_mode = GEN7_TEXCOORDMODE_CLAMP;
 	ss->ss3.s_wrap_mode = GEN7_TEXCOORDMODE_CLAMP;
@@ -366,17 +510,14 @@ gen7_create_sampler(struct intel_batchbuffer *batch)
 
 	ss->ss3.non_normalized_coord = 1;
 
-	return ss;
+	return batch_offset(batch, ss);
 }
 
 static void
-gen7_emit_sampler(struct intel_batchbuffer *batch)
+gen7_emit_sampler(struct intel_batchbuffer *batch, uint32_t sampler)
 {
-	struct gen7_sampler_state *ss = gen7_create_sampler(batch);
-	uint32_t ss_pointer = batch_offset(batch, ss);
-
         OUT_BATCH(GEN7_3DSTATE_SAMPLER_STATE_POINTERS_PS | (2 - 2));
-        OUT_BATCH(ss_pointer);
+        OUT_BATCH(sampler);
 }
 
 /* The state used by “setup backend” is defined by this inline state packet.
@@ -410,7 +551,7 @@ gen7_emit_sbe(struct intel_batchbuffer *batch)
  * stage.
  */
 static void
-gen7_emit_ps(struct intel_batchbuffer *batch)
+gen7_emit_ps(struct intel_batchbuffer *batch, uint32_t kernel)
 {
 	OUT_BATCH(GEN7_3DSTATE_PS | (8 - 2));
 
@@ -420,7 +561,7 @@ gen7_emit_ps(struct intel_batchbuffer *batch)
 	 * in the kernel[0]. This pointer is relative to the Instruction Base
 	 * Address.
 	 */
-	OUT_BATCH(batch_copy(batch, ps_kernel, sizeof(ps_kernel), 64));
+	OUT_BATCH(kernel);
 
 	/* Single Program Flow
 	 *
@@ -596,18 +737,9 @@ gen7_create_vertex_buffer(struct intel_batchbuffer *batch,
  * associated state is left unchanged and is available for use if previously
  * defined.
  */
-static void gen7_emit_vertex_buffer(struct intel_batchbuffer *batch,
-				    int src_x, int src_y,
-				    int dst_x, int dst_y,
-				    int width, int height)
+static void gen7_emit_vertex_buffer_state(struct intel_batchbuffer *batch,
+					  uint32_t offset)
 {
-	uint32_t offset;
-
-	offset = gen7_create_vertex_buffer(batch,
-					   src_x, src_y,
-					   dst_x, dst_y,
-					   width, height);
-
 	/* 3DSTATE_VERTEX_BUFFERS Structure
 	 *
 	 *   31:29 Instruction type
@@ -675,6 +807,20 @@ static void gen7_emit_vertex_buffer(struct intel_batchbuffer *batch,
 	OUT_BATCH(0);
 }
 
+static void gen7_emit_vertex_buffer(struct intel_batchbuffer *batch,
+				    int src_x, int src_y,
+				    int dst_x, int dst_y,
+				    int width, int height)
+{
+	uint32_t offset;
+
+	offset = gen7_create_vertex_buffer(batch,
+					   src_x, src_y,
+					   dst_x, dst_y,
+					   width, height);
+	gen7_emit_vertex_buffer_state(batch, offset);
+}
+
 static uint32_t
 gen7_tiling_bits(uint32_t tiling)
 {
@@ -691,15 +837,15 @@ gen7_tiling_bits(uint32_t tiling)
 }
 
 static uint32_t
-gen7_bind_buf(struct intel_batchbuffer *batch,
-	      struct scratch_buf *buf,
-	      uint32_t format,
-	      int is_dst)
+gen7_emit_plane(struct intel_batchbuffer *batch,
+		uint32_t *ss,
+		struct scratch_buf *buf, uint32_t offset,
+		unsigned width, unsigned height, uint32_t stride,
+		uint32_t format,
+		int is_dst)
 {
-	uint32_t *ss;
 	uint32_t write_domain;
 	uint32_t read_domain;
-	int ret;
 
 	if (is_dst) {
 		write_domain = read_domain = I915_GEM_DOMAIN_RENDER;
@@ -708,29 +854,48 @@ gen7_bind_buf(struct intel_batchbuffer *batch,
 		read_domain = I915_GEM_DOMAIN_SAMPLER;
 	}
 
-	ss = batch_alloc(batch, sizeof(*ss), 32);
 
 	ss[0] = (GEN7_SURFACE_2D << GEN7_SURFACE_TYPE_SHIFT |
 		 gen7_tiling_bits(buf->tiling) |
 		format << GEN7_SURFACE_FORMAT_SHIFT);
-	ss[1] = buf->bo->offset;
-	ss[2] = ((buf_width(buf) - 1)  << GEN7_SURFACE_WIDTH_SHIFT |
-		 (buf_height(buf) - 1) << GEN7_SURFACE_HEIGHT_SHIFT);
-	ss[3] = (buf->stride - 1) << GEN7_SURFACE_PITCH_SHIFT;
+	ss[1] = buf->bo->offset + offset;
+	ss[2] = ((width - 1)  << GEN7_SURFACE_WIDTH_SHIFT |
+		 (height - 1) << GEN7_SURFACE_HEIGHT_SHIFT);
+	ss[3] = (stride - 1) << GEN7_SURFACE_PITCH_SHIFT;
 	ss[4] = 0;
 	ss[5] = 0;
 	ss[6] = 0;
 	ss[7] = 0;
 
-	ret = drm_intel_bo_emit_reloc(batch->bo,
-				      batch_offset(batch, ss) + 4,
-				      buf->bo, 0,
-				      read_domain, write_domain);
-	assert(ret == 0);
+	intel_batchbuffer_emit_reloc_at(batch, batch_offset(batch, ss) + 4,
+					buf->bo, offset,
+					read_domain, write_domain, 0);
 
 	return batch_offset(batch, ss);
 }
 
+static uint32_t
+gen7_emit_surface(struct intel_batchbuffer *batch,
+		  uint32_t *ss,
+		  struct scratch_buf *buf,
+		  uint32_t format,
+		  int is_dst)
+{
+	return gen7_emit_plane(batch, ss, buf, 0,
+			       buf_width(buf), buf_height(buf), buf->stride,
+			       format, is_dst);
+}
+
+static uint32_t
+gen7_bind_buf(struct intel_batchbuffer *batch,
+	      struct scratch_buf *buf,
+	      uint32_t format,
+	      int is_dst)
+{
+	return gen7_emit_surface(batch, batch_alloc(batch, 8 * 4, 32),
+				 buf, format, is_dst);
+}
+
 static uint32_t
 gen7_bind_surfaces(struct intel_batchbuffer *batch,
 		   struct scratch_buf *src,
@@ -805,29 +970,72 @@ gen7_render_flush(struct intel_batchbuffer *batch, uint32_t batch_end)
 {
 	int ret;
 
-	ret = drm_intel_bo_subdata(batch->bo, 0, 4096, batch->buffer);
+	ret = intel_batchbuffer_upload(batch, batch_used(batch));
 	if (ret == 0)
-		ret = drm_intel_bo_mrb_exec(batch->bo, batch_end,
-					    NULL, 0, 0, 0);
+		ret = intel_batchbuffer_exec(batch, batch_end, 0);
 	assert(ret == 0);
 }
 
-#define BATCH_STATE_SPLIT 2048
-void gen7_render_copyfunc(struct intel_batchbuffer *batch,
-			  struct scratch_buf *src,
-			  unsigned src_x, unsigned src_y,
-			  unsigned width, unsigned height,
-			  struct scratch_buf *dst,
-			  unsigned dst_x, unsigned dst_y)
+/*
+ * Lay the invariant state out in the empty batch with the usual helpers and
+ * move it to a bo of its own, which all later copies through this batch
+ * point at instead of carrying their own copy.
+ */
+static void
+gen7_create_render_state(struct intel_batchbuffer *batch)
 {
-	uint32_t batch_end;
-
-	intel_batchbuffer_flush(batch);
-	batch->state = &batch->buffer[BATCH_STATE_SPLIT];
+	uint32_t blend, cc_viewport, sampler, sampler_linear;
+	uint32_t kernel, kernel_i420, kernel_nv12;
+	uint32_t size;
+
+	batch->state = batch->buffer;
+	blend = gen7_create_blend_state(batch);
+	cc_viewport = gen7_create_cc_viewport(batch);
+	sampler = gen7_create_sampler(batch, GEN7_MAPFILTER_NEAREST);
+	sampler_linear = gen7_create_sampler(batch, GEN7_MAPFILTER_LINEAR);
+	kernel = batch_copy(batch, ps_kernel, sizeof(ps_kernel), 64);
+	kernel_i420 = batch_copy(batch, ps_kernel_i420,
+				 sizeof(ps_kernel_i420), 64);
+	kernel_nv12 = batch_copy(batch, ps_kernel_nv12,
+				 sizeof(ps_kernel_nv12), 64);
+	size = batch_used(batch);
+
+	pthread_mutex_lock(&gen7_state.lock);
+	if (!gen7_state.have_offsets) {
+		gen7_state.blend = blend;
+		gen7_state.cc_viewport = cc_viewport;
+		gen7_state.sampler = sampler;
+		gen7_state.sampler_linear = sampler_linear;
+		gen7_state.kernel = kernel;
+		gen7_state.kernel_i420 = kernel_i420;
+		gen7_state.kernel_nv12 = kernel_nv12;
+		gen7_state.have_offsets = 1;
+	}
+	assert(gen7_state.kernel_nv12 == kernel_nv12);
+	pthread_mutex_unlock(&gen7_state.lock);
+
+	batch->render_state = drm_intel_bo_alloc(batch->bufmgr, "render state",
+						 ALIGN(size, 4096), 4096);
+	assert(batch->render_state);
+	do_or_die(drm_intel_bo_subdata(batch->render_state, 0, size,
+				       batch->buffer));
+}
 
-	OUT_BATCH(GEN7_PIPELINE_SELECT | PIPELINE_SELECT_3D);
+/* Everything between STATE_BASE_ADDRESS and the per-copy commands.  None of
+ * it changes, so after the first copy it is replayed from gen7_state. */
+static void
+gen7_emit_static_state(struct intel_batchbuffer *batch)
+{
+	uint8_t *start = batch->ptr;
+
+	pthread_mutex_lock(&gen7_state.lock);
+	if (gen7_state.num_cmds) {
+		intel_batchbuffer_data(batch, gen7_state.cmds,
+				       4 * gen7_state.num_cmds);
+		pthread_mutex_unlock(&gen7_state.lock);
+		return;
+	}
 
-	gen7_emit_state_base_address(batch);
 	gen7_emit_multisample(batch);
 	gen7_emit_urb(batch);
 	gen7_emit_vs(batch);
@@ -842,11 +1050,39 @@ void gen7_render_copyfunc(struct intel_batchbuffer *batch,
 	gen7_emit_null_depth_buffer(batch);
 
 	gen7_emit_cc(batch);
-        gen7_emit_sampler(batch);
-        gen7_emit_sbe(batch);
-        gen7_emit_ps(batch);
+	gen7_emit_sampler(batch, gen7_state.sampler);
+	gen7_emit_sbe(batch);
+	gen7_emit_ps(batch, gen7_state.kernel);
 
 	gen7_emit_vertex_elements(batch);
+
+	assert(batch->ptr - start <= sizeof(gen7_state.cmds));
+	memcpy(gen7_state.cmds, start, batch->ptr - start);
+	gen7_state.num_cmds = (batch->ptr - start) / 4;
+	pthread_mutex_unlock(&gen7_state.lock);
+}
+
+#define BATCH_STATE_SPLIT 1024
+void gen7_render_copyfunc(struct intel_batchbuffer *batch,
+			  struct scratch_buf *src,
+			  unsigned src_x, unsigned src_y,
+			  unsigned width, unsigned height,
+			  struct scratch_buf *dst,
+			  unsigned dst_x, unsigned dst_y)
+{
+	uint32_t batch_end;
+
+	intel_batchbuffer_flush(batch);
+
+	if (!batch->render_state)
+		gen7_create_render_state(batch);
+	batch->state = &batch->buffer[BATCH_STATE_SPLIT];
+
+	OUT_BATCH(GEN7_PIPELINE_SELECT | PIPELINE_SELECT_3D);
+
+	gen7_emit_state_base_address(batch, batch->render_state);
+	gen7_emit_static_state(batch);
+
         gen7_emit_vertex_buffer(batch,
 				src_x, src_y,
 				dst_x, dst_y,
@@ -863,3 +1099,408 @@ void gen7_render_copyfunc(struct intel_batchbuffer *batch,
 	gen7_render_flush(batch, batch_end);
 	intel_batchbuffer_reset(batch);
 }
+
+/*
+ * The list variant fills the batch from both ends: commands grow up from
+ * the start as usual, surface state and vertices grow down from the end
+ * through batch->state.  The batch is submitted when they would meet.
+ */
+#define VERTEX_SIZE (6*2)
+
+static void *
+state_alloc(struct intel_batchbuffer *batch, uint32_t size, uint32_t align)
+{
+	uint32_t offset = batch->state - batch->buffer;
+
+	assert(offset >= size);
+	offset = (offset - size) / align * align;
+	batch->state = batch->buffer + offset;
+
+	return memset(batch->state, 0, size);
+}
+
+static uint32_t
+state_space(struct intel_batchbuffer *batch)
+{
+	return batch->state - batch->ptr;
+}
+
+/* Commands for a group (binding table, drawing rectangle and primitive)
+ * with the batch end, the state to bind its surfaces including alignment,
+ * and one rectangle. */
+#define GEN7_GROUP_SPACE	(13*4 + 8)
+#define GEN7_BIND_SPACE		(3*32 + 32 + VERTEX_SIZE)
+#define GEN7_RECT_SPACE		(3*VERTEX_SIZE)
+
+static void
+gen7_start_list(struct intel_batchbuffer *batch, drm_intel_bo *instruction)
+{
+	batch->ptr = batch->buffer;
+	batch->state = batch->buffer + batch->size;
+
+	OUT_BATCH(GEN7_PIPELINE_SELECT | PIPELINE_SELECT_3D);
+
+	gen7_emit_state_base_address(batch, instruction);
+	gen7_emit_static_state(batch);
+
+	/* Vertex buffer 0 is the whole batch, vertices are found by index. */
+	gen7_emit_vertex_buffer_state(batch, 0);
+}
+
+static void
+gen7_submit_list(struct intel_batchbuffer *batch)
+{
+	uint32_t batch_end;
+	int ret;
+
+	OUT_BATCH(MI_BATCH_BUFFER_END);
+	batch_end = ALIGN(batch->ptr - batch->buffer, 8);
+	assert(batch_end <= batch->state - batch->buffer);
+
+	ret = intel_batchbuffer_upload(batch, batch->size);
+	if (ret == 0)
+		ret = intel_batchbuffer_exec(batch, batch_end, 0);
+	assert(ret == 0);
+
+	intel_batchbuffer_reset(batch);
+}
+
+static void
+gen7_emit_drawing_rectangle(struct intel_batchbuffer *batch,
+			    unsigned width, unsigned height)
+{
+	OUT_BATCH(GEN7_3DSTATE_DRAWING_RECTANGLE | (4 - 2));
+	OUT_BATCH(0);
+	OUT_BATCH((height - 1) << 16 | (width - 1));
+	OUT_BATCH(0);
+}
+
+static void
+gen7_emit_rectlist(struct intel_batchbuffer *batch, void *vertices, int count)
+{
+	OUT_BATCH(GEN7_3DPRIMITIVE | (7 - 2));
+	OUT_BATCH(GEN7_3DPRIMITIVE_VERTEX_SEQUENTIAL | _3DPRIM_RECTLIST);
+	OUT_BATCH(3 * count);
+	OUT_BATCH(batch_offset(batch, vertices) / VERTEX_SIZE);
+	OUT_BATCH(1);
+	OUT_BATCH(0);
+	OUT_BATCH(0);
+}
+
+static void
+gen7_emit_rects(struct intel_batchbuffer *batch,
+		const struct render_copy **copies, int count)
+{
+	uint16_t *v;
+	int i;
+
+	v = state_alloc(batch, count * GEN7_RECT_SPACE, VERTEX_SIZE);
+	gen7_emit_rectlist(batch, v, count);
+
+	/* Same layout as gen7_create_vertex_buffer(), with unnormalized
+	 * texture coordinates. */
+	for (i = 0; i < count; i++) {
+		const struct render_copy *c = copies[i];
+
+		v[0] = c->dst_x + c->width;
+		v[1] = c->dst_y + c->height;
+		v[2] = c->src_x + c->width;
+		v[3] = c->src_y + c->height;
+		v[4] = 0xFFFF;
+		v[5] = 0xFFFF;
+
+		v[6] = c->dst_x;
+		v[7] = c->dst_y + c->height;
+		v[8] = c->src_x;
+		v[9] = c->src_y + c->height;
+		v[10] = 0xFFFF;
+		v[11] = 0xFFFF;
+
+		v[12] = c->dst_x;
+		v[13] = c->dst_y;
+		v[14] = c->src_x;
+		v[15] = c->src_y;
+		v[16] = 0xFFFF;
+		v[17] = 0xFFFF;
+
+		v += 18;
+	}
+}
+
+void gen7_render_copylist(struct intel_batchbuffer *batch,
+			  const struct render_copy *copies, int count)
+{
+	const struct render_copy **order;
+	uint32_t *binding_table;
+	int i, n, fit;
+
+	if (count == 0)
+		return;
+
+	order = render_copy_sort(copies, count);
+
+	intel_batchbuffer_flush(batch);
+	if (!batch->render_state)
+		gen7_create_render_state(batch);
+	gen7_start_list(batch, batch->render_state);
+
+	for (i = 0; i < count; i += n) {
+		n = render_copy_group(order + i, count - i);
+
+		if (state_space(batch) < GEN7_GROUP_SPACE + GEN7_BIND_SPACE +
+		    GEN7_RECT_SPACE) {
+			gen7_submit_list(batch);
+			gen7_start_list(batch, batch->render_state);
+		}
+
+		binding_table = state_alloc(batch, 32, 32);
+		binding_table[0] =
+			gen7_emit_surface(batch, state_alloc(batch, 32, 32),
+					  order[i]->dst,
+					  GEN7_SURFACEFORMAT_B8G8R8A8_UNORM, 1);
+		binding_table[1] =
+			gen7_emit_surface(batch, state_alloc(batch, 32, 32),
+					  order[i]->src,
+					  GEN7_SURFACEFORMAT_B8G8R8A8_UNORM, 0);
+
+		gen7_emit_drawing_rectangle(batch, buf_width(order[i]->dst),
+					    buf_height(order[i]->dst));
+		OUT_BATCH(GEN7_3DSTATE_BINDING_TABLE_POINTERS_PS | (2 - 2));
+		OUT_BATCH(batch_offset(batch, binding_table));
+
+		/* Whatever doesn't fit is left for the next batch. */
+		fit = (state_space(batch) - GEN7_GROUP_SPACE - VERTEX_SIZE) /
+			GEN7_RECT_SPACE;
+		if (n > fit)
+			n = fit;
+		gen7_emit_rects(batch, order + i, n);
+	}
+
+	gen7_submit_list(batch);
+	free(order);
+}
+
+/*
+ * Fills go through the same list layout, with the fill kernel in the batch
+ * since the colour is part of it.  Instruction state therefore points at
+ * the batch, and the PS state from gen7_state is overridden to match.
+ */
+static uint32_t
+gen7_create_fill_kernel(struct intel_batchbuffer *batch, uint32_t color)
+{
+	uint32_t (*kernel)[4];
+	union { float f; uint32_t ui; } u;
+	int i;
+
+	kernel = state_alloc(batch, sizeof(ps_kernel_fill), 64);
+	memcpy(kernel, ps_kernel_fill, sizeof(ps_kernel_fill));
+	for (i = 0; i < 4; i++) {
+		u.f = color_channel(color, i);
+		kernel[i][3] = u.ui;
+	}
+
+	return batch_offset(batch, kernel);
+}
+
+static void
+gen7_start_fill(struct intel_batchbuffer *batch,
+		struct scratch_buf *dst, uint32_t color)
+{
+	uint32_t *binding_table;
+
+	gen7_start_list(batch, batch->bo);
+	gen7_emit_ps(batch, gen7_create_fill_kernel(batch, color));
+
+	binding_table = state_alloc(batch, 32, 32);
+	binding_table[0] =
+		gen7_emit_surface(batch, state_alloc(batch, 32, 32), dst,
+				  GEN7_SURFACEFORMAT_B8G8R8A8_UNORM, 1);
+
+	gen7_emit_drawing_rectangle(batch, buf_width(dst), buf_height(dst));
+	OUT_BATCH(GEN7_3DSTATE_BINDING_TABLE_POINTERS_PS | (2 - 2));
+	OUT_BATCH(batch_offset(batch, binding_table));
+}
+
+static void
+gen7_emit_fill_rects(struct intel_batchbuffer *batch,
+		     const struct render_rect *rects, int count)
+{
+	uint16_t *v;
+	int i;
+
+	v = state_alloc(batch, count * GEN7_RECT_SPACE, VERTEX_SIZE);
+	gen7_emit_rectlist(batch, v, count);
+
+	/* The texture coordinates and colour are ignored by the fill
+	 * kernel, state_alloc() left them zero. */
+	for (i = 0; i < count; i++) {
+		const struct render_rect *r = &rects[i];
+
+		v[0] = r->x + r->width;
+		v[1] = r->y + r->height;
+
+		v[6] = r->x;
+		v[7] = r->y + r->height;
+
+		v[12] = r->x;
+		v[13] = r->y;
+
+		v += 18;
+	}
+}
+
+void gen7_render_fillfunc(struct intel_batchbuffer *batch,
+			  struct scratch_buf *dst,
+			  const struct render_rect *rects, int count,
+			  uint32_t color)
+{
+	int i, n;
+
+	if (count == 0)
+		return;
+
+	intel_batchbuffer_flush(batch);
+	if (!batch->render_state)
+		gen7_create_render_state(batch);
+
+	for (i = 0; i < count; i += n) {
+		gen7_start_fill(batch, dst, color);
+
+		n = (state_space(batch) - GEN7_GROUP_SPACE - VERTEX_SIZE) /
+			GEN7_RECT_SPACE;
+		if (n > count - i)
+			n = count - i;
+		gen7_emit_fill_rects(batch, rects + i, n);
+
+		gen7_submit_list(batch);
+	}
+}
+
+static uint32_t
+gen7_surface_format(enum render_format format)
+{
+	switch (format) {
+	case RENDER_FORMAT_ARGB8888:
+		return GEN7_SURFACEFORMAT_B8G8R8A8_UNORM;
+	case RENDER_FORMAT_RGB565:
+		return GEN7_SURFACEFORMAT_B5G6R5_UNORM;
+	case RENDER_FORMAT_ARGB2101010:
+		return GEN7_SURFACEFORMAT_B10G10R10A2_UNORM;
+	case RENDER_FORMAT_I420:
+	case RENDER_FORMAT_NV12:
+		return GEN7_SURFACEFORMAT_R8_UNORM;
+	default:
+		assert(0);
+	}
+}
+
+/* Binds the planes of src from binding table entry 1 on, and returns the
+ * kernel that samples them. */
+static uint32_t
+gen7_bind_source(struct intel_batchbuffer *batch, uint32_t *binding_table,
+		 struct scratch_buf *src, enum render_format format)
+{
+	unsigned width = render_format_width(src, format);
+	unsigned height = render_format_height(src, format);
+	uint32_t chroma = src->stride * height;
+
+	binding_table[1] =
+		gen7_emit_plane(batch, state_alloc(batch, 32, 32), src, 0,
+				width, height, src->stride,
+				gen7_surface_format(format), 0);
+
+	switch (format) {
+	case RENDER_FORMAT_I420:
+		binding_table[2] =
+			gen7_emit_plane(batch, state_alloc(batch, 32, 32),
+					src, chroma,
+					width / 2, height / 2, src->stride / 2,
+					GEN7_SURFACEFORMAT_R8_UNORM, 0);
+		binding_table[3] =
+			gen7_emit_plane(batch, state_alloc(batch, 32, 32),
+					src, chroma + src->stride / 2 * height / 2,
+					width / 2, height / 2, src->stride / 2,
+					GEN7_SURFACEFORMAT_R8_UNORM, 0);
+		return gen7_state.kernel_i420;
+	case RENDER_FORMAT_NV12:
+		binding_table[2] =
+			gen7_emit_plane(batch, state_alloc(batch, 32, 32),
+					src, chroma,
+					width / 2, height / 2, src->stride,
+					GEN7_SURFACEFORMAT_R8G8_UNORM, 0);
+		return gen7_state.kernel_nv12;
+	default:
+		return gen7_state.kernel;
+	}
+}
+
+void gen7_render_convert(struct intel_batchbuffer *batch,
+			 struct scratch_buf *src,
+			 enum render_format src_format,
+			 unsigned src_x, unsigned src_y,
+			 unsigned src_width, unsigned src_height,
+			 struct scratch_buf *dst,
+			 enum render_format dst_format,
+			 unsigned dst_x, unsigned dst_y,
+			 unsigned dst_width, unsigned dst_height)
+{
+	uint32_t *binding_table, kernel;
+	uint16_t *v;
+
+	assert(!render_format_is_yuv(dst_format));
+	assert(!render_format_is_yuv(src_format) ||
+	       src->tiling == I915_TILING_NONE);
+
+	intel_batchbuffer_flush(batch);
+	if (!batch->render_state)
+		gen7_create_render_state(batch);
+	gen7_start_list(batch, batch->render_state);
+
+	binding_table = state_alloc(batch, 32, 32);
+	binding_table[0] =
+		gen7_emit_plane(batch, state_alloc(batch, 32, 32), dst, 0,
+				render_format_width(dst, dst_format),
+				render_format_height(dst, dst_format),
+				dst->stride, gen7_surface_format(dst_format), 1);
+	kernel = gen7_bind_source(batch, binding_table, src, src_format);
+
+	/* Override the copy's sampler and kernel from the static state. */
+	if (src_width != dst_width || src_height != dst_height)
+		gen7_emit_sampler(batch, gen7_state.sampler_linear);
+	if (kernel != gen7_state.kernel)
+		gen7_emit_ps(batch, kernel);
+
+	gen7_emit_drawing_rectangle(batch,
+				    render_format_width(dst, dst_format),
+				    render_format_height(dst, dst_format));
+	OUT_BATCH(GEN7_3DSTATE_BINDING_TABLE_POINTERS_PS | (2 - 2));
+	OUT_BATCH(batch_offset(batch, binding_table));
+
+	/* The texture coordinates at the corners are in source pixels, the
+	 * scale falls out of interpolating them across the destination. */
+	v = state_alloc(batch, GEN7_RECT_SPACE, VERTEX_SIZE);
+	gen7_emit_rectlist(batch, v, 1);
+
+	v[0] = dst_x + dst_width;
+	v[1] = dst_y + dst_height;
+	v[2] = src_x + src_width;
+	v[3] = src_y + src_height;
+	v[4] = 0xFFFF;
+	v[5] = 0xFFFF;
+
+	v[6] = dst_x;
+	v[7] = dst_y + dst_height;
+	v[8] = src_x;
+	v[9] = src_y + src_height;
+	v[10] = 0xFFFF;
+	v[11] = 0xFFFF;
+
+	v[12] = dst_x;
+	v[13] = dst_y;
+	v[14] = src_x;
+	v[15] = src_y;
+	v[16] = 0xFFFF;
+	v[17] = 0xFFFF;
+
+	gen7_submit_list(batch);
+}
@@ -190,17 +190,12 @@ static void gen2_emit_copy_pipeline(struct intel_batchbuffer *batch)
 		  TB0A_OP_ARG1 | TB0A_ARG1_SEL_TEXEL0);
 }
 
-void gen2_render_copyfunc(struct intel_batchbuffer *batch,
-			  struct scratch_buf *src, unsigned src_x, unsigned src_y,
-			  unsigned width, unsigned height,
-			  struct scratch_buf *dst, unsigned dst_x, unsigned dst_y)
+/* Everything but the surfaces, which is the same for every copy. */
+static void gen2_emit_copy_state(struct intel_batchbuffer *batch)
 {
 	gen2_emit_invariant(batch);
 	gen2_emit_copy_pipeline(batch);
 
-	gen2_emit_target(batch, dst);
-	gen2_emit_texture(batch, src, 0);
-
 	OUT_BATCH(_3DSTATE_LOAD_STATE_IMMEDIATE_1 |
 		  I1_LOAD_S(2) | I1_LOAD_S(3) | I1_LOAD_S(8) | 2);
 	OUT_BATCH(1<<12);
@@ -208,8 +203,16 @@ void gen2_render_copyfunc(struct intel_batchbuffer *batch,
 	OUT_BATCH(S8_ENABLE_COLOR_BUFFER_WRITE);
 
 	OUT_BATCH(_3DSTATE_VERTEX_FORMAT_2_CMD | TEXCOORDFMT_2D << 0);
+}
+
+static void gen2_emit_rect(struct intel_batchbuffer *batch,
+			   const struct render_copy *copy)
+{
+	struct scratch_buf *src = copy->src;
+	unsigned src_x = copy->src_x, src_y = copy->src_y;
+	unsigned dst_x = copy->dst_x, dst_y = copy->dst_y;
+	unsigned width = copy->width, height = copy->height;
 
-	OUT_BATCH(PRIM3D_INLINE | PRIM3D_RECTLIST | (3*4 -1));
 	emit_vertex(batch, dst_x + width);
 	emit_vertex(batch, dst_y + height);
 	emit_vertex_normalized(batch, src_x + width, buf_width(src));
@@ -224,22 +227,93 @@ void gen2_render_copyfunc(struct intel_batchbuffer *batch,
 	emit_vertex(batch, dst_y);
 	emit_vertex_normalized(batch, src_x, buf_width(src));
 	emit_vertex_normalized(batch, src_y, buf_height(src));
+}
+
+/* Worst case batch space for the copy state, for binding a pair of surfaces
+ * and starting a rectlist, and for one rectangle. */
+#define GEN2_STATE_SPACE	512
+#define GEN2_BIND_SPACE		96
+#define GEN2_RECT_SPACE		(3*4*4)
+
+/* The length field of the inline primitive is 16 bits of dwords. */
+#define GEN2_RECTLIST_MAX	(0xffff / (3*4))
+
+static void gen2_close_rectlist(struct intel_batchbuffer *batch, uint32_t prim)
+{
+	uint32_t len = (batch->ptr - batch->buffer - prim) / 4 - 1;
+
+	*(uint32_t *)(batch->buffer + prim) |= len - 1;
+}
+
+/* Copies between the same pair of surfaces, as few rectlists as fit. */
+static void gen2_emit_group(struct intel_batchbuffer *batch,
+			    const struct render_copy **copies, int count)
+{
+	uint32_t prim = 0;
+	int i, rects = 0, bound = 0;
+
+	for (i = 0; i < count; i++) {
+		if (!prim || rects == GEN2_RECTLIST_MAX ||
+		    intel_batchbuffer_space(batch) < GEN2_RECT_SPACE) {
+			if (prim)
+				gen2_close_rectlist(batch, prim);
+			if (intel_batchbuffer_require_space(batch,
+							    GEN2_STATE_SPACE +
+							    GEN2_BIND_SPACE +
+							    GEN2_RECT_SPACE)) {
+				gen2_emit_copy_state(batch);
+				bound = 0;
+			}
+			if (!bound) {
+				gen2_emit_target(batch, copies[i]->dst);
+				gen2_emit_texture(batch, copies[i]->src, 0);
+				bound = 1;
+			}
+
+			prim = batch->ptr - batch->buffer;
+			rects = 0;
+			OUT_BATCH(PRIM3D_INLINE | PRIM3D_RECTLIST);
+		}
+
+		gen2_emit_rect(batch, copies[i]);
+		rects++;
+	}
+
+	gen2_close_rectlist(batch, prim);
+}
+
+void gen2_render_copylist(struct intel_batchbuffer *batch,
+			  const struct render_copy *copies, int count)
+{
+	const struct render_copy **order;
+	int i, n;
+
+	if (count == 0)
+		return;
+
+	order = render_copy_sort(copies, count);
+
+	intel_batchbuffer_require_space(batch, GEN2_STATE_SPACE +
+					GEN2_BIND_SPACE + GEN2_RECT_SPACE);
+	gen2_emit_copy_state(batch);
+
+	for (i = 0; i < count; i += n) {
+		n = render_copy_group(order + i, count - i);
+		gen2_emit_group(batch, order + i, n);
+	}
 
 	intel_batchbuffer_flush(batch);
+	free(order);
 }
 
-render_copyfunc_t get_render_copyfunc(int devid)
+void gen2_render_copyfunc(struct intel_batchbuffer *batch,
+			  struct scratch_buf *src, unsigned src_x, unsigned src_y,
+			  unsigned width, unsigned height,
+			  struct scratch_buf *dst, unsigned dst_x, unsigned dst_y)
 {
-	render_copyfunc_t copy = NULL;
-
-	if (IS_GEN2(devid))
-		copy = gen2_render_copyfunc;
-	else if (IS_GEN3(devid))
-		copy = gen3_render_copyfunc;
-	else if (IS_GEN6(devid))
-		copy = gen6_render_copyfunc;
-	else if (IS_GEN7(devid))
-		copy = gen7_render_copyfunc;
-
-	return copy;
+	struct render_copy copy = {
+		src, src_x, src_y, width, height, dst, dst_x, dst_y
+	};
+
+	gen2_render_copylist(batch, &copy, 1);
 }
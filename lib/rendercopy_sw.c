@@ -0,0 +1,270 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Pixel format helpers and the CPU reference for render_convertfunc_t.  The
+ * reference samples the way the gen7 sampler is set up: unnormalized
+ * coordinates clamped to the surface, nearest for unscaled copies and
+ * bilinear otherwise, with chroma sampled at half the luma coordinates.
+ */
+
+#include "rendercopy.h"
+
+static unsigned
+render_format_cpp(enum render_format format)
+{
+	switch (format) {
+	case RENDER_FORMAT_ARGB8888:
+	case RENDER_FORMAT_ARGB2101010:
+		return 4;
+	case RENDER_FORMAT_RGB565:
+		return 2;
+	case RENDER_FORMAT_I420:
+	case RENDER_FORMAT_NV12:
+		return 1;
+	default:
+		assert(0);
+	}
+}
+
+bool render_format_is_yuv(enum render_format format)
+{
+	return format == RENDER_FORMAT_I420 || format == RENDER_FORMAT_NV12;
+}
+
+unsigned render_format_width(struct scratch_buf *buf,
+			     enum render_format format)
+{
+	return buf->stride / render_format_cpp(format);
+}
+
+unsigned render_format_height(struct scratch_buf *buf,
+			      enum render_format format)
+{
+	/* 4:2:0 chroma adds half the luma plane again */
+	if (render_format_is_yuv(format))
+		return buf->size / buf->stride * 2 / 3;
+
+	return buf->size / buf->stride;
+}
+
+/* One plane as the sampler sees it. */
+struct plane {
+	const uint8_t *data;
+	unsigned width, height;
+	uint32_t stride;
+	enum render_format format;
+	int channels;		/* of the chroma planes */
+};
+
+static void
+decode(const struct plane *p, unsigned x, unsigned y, float *rgba)
+{
+	const uint8_t *row = p->data + y * p->stride;
+	uint32_t pixel;
+	int c;
+
+	switch (p->format) {
+	case RENDER_FORMAT_ARGB8888:
+		pixel = ((const uint32_t *)row)[x];
+		for (c = 0; c < 4; c++)
+			rgba[c] = color_channel(pixel, c);
+		break;
+	case RENDER_FORMAT_RGB565:
+		pixel = ((const uint16_t *)row)[x];
+		rgba[0] = (pixel >> 11) / 31.f;
+		rgba[1] = (pixel >> 5 & 0x3f) / 63.f;
+		rgba[2] = (pixel & 0x1f) / 31.f;
+		rgba[3] = 1;
+		break;
+	case RENDER_FORMAT_ARGB2101010:
+		pixel = ((const uint32_t *)row)[x];
+		rgba[0] = (pixel >> 20 & 0x3ff) / 1023.f;
+		rgba[1] = (pixel >> 10 & 0x3ff) / 1023.f;
+		rgba[2] = (pixel & 0x3ff) / 1023.f;
+		rgba[3] = (pixel >> 30) / 3.f;
+		break;
+	default:
+		/* R8 or R8G8 of a YUV plane */
+		for (c = 0; c < 4; c++)
+			rgba[c] = c < p->channels ?
+				row[x * p->channels + c] / 255.f : c == 3;
+		break;
+	}
+}
+
+static int
+ifloor(float f)
+{
+	int i = f;
+
+	return i - (f < i);
+}
+
+static unsigned
+clamp_coord(int i, unsigned size)
+{
+	if (i < 0)
+		return 0;
+	if ((unsigned)i >= size)
+		return size - 1;
+	return i;
+}
+
+/* Samples p at the unnormalized coordinates (u, v). */
+static void
+sample(const struct plane *p, float u, float v, bool linear, float *rgba)
+{
+	float t00[4], t01[4], t10[4], t11[4], fu, fv;
+	int x, y, c;
+
+	if (!linear) {
+		decode(p, clamp_coord(ifloor(u), p->width),
+		       clamp_coord(ifloor(v), p->height), rgba);
+		return;
+	}
+
+	u -= .5f;
+	v -= .5f;
+	x = ifloor(u);
+	y = ifloor(v);
+	fu = u - x;
+	fv = v - y;
+
+	decode(p, clamp_coord(x, p->width), clamp_coord(y, p->height), t00);
+	decode(p, clamp_coord(x + 1, p->width), clamp_coord(y, p->height), t01);
+	decode(p, clamp_coord(x, p->width), clamp_coord(y + 1, p->height), t10);
+	decode(p, clamp_coord(x + 1, p->width), clamp_coord(y + 1, p->height), t11);
+
+	for (c = 0; c < 4; c++)
+		rgba[c] = (t00[c] * (1 - fu) + t01[c] * fu) * (1 - fv) +
+			  (t10[c] * (1 - fu) + t11[c] * fu) * fv;
+}
+
+static uint32_t
+quantize(float f, unsigned max)
+{
+	if (f < 0)
+		f = 0;
+	if (f > 1)
+		f = 1;
+
+	return f * max + .5f;
+}
+
+static void
+encode(struct scratch_buf *buf, enum render_format format,
+       unsigned x, unsigned y, const float *rgba)
+{
+	uint8_t *row = (uint8_t *)buf->data + y * buf->stride;
+
+	switch (format) {
+	case RENDER_FORMAT_ARGB8888:
+		((uint32_t *)row)[x] = quantize(rgba[3], 255) << 24 |
+				       quantize(rgba[0], 255) << 16 |
+				       quantize(rgba[1], 255) << 8 |
+				       quantize(rgba[2], 255);
+		break;
+	case RENDER_FORMAT_RGB565:
+		((uint16_t *)row)[x] = quantize(rgba[0], 31) << 11 |
+				       quantize(rgba[1], 63) << 5 |
+				       quantize(rgba[2], 31);
+		break;
+	case RENDER_FORMAT_ARGB2101010:
+		((uint32_t *)row)[x] = quantize(rgba[3], 3) << 30 |
+				       quantize(rgba[0], 1023) << 20 |
+				       quantize(rgba[1], 1023) << 10 |
+				       quantize(rgba[2], 1023);
+		break;
+	default:
+		assert(0);
+	}
+}
+
+void render_convert_reference(struct scratch_buf *src,
+			      enum render_format src_format,
+			      unsigned src_x, unsigned src_y,
+			      unsigned src_width, unsigned src_height,
+			      struct scratch_buf *dst,
+			      enum render_format dst_format,
+			      unsigned dst_x, unsigned dst_y,
+			      unsigned dst_width, unsigned dst_height)
+{
+	struct plane luma, u_plane, v_plane;
+	bool linear = src_width != dst_width || src_height != dst_height;
+	float sx = (float)src_width / dst_width;
+	float sy = (float)src_height / dst_height;
+	float rgba[4], y_, cb, cr;
+	unsigned x, y;
+
+	assert(!render_format_is_yuv(dst_format));
+
+	luma.data = (const uint8_t *)src->data;
+	luma.width = render_format_width(src, src_format);
+	luma.height = render_format_height(src, src_format);
+	luma.stride = src->stride;
+	luma.format = src_format;
+	luma.channels = 1;
+
+	u_plane = luma;
+	u_plane.data += src->stride * luma.height;
+	u_plane.width /= 2;
+	u_plane.height /= 2;
+	if (src_format == RENDER_FORMAT_I420) {
+		u_plane.stride /= 2;
+		v_plane = u_plane;
+		v_plane.data += u_plane.stride * u_plane.height;
+	} else {
+		u_plane.channels = 2;
+		v_plane = u_plane;
+	}
+
+	for (y = 0; y < dst_height; y++) {
+		for (x = 0; x < dst_width; x++) {
+			float u = src_x + (x + .5f) * sx;
+			float v = src_y + (y + .5f) * sy;
+
+			if (!render_format_is_yuv(src_format)) {
+				sample(&luma, u, v, linear, rgba);
+				encode(dst, dst_format,
+				       dst_x + x, dst_y + y, rgba);
+				continue;
+			}
+
+			sample(&luma, u, v, linear, rgba);
+			y_ = (rgba[0] - 16 / 255.f) * 1.164f;
+			sample(&u_plane, u / 2, v / 2, linear, rgba);
+			cb = rgba[0] - .5f;
+			if (src_format == RENDER_FORMAT_I420)
+				sample(&v_plane, u / 2, v / 2, linear, rgba);
+			cr = rgba[src_format == RENDER_FORMAT_I420 ? 0 : 1] - .5f;
+
+			rgba[0] = y_ + 1.596f * cr;
+			rgba[1] = y_ - .391f * cb - .813f * cr;
+			rgba[2] = y_ + 2.018f * cb;
+			rgba[3] = 1;
+			encode(dst, dst_format, dst_x + x, dst_y + y, rgba);
+		}
+	}
+}
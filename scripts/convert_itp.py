@@ -1,6 +1,7 @@
 #!/usr/bin/env python3
 
 #this script helps to convert internal debugger scripts given to us into our tools
+#the result is a register script, run it with: intel_reg_read --script <file>
 
 import sys
 import fileinput
@@ -13,5 +14,5 @@ def replace_with_dict(text, dicto):
 for lines in fileinput.input([sys.argv[1]], inplace=True):
 	lines = lines.strip()
 	if lines == '': continue # strip empty lines
-	replace_dict = {'dword(' : '../tools/intel_reg_read ', 'MMADDR + ' : '', '//' : '#', ')p;' : '', ')p ' : ' -c '}
+	replace_dict = {'dword(' : 'read ', 'MMADDR + ' : '', '//' : '#', ')p;' : '', ')p ' : ' '}
 	print(replace_with_dict(lines, replace_dict))
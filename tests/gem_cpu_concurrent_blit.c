@@ -109,6 +109,7 @@ main(int argc, char **argv)
 	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
 	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
 	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+	intel_batchbuffer_set_exec_fd(batch, fd);
 
 	if (!drmtest_only_list_subtests()) {
 		for (i = 0; i < num_buffers; i++) {
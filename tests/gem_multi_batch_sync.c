@@ -0,0 +1,170 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/** @file gem_multi_batch_sync.c
+ *
+ * Checks that intel_multi_batch_sync() orders the render ring after the blt
+ * ring.  A large fill is queued on blt, then an otherwise empty render batch
+ * that only shares the sync bo with it.  Once that render batch is idle the
+ * fill must be idle too.  That also has to hold when the fill was already
+ * flushed before the sync was set up.
+ *
+ * On the mock GEM device (INTEL_MOCK_GEM=<devid>) nothing is executed, and
+ * the test checks instead that every render batch is one the kernel would
+ * have made wait for the blt ring.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_bufmgr.h"
+#include "intel_batchbuffer.h"
+#include "intel_multi_batch.h"
+#include "intel_gpu_tools.h"
+#include "intel_mock_gem.h"
+
+#define WIDTH 1024
+#define HEIGHT 1024
+#define LOOPS 16
+
+static void
+blt_fill(struct intel_batchbuffer *batch, drm_intel_bo *bo, uint32_t color)
+{
+	BEGIN_BATCH(6);
+	OUT_BATCH(XY_COLOR_BLT_CMD |
+		  XY_COLOR_BLT_WRITE_ALPHA |
+		  XY_COLOR_BLT_WRITE_RGB);
+	OUT_BATCH((3 << 24) | /* 32 bits */
+		  (0xf0 << 16) | /* pattern copy ROP */
+		  WIDTH * 4);
+	OUT_BATCH(0); /* dst x1,y1 */
+	OUT_BATCH((HEIGHT << 16) | WIDTH);
+	OUT_RELOC(bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+	OUT_BATCH(color);
+	ADVANCE_BATCH();
+}
+
+/*
+ * One round: a fill on blt, then a render batch synchronised against it.
+ * With flush_first the fill is already submitted when the sync is set up,
+ * which leaves an empty blt batch to carry the sync.
+ */
+static int
+sync_round(int fd, struct intel_multi_batch *mb, drm_intel_bo *dst,
+	   uint32_t color, bool flush_first)
+{
+	struct intel_mock_gem_stats before, after;
+	struct intel_batchbuffer *batch;
+	drm_intel_bo *render_bo;
+	uint32_t pixel;
+	int failed = 0;
+
+	batch = intel_multi_batch_get(mb, INTEL_RING_BLT);
+	blt_fill(batch, dst, color);
+	if (flush_first)
+		intel_multi_batch_flush_ring(mb, INTEL_RING_BLT);
+
+	intel_multi_batch_sync(mb, INTEL_RING_RENDER, INTEL_RING_BLT);
+	batch = intel_multi_batch_get(mb, INTEL_RING_RENDER);
+	BEGIN_BATCH(2);
+	OUT_BATCH(MI_NOOP);
+	OUT_BATCH(MI_NOOP);
+	ADVANCE_BATCH();
+
+	render_bo = batch->bo;
+	drm_intel_bo_reference(render_bo);
+
+	if (intel_mock_gem_is_mock(fd))
+		intel_mock_gem_get_stats(fd, &before);
+	intel_multi_batch_flush_ring(mb, INTEL_RING_RENDER);
+
+	if (intel_mock_gem_is_mock(fd)) {
+		intel_mock_gem_get_stats(fd, &after);
+		if (after.ring_syncs != before.ring_syncs + 1) {
+			fprintf(stderr, "render batch %u didn't wait for blt\n",
+				color);
+			failed = 1;
+		}
+	} else {
+		drm_intel_bo_wait_rendering(render_bo);
+		if (drm_intel_bo_busy(dst)) {
+			fprintf(stderr, "render batch %u finished before blt\n",
+				color);
+			failed = 1;
+		}
+
+		drm_intel_bo_get_subdata(dst, 0, 4, &pixel);
+		if (pixel != color) {
+			fprintf(stderr, "Unexpected value 0x%08x instead of "
+				"0x%08x\n", pixel, color);
+			failed = 1;
+		}
+	}
+	drm_intel_bo_unreference(render_bo);
+
+	/* Start every round from idle rings. */
+	drm_intel_bo_wait_rendering(mb->sync_bo[INTEL_RING_BLT]);
+
+	return failed;
+}
+
+int main(int argc, char **argv)
+{
+	drm_intel_bufmgr *bufmgr;
+	struct intel_multi_batch *mb;
+	drm_intel_bo *dst;
+	uint32_t devid;
+	int fd, i, failed = 0;
+
+	fd = drm_open_any();
+	devid = intel_get_drm_devid(fd);
+	if (!HAS_BLT_RING(devid)) {
+		fprintf(stderr, "inter ring check needs gen6+\n");
+		return 77;
+	}
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	mb = intel_multi_batch_alloc(bufmgr, devid);
+	/* Both submission paths have to sync, use NO_RELOC where we can. */
+	intel_multi_batch_set_exec_fd(mb, fd);
+
+	dst = drm_intel_bo_alloc(bufmgr, "dst", WIDTH * HEIGHT * 4, 4096);
+
+	for (i = 0; i < LOOPS; i++)
+		failed |= sync_round(fd, mb, dst, i, false);
+	for (i = 0; i < LOOPS; i++)
+		failed |= sync_round(fd, mb, dst, LOOPS + i, true);
+
+	drm_intel_bo_unreference(dst);
+	intel_multi_batch_free(mb);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	close(fd);
+
+	return failed;
+}
@@ -0,0 +1,143 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/** @file gem_pread_after_blit_no_reloc.c
+ *
+ * Blits into a bo with intel_batchbuffer's NO_RELOC/HANDLE_LUT submission
+ * and preads it straight afterwards.  The kernel doesn't look at the
+ * relocations of a NO_RELOC execbuf, so the pread only waits for the blit
+ * if the batch flagged the destination with EXEC_OBJECT_WRITE.
+ *
+ * On the mock GEM device (INTEL_MOCK_GEM=<devid>) nothing is executed, and
+ * the test checks instead that every pread is one the kernel would have
+ * made wait for the blit.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "drm.h"
+#include "i915_drm.h"
+#include "drmtest.h"
+#include "intel_bufmgr.h"
+#include "intel_batchbuffer.h"
+#include "intel_gpu_tools.h"
+#include "intel_mock_gem.h"
+
+#define WIDTH 512
+#define HEIGHT 512
+#define SIZE (WIDTH * HEIGHT * 4)
+#define LOOPS 16
+
+static uint32_t buf[SIZE / 4];
+
+static drm_intel_bo *
+create_bo(drm_intel_bufmgr *bufmgr, uint32_t val)
+{
+	drm_intel_bo *bo;
+	int i;
+
+	bo = drm_intel_bo_alloc(bufmgr, "bo", SIZE, 4096);
+	for (i = 0; i < SIZE / 4; i++)
+		buf[i] = val + i;
+	drm_intel_bo_subdata(bo, 0, SIZE, buf);
+
+	return bo;
+}
+
+static int
+check_bo(drm_intel_bo *bo, uint32_t val)
+{
+	int i;
+
+	drm_intel_bo_get_subdata(bo, 0, SIZE, buf);
+	for (i = 0; i < SIZE / 4; i++) {
+		if (buf[i] != val + i) {
+			fprintf(stderr, "Unexpected value 0x%08x instead of "
+				"0x%08x at offset 0x%08x\n",
+				buf[i], val + i, i * 4);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	drm_intel_bufmgr *bufmgr;
+	struct intel_batchbuffer *batch;
+	struct intel_mock_gem_stats before, after;
+	drm_intel_bo *src[2], *dst;
+	bool mock;
+	int fd, i, failed = 0;
+
+	fd = drm_open_any();
+	mock = intel_mock_gem_is_mock(fd);
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+	if (!intel_batchbuffer_set_exec_fd(batch, fd)) {
+		printf("no NO_RELOC/HANDLE_LUT support, doing nothing\n");
+		return 77;
+	}
+
+	src[0] = create_bo(bufmgr, 0);
+	src[1] = create_bo(bufmgr, 0x10000000);
+	dst = create_bo(bufmgr, 0x20000000);
+
+	/* The first blit binds everything, the others go through NO_RELOC
+	 * and only differ in which source they read. */
+	for (i = 0; i < LOOPS; i++) {
+		intel_copy_bo(batch, dst, src[i & 1], WIDTH, HEIGHT);
+
+		if (mock) {
+			intel_mock_gem_get_stats(fd, &before);
+			drm_intel_bo_get_subdata(dst, 0, 4, buf);
+			intel_mock_gem_get_stats(fd, &after);
+			if (after.write_waits != before.write_waits + 1) {
+				fprintf(stderr, "pread %d didn't wait for the blit\n", i);
+				failed = 1;
+			}
+		} else {
+			failed |= check_bo(dst, (i & 1) * 0x10000000);
+		}
+	}
+
+	if (batch->exec_no_relocs == 0) {
+		fprintf(stderr, "no batch was submitted with NO_RELOC\n");
+		failed = 1;
+	}
+
+	drm_intel_bo_unreference(src[0]);
+	drm_intel_bo_unreference(src[1]);
+	drm_intel_bo_unreference(dst);
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	close(fd);
+
+	return failed;
+}
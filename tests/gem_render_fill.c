@@ -0,0 +1,211 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/** @file gem_render_fill.c
+ *
+ * Fills rectangles with the device's render fill function, and with the
+ * blitter fill it falls back to, on linear and tiled surfaces.  Every pixel
+ * is read back through the GTT and compared with the same fill done on the
+ * CPU, so both the inside and the outside of each rectangle are checked.
+ * render_clear() is checked the same way.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "rendercopy.h"
+#include "intel_mock_gem.h"
+
+#define WIDTH 512
+#define HEIGHT 512
+#define STRIDE (WIDTH * 4)
+#define SIZE (HEIGHT * STRIDE)
+
+#define BACKGROUND 0x00000000
+#define COLOR 0xff336699
+
+/* Odd sizes and positions, the surface corners and a full height strip. */
+static const struct render_rect rects[] = {
+	{ 0, 0, 1, 1 },
+	{ 3, 5, 64, 17 },
+	{ 100, 200, 133, 77 },
+	{ 300, 0, 45, HEIGHT },
+	{ 13, 400, 250, 1 },
+	{ WIDTH - 1, HEIGHT - 1, 1, 1 },
+};
+
+static uint32_t expected[WIDTH * HEIGHT];
+
+static void
+cpu_fill(const struct render_rect *r, uint32_t color)
+{
+	unsigned x, y;
+
+	for (y = r->y; y < r->y + r->height; y++)
+		for (x = r->x; x < r->x + r->width; x++)
+			expected[y * WIDTH + x] = color;
+}
+
+static void
+set_surface(struct scratch_buf *buf, uint32_t color)
+{
+	uint32_t *ptr;
+	int i;
+
+	do_or_die(drm_intel_gem_bo_map_gtt(buf->bo));
+	ptr = buf->bo->virtual;
+	for (i = 0; i < WIDTH * HEIGHT; i++)
+		ptr[i] = expected[i] = color;
+	drm_intel_gem_bo_unmap_gtt(buf->bo);
+}
+
+static int
+check_surface(struct scratch_buf *buf, const char *what)
+{
+	const uint32_t *ptr;
+	int x, y, ret = 0;
+
+	/* The GTT map waits for the fill and detiles through the fence. */
+	do_or_die(drm_intel_gem_bo_map_gtt(buf->bo));
+	ptr = buf->bo->virtual;
+	for (y = 0; y < HEIGHT && !ret; y++) {
+		for (x = 0; x < WIDTH; x++) {
+			if (ptr[y * WIDTH + x] != expected[y * WIDTH + x]) {
+				fprintf(stderr, "%s: (%d, %d) expected 0x%08x, "
+					"found 0x%08x\n", what, x, y,
+					expected[y * WIDTH + x],
+					ptr[y * WIDTH + x]);
+				ret = 1;
+				break;
+			}
+		}
+	}
+	drm_intel_gem_bo_unmap_gtt(buf->bo);
+
+	return ret;
+}
+
+static int
+run(struct intel_batchbuffer *batch, drm_intel_bufmgr *bufmgr,
+    render_fillfunc_t fill, const char *name, uint32_t tiling)
+{
+	struct scratch_buf buf;
+	uint32_t want = tiling;
+	char what[64];
+	unsigned i;
+	int ret;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.bo = drm_intel_bo_alloc(bufmgr, "surface", SIZE, 4096);
+	buf.stride = STRIDE;
+	buf.size = SIZE;
+	if (tiling != I915_TILING_NONE)
+		drm_intel_bo_set_tiling(buf.bo, &tiling, STRIDE);
+	if (tiling != want) {
+		drm_intel_bo_unreference(buf.bo);
+		return 0;
+	}
+	buf.tiling = tiling;
+
+	snprintf(what, sizeof(what), "%s, %s", name,
+		 tiling == I915_TILING_X ? "X-tiled" :
+		 tiling == I915_TILING_Y ? "Y-tiled" : "linear");
+	printf("%s\n", what);
+
+	set_surface(&buf, BACKGROUND);
+	fill(batch, &buf, rects, ARRAY_SIZE(rects), COLOR);
+	for (i = 0; i < ARRAY_SIZE(rects); i++)
+		cpu_fill(&rects[i], COLOR);
+	ret = check_surface(&buf, what);
+
+	drm_intel_bo_unreference(buf.bo);
+	return ret;
+}
+
+static int
+run_clear(struct intel_batchbuffer *batch, drm_intel_bufmgr *bufmgr)
+{
+	struct render_rect all = { 0, 0, WIDTH, HEIGHT };
+	struct scratch_buf buf;
+	int ret;
+
+	memset(&buf, 0, sizeof(buf));
+	buf.bo = drm_intel_bo_alloc(bufmgr, "surface", SIZE, 4096);
+	buf.stride = STRIDE;
+	buf.size = SIZE;
+	buf.tiling = I915_TILING_NONE;
+
+	printf("render_clear\n");
+	set_surface(&buf, BACKGROUND);
+	render_clear(batch, &buf, COLOR);
+	cpu_fill(&all, COLOR);
+	ret = check_surface(&buf, "render_clear");
+
+	drm_intel_bo_unreference(buf.bo);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	drm_intel_bufmgr *bufmgr;
+	struct intel_batchbuffer *batch;
+	render_fillfunc_t fill;
+	uint32_t devid;
+	int fd, failed = 0;
+
+	fd = drm_open_any();
+	if (intel_mock_gem_is_mock(fd)) {
+		printf("nothing is executed on the mock device, doing nothing\n");
+		return 77;
+	}
+	devid = intel_get_drm_devid(fd);
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	batch = intel_batchbuffer_alloc(bufmgr, devid);
+	intel_batchbuffer_set_exec_fd(batch, fd);
+
+	fill = get_render_fillfunc(devid);
+	if (fill != blt_render_fillfunc) {
+		failed |= run(batch, bufmgr, fill, "render", I915_TILING_NONE);
+		failed |= run(batch, bufmgr, fill, "render", I915_TILING_X);
+		failed |= run(batch, bufmgr, fill, "render", I915_TILING_Y);
+	}
+
+	/* The blitter can't address Y tiles from gen4 on. */
+	fill = blt_render_fillfunc;
+	failed |= run(batch, bufmgr, fill, "blitter", I915_TILING_NONE);
+	failed |= run(batch, bufmgr, fill, "blitter", I915_TILING_X);
+	if (!IS_965(devid))
+		failed |= run(batch, bufmgr, fill, "blitter", I915_TILING_Y);
+
+	failed |= run_clear(batch, bufmgr);
+
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	close(fd);
+
+	return failed;
+}
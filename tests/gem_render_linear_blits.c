@@ -79,6 +79,7 @@ int main(int argc, char **argv)
 
 	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
 	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+	intel_batchbuffer_set_exec_fd(batch, fd);
 
 	count = 0;
 	if (argc > 1)
@@ -39,11 +39,12 @@
 #include "drmtest.h"
 #include "intel_bufmgr.h"
 #include "intel_batchbuffer.h"
+#include "intel_multi_batch.h"
 #include "intel_gpu_tools.h"
 #include "i830_reg.h"
 
 static drm_intel_bufmgr *bufmgr;
-struct intel_batchbuffer *batch;
+static struct intel_multi_batch *mb;
 static drm_intel_bo *target_buffer;
 
 /*
@@ -63,9 +64,10 @@ store_dword_loop(void)
 	srandom(0xdeadbeef);
 
 	for (i = 0; i < 0x100000; i++) {
-		int ring = random() % 3 + 1;
+		int ring = random() % INTEL_NUM_RINGS;
+		struct intel_batchbuffer *batch = intel_multi_batch_get(mb, ring);
 
-		if (ring == I915_EXEC_RENDER) {
+		if (ring == INTEL_RING_RENDER) {
 			BEGIN_BATCH(4);
 			OUT_BATCH(MI_COND_BATCH_BUFFER_END | MI_DO_COMPARE);
 			OUT_BATCH(0xffffffff); /* compare dword */
@@ -82,7 +84,7 @@ store_dword_loop(void)
 			OUT_BATCH(MI_NOOP | (1<<22) | (0xf));
 			ADVANCE_BATCH();
 		}
-		intel_batchbuffer_flush_on_ring(batch, ring);
+		intel_multi_batch_flush_ring(mb, ring);
 	}
 
 	drm_intel_bo_map(target_buffer, 0);
@@ -115,11 +117,7 @@ int main(int argc, char **argv)
 	}
 	drm_intel_bufmgr_gem_enable_reuse(bufmgr);
 
-	batch = intel_batchbuffer_alloc(bufmgr, devid);
-	if (!batch) {
-		fprintf(stderr, "failed to create batch buffer\n");
-		exit(-1);
-	}
+	mb = intel_multi_batch_alloc(bufmgr, devid);
 
 	target_buffer = drm_intel_bo_alloc(bufmgr, "target bo", 4096, 4096);
 	if (!target_buffer) {
@@ -130,7 +128,7 @@ int main(int argc, char **argv)
 	store_dword_loop();
 
 	drm_intel_bo_unreference(target_buffer);
-	intel_batchbuffer_free(batch);
+	intel_multi_batch_free(mb);
 	drm_intel_bufmgr_destroy(bufmgr);
 
 	close(fd);
@@ -50,6 +50,9 @@
  */
 
 #include "rendercopy.h"
+#include "intel_batch_packets.h"
+#include "intel_tiling.h"
+#include "intel_mock_gem.h"
 
 #define CMD_POLY_STIPPLE_OFFSET       0x7906
 
@@ -79,6 +82,7 @@ struct option_struct {
     unsigned num_buffers;
     int trace_tile;
     int no_hw;
+    uint32_t mock_devid;
     int gpu_busy_load;
     int use_render;
     int use_blt;
@@ -128,7 +132,8 @@ static void emit_blt(drm_intel_bo *src_bo, uint32_t src_tiling, unsigned src_pit
 		     drm_intel_bo *dst_bo, uint32_t dst_tiling, unsigned dst_pitch,
 		     unsigned dst_x, unsigned dst_y)
 {
-	uint32_t cmd_bits = 0;
+	struct xy_src_copy_blt blt;
+	uint32_t cmd_bits = 0, offset;
 
 	if (IS_965(devid) && src_tiling) {
 		src_pitch /= 4;
@@ -141,28 +146,31 @@ static void emit_blt(drm_intel_bo *src_bo, uint32_t src_tiling, unsigned src_pit
 	}
 
 	/* copy lower half to upper half */
-	BEGIN_BATCH(8);
-	OUT_BATCH(XY_SRC_COPY_BLT_CMD |
-		  XY_SRC_COPY_BLT_WRITE_ALPHA |
-		  XY_SRC_COPY_BLT_WRITE_RGB |
-		  cmd_bits);
-	OUT_BATCH((3 << 24) | /* 32 bits */
-		  (0xcc << 16) | /* copy ROP */
-		  dst_pitch);
-	OUT_BATCH(dst_y << 16 | dst_x);
-	OUT_BATCH((dst_y+h) << 16 | (dst_x+w));
-	OUT_RELOC_FENCED(dst_bo, I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
-	OUT_BATCH(src_y << 16 | src_x);
-	OUT_BATCH(src_pitch);
-	OUT_RELOC_FENCED(src_bo, I915_GEM_DOMAIN_RENDER, 0, 0);
-	ADVANCE_BATCH();
+	blt = (struct xy_src_copy_blt) {
+		.cmd = XY_SRC_COPY_BLT_CMD |
+		       XY_SRC_COPY_BLT_WRITE_ALPHA |
+		       XY_SRC_COPY_BLT_WRITE_RGB |
+		       cmd_bits,
+		.br13 = (3 << 24) | /* 32 bits */
+			(0xcc << 16) | /* copy ROP */
+			dst_pitch,
+		.dst_x1y1 = BLT_XY(dst_x, dst_y),
+		.dst_x2y2 = BLT_XY(dst_x + w, dst_y + h),
+		.src_x1y1 = BLT_XY(src_x, src_y),
+		.src_pitch = src_pitch,
+	};
+	offset = OUT_PACKET(blt);
+	OUT_PACKET_RELOC_FENCED(offset, blt, dst, dst_bo,
+				I915_GEM_DOMAIN_RENDER, I915_GEM_DOMAIN_RENDER, 0);
+	OUT_PACKET_RELOC_FENCED(offset, blt, src, src_bo,
+				I915_GEM_DOMAIN_RENDER, 0, 0);
 
 	if (IS_GEN6(devid) || IS_GEN7(devid)) {
-		BEGIN_BATCH(3);
-		OUT_BATCH(XY_SETUP_CLIP_BLT_CMD);
-		OUT_BATCH(0);
-		OUT_BATCH(0);
-		ADVANCE_BATCH();
+		struct xy_setup_clip_blt clip = {
+			.cmd = XY_SETUP_CLIP_BLT_CMD,
+		};
+
+		OUT_PACKET(clip);
 	}
 }
 
@@ -225,6 +233,79 @@ static void cpucpy2d(uint32_t *src, unsigned src_stride, unsigned src_x, unsigne
 		stats.num_failed++;
 }
 
+/* Through cpu maps tiled buffers are seen as they are laid out in memory,
+ * so their tiles go through the tiling functions and a linear copy. */
+static bool cpu_tiled(struct scratch_buf *buf)
+{
+	return options.use_cpu_maps && buf->tiling != I915_TILING_NONE;
+}
+
+static void cpu_surface(struct scratch_buf *buf,
+			struct intel_tiled_surface *surf)
+{
+	memset(surf, 0, sizeof(*surf));
+	surf->ptr = buf->data;
+	surf->stride = buf->stride;
+	surf->gen = intel_gen(devid);
+	gem_get_tiling(drm_fd, buf->bo->handle, &surf->tiling, &surf->swizzle);
+}
+
+static void cpu_read_tile(struct scratch_buf *buf, unsigned x, unsigned y,
+			  uint32_t *tile, unsigned logical_tile_no)
+{
+	uint32_t tmp_tile[options.tile_size*options.tile_size];
+	unsigned tile_stride = options.tile_size*sizeof(uint32_t);
+	struct intel_tiled_surface surf;
+
+	if (!cpu_tiled(buf)) {
+		cpucpy2d(buf->data, buf->stride/sizeof(uint32_t), x, y,
+			 tile, options.tile_size, 0, 0, logical_tile_no);
+		return;
+	}
+
+	cpu_surface(buf, &surf);
+	intel_tiled_to_linear(tmp_tile, tile_stride, &surf,
+			      x*sizeof(uint32_t), y,
+			      tile_stride, options.tile_size);
+	cpucpy2d(tmp_tile, options.tile_size, 0, 0,
+		 tile, options.tile_size, 0, 0, logical_tile_no);
+}
+
+static void cpu_write_tile(struct scratch_buf *buf, unsigned x, unsigned y,
+			   uint32_t *tile, unsigned logical_tile_no)
+{
+	unsigned tile_stride = options.tile_size*sizeof(uint32_t);
+	struct intel_tiled_surface surf;
+
+	if (!cpu_tiled(buf)) {
+		cpucpy2d(tile, options.tile_size, 0, 0,
+			 buf->data, buf->stride/sizeof(uint32_t), x, y,
+			 logical_tile_no);
+		return;
+	}
+
+	cpu_surface(buf, &surf);
+	intel_linear_to_tiled(&surf, x*sizeof(uint32_t), y,
+			      tile, tile_stride, tile_stride, options.tile_size);
+}
+
+static void cpu_copy_tile(struct scratch_buf *src, unsigned src_x, unsigned src_y,
+			  struct scratch_buf *dst, unsigned dst_x, unsigned dst_y,
+			  unsigned logical_tile_no)
+{
+	uint32_t tmp_tile[options.tile_size*options.tile_size];
+
+	if (!cpu_tiled(src) && !cpu_tiled(dst)) {
+		cpucpy2d(src->data, src->stride/sizeof(uint32_t), src_x, src_y,
+			 dst->data, dst->stride/sizeof(uint32_t), dst_x, dst_y,
+			 logical_tile_no);
+		return;
+	}
+
+	cpu_read_tile(src, src_x, src_y, tmp_tile, logical_tile_no);
+	cpu_write_tile(dst, dst_x, dst_y, tmp_tile, logical_tile_no);
+}
+
 static void cpu_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned src_y,
 			 struct scratch_buf *dst, unsigned dst_x, unsigned dst_y,
 			 unsigned logical_tile_no)
@@ -239,9 +320,7 @@ static void cpu_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned src_y
 		set_to_cpu_domain(dst, 1);
 	}
 
-	cpucpy2d(src->data, src->stride/sizeof(uint32_t), src_x, src_y,
-		 dst->data, dst->stride/sizeof(uint32_t), dst_x, dst_y,
-		 logical_tile_no);
+	cpu_copy_tile(src, src_x, src_y, dst, dst_x, dst_y, logical_tile_no);
 }
 
 static void prw_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned src_y,
@@ -267,8 +346,7 @@ static void prw_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned src_y
 		if (options.use_cpu_maps)
 			set_to_cpu_domain(src, 0);
 
-		cpucpy2d(src->data, src->stride/sizeof(uint32_t), src_x, src_y,
-			 tmp_tile, options.tile_size, 0, 0, logical_tile_no);
+		cpu_read_tile(src, src_x, src_y, tmp_tile, logical_tile_no);
 	}
 
 	if (dst->tiling == I915_TILING_NONE) {
@@ -282,9 +360,7 @@ static void prw_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned src_y
 		if (options.use_cpu_maps)
 			set_to_cpu_domain(dst, 1);
 
-		cpucpy2d(tmp_tile, options.tile_size, 0, 0,
-			 dst->data, dst->stride/sizeof(uint32_t), dst_x, dst_y,
-			 logical_tile_no);
+		cpu_write_tile(dst, dst_x, dst_y, tmp_tile, logical_tile_no);
 	}
 }
 
@@ -318,25 +394,27 @@ static void blitter_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned s
 	}
 }
 
-static void render_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned src_y,
-			    struct scratch_buf *dst, unsigned dst_x, unsigned dst_y,
-			    unsigned logical_tile_no)
+/* Render copies are queued up and submitted as one list, the tiles copied
+ * within a pass never overlap. */
+#define MAX_RENDER_COPIES	64
+static struct render_copy render_copies[MAX_RENDER_COPIES];
+static int num_render_copies = 0;
+
+static void flush_render_copies(void)
 {
 	static unsigned keep_gpu_busy_counter = 0;
-	render_copyfunc_t rendercopy = get_render_copyfunc(devid);
+	render_copylistfunc_t rendercopy = get_render_copylistfunc(devid);
+
+	if (num_render_copies == 0)
+		return;
 
 	/* check both edges of the fence usage */
 	if (keep_gpu_busy_counter & 1)
 		keep_gpu_busy();
 
-	if (rendercopy)
-		rendercopy(batch, src, src_x, src_y,
-		     options.tile_size, options.tile_size,
-		     dst, dst_x, dst_y);
-	else
-		blitter_copyfunc(src, src_x, src_y,
-				 dst, dst_x, dst_y,
-				 logical_tile_no);
+	rendercopy(batch, render_copies, num_render_copies);
+	num_render_copies = 0;
+
 	if (!(keep_gpu_busy_counter & 1))
 		keep_gpu_busy();
 
@@ -344,6 +422,33 @@ static void render_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned sr
 	intel_batchbuffer_flush(batch);
 }
 
+static void render_copyfunc(struct scratch_buf *src, unsigned src_x, unsigned src_y,
+			    struct scratch_buf *dst, unsigned dst_x, unsigned dst_y,
+			    unsigned logical_tile_no)
+{
+	struct render_copy *copy;
+
+	if (!get_render_copylistfunc(devid)) {
+		blitter_copyfunc(src, src_x, src_y,
+				 dst, dst_x, dst_y,
+				 logical_tile_no);
+		return;
+	}
+
+	copy = &render_copies[num_render_copies++];
+	copy->src = src;
+	copy->src_x = src_x;
+	copy->src_y = src_y;
+	copy->width = options.tile_size;
+	copy->height = options.tile_size;
+	copy->dst = dst;
+	copy->dst_x = dst_x;
+	copy->dst_y = dst_y;
+
+	if (num_render_copies == MAX_RENDER_COPIES)
+		flush_render_copies();
+}
+
 static void next_copyfunc(int tile)
 {
 	if (fence_storm) {
@@ -405,10 +510,8 @@ static void fan_out(void)
 		if (options.use_cpu_maps)
 			set_to_cpu_domain(&buffers[current_set][buf_idx], 1);
 
-		cpucpy2d(tmp_tile, options.tile_size, 0, 0,
-			 buffers[current_set][buf_idx].data,
-			 buffers[current_set][buf_idx].stride / sizeof(uint32_t),
-			 x, y, i);
+		cpu_write_tile(&buffers[current_set][buf_idx], x, y,
+			       tmp_tile, i);
 	}
 
 	for (i = 0; i < num_total_tiles; i++)
@@ -430,11 +533,8 @@ static void fan_in_and_check(void)
 		if (options.use_cpu_maps)
 			set_to_cpu_domain(&buffers[current_set][buf_idx], 0);
 
-		cpucpy2d(buffers[current_set][buf_idx].data,
-			 buffers[current_set][buf_idx].stride / sizeof(uint32_t),
-			 x, y,
-			 tmp_tile, options.tile_size, 0, 0,
-			 i);
+		cpu_read_tile(&buffers[current_set][buf_idx], x, y,
+			      tmp_tile, i);
 	}
 }
 
@@ -469,15 +569,11 @@ static void init_buffer(struct scratch_buf *buf, unsigned size)
 
 	sanitize_stride(buf);
 
-	if (options.no_hw)
-		buf->data = malloc(size);
-	else {
-		if (options.use_cpu_maps)
-			drm_intel_bo_map(buf->bo, 1);
-		else
-			drm_intel_gem_bo_map_gtt(buf->bo);
-		buf->data = buf->bo->virtual;
-	}
+	if (options.use_cpu_maps)
+		drm_intel_bo_map(buf->bo, 1);
+	else
+		drm_intel_gem_bo_map_gtt(buf->bo);
+	buf->data = buf->bo->virtual;
 
 	buf->num_tiles = options.tiles_per_buf;
 }
@@ -540,6 +636,22 @@ static void init_set(unsigned set)
 			       buffers[set][i].tiling,
 			       buffers[set][i].stride);
 
+		/* Bit 17 swizzling depends on physical addresses we can't
+		 * see, so such buffers stay linear for the cpu. */
+		if (options.use_cpu_maps && buffers[set][i].tiling) {
+			uint32_t tiling, swizzle;
+
+			gem_get_tiling(drm_fd, buffers[set][i].bo->handle,
+				       &tiling, &swizzle);
+			if (swizzle == I915_BIT_6_SWIZZLE_9_17 ||
+			    swizzle == I915_BIT_6_SWIZZLE_9_10_17) {
+				buffers[set][i].tiling = I915_TILING_NONE;
+				gem_set_tiling(drm_fd,
+					       buffers[set][i].bo->handle,
+					       I915_TILING_NONE, 0);
+			}
+		}
+
 		if (options.trace_tile != -1 && i == options.trace_tile/options.tiles_per_buf)
 			printf("changing buffer %i containing tile %i: tiling %i, stride %i\n", i,
 					options.trace_tile,
@@ -584,22 +696,19 @@ static void copy_tiles(unsigned *permutation)
 				tile_permutation[i], src_buf_idx, src_tile,
 				permutation[idx], dst_buf_idx, dst_tile);
 
-		if (options.no_hw) {
-			cpucpy2d(src_buf->data,
-				 src_buf->stride / sizeof(uint32_t),
-				 src_x, src_y,
-				 dst_buf->data,
-				 dst_buf->stride / sizeof(uint32_t),
-				 dst_x, dst_y,
-				 i);
-		} else {
-			next_copyfunc(i);
+		next_copyfunc(i);
 
-			copyfunc(src_buf, src_x, src_y, dst_buf, dst_x, dst_y,
-				 i);
-		}
+		copyfunc(src_buf, src_x, src_y, dst_buf, dst_x, dst_y, i);
+
+		/* The mock device doesn't execute batches, do the gpu's part
+		 * of the copy on the cpu instead. */
+		if (options.no_hw &&
+		    (copyfunc == blitter_copyfunc || copyfunc == render_copyfunc))
+			cpu_copy_tile(src_buf, src_x, src_y,
+				      dst_buf, dst_x, dst_y, i);
 	}
 
+	flush_render_copies();
 	intel_batchbuffer_flush(batch);
 }
 
@@ -630,7 +739,7 @@ static void parse_options(int argc, char **argv)
 	int c, tmp;
 	int option_index = 0;
 	static struct option long_options[] = {
-		{"no-hw", 0, 0, 'd'},
+		{"no-hw", 2, 0, 'd'},
 		{"buf-size", 1, 0, 's'},
 		{"gpu-busy-load", 1, 0, 'g'},
 		{"no-signals", 0, 0, 'S'},
@@ -655,6 +764,7 @@ static void parse_options(int argc, char **argv)
 
 	options.scratch_buf_size = 256*4096;
 	options.no_hw = 0;
+	options.mock_devid = PCI_CHIP_IVYBRIDGE_GT2;
 	options.use_signal_helper = 1;
 	options.gpu_busy_load = 0;
 	options.num_buffers = 0;
@@ -675,7 +785,10 @@ static void parse_options(int argc, char **argv)
 		switch(c) {
 		case 'd':
 			options.no_hw = 1;
-			printf("no-hw debug mode\n");
+			if (optarg)
+				options.mock_devid = strtoul(optarg, NULL, 0);
+			printf("no-hw debug mode, mock device 0x%04x\n",
+			       options.mock_devid);
 			break;
 		case 'S':
 			options.use_signal_helper = 0;
@@ -724,17 +837,15 @@ static void parse_options(int argc, char **argv)
 			printf("disabling tiling\n");
 			break;
 		case 'x':
-			if (options.use_cpu_maps) {
-				printf("tiling not possible with cpu maps\n");
-			} else {
-				options.forced_tiling = I915_TILING_X;
-				printf("using only X-tiling\n");
-			}
+			options.forced_tiling = I915_TILING_X;
+			printf("using only X-tiling\n");
 			break;
 		case 'm':
 			options.use_cpu_maps = 1;
-			options.forced_tiling = I915_TILING_NONE;
-			printf("disabling tiling\n");
+			if (options.forced_tiling < 0) {
+				options.forced_tiling = I915_TILING_NONE;
+				printf("disabling tiling\n");
+			}
 			break;
 		case 'o':
 			options.total_rounds = atoi(optarg);
@@ -769,6 +880,12 @@ static void parse_options(int argc, char **argv)
 
 	if (optind < argc)
 		printf("unkown command options\n");
+}
+
+static void init(void)
+{
+	int i;
+	unsigned tmp;
 
 	/* actually 32767, according to docs, but that kills our nice pot calculations. */
 	options.max_dimension = 16*1024;
@@ -780,12 +897,6 @@ static void parse_options(int argc, char **argv)
 	}
 	printf("Limiting buffer to %dx%d\n",
 	       options.max_dimension, options.max_dimension);
-}
-
-static void init(void)
-{
-	int i;
-	unsigned tmp;
 
 	if (options.num_buffers == 0) {
 		tmp = gem_aperture_size(drm_fd);
@@ -801,6 +912,7 @@ static void init(void)
 	drm_intel_bufmgr_gem_enable_fenced_relocs(bufmgr);
 	num_fences = get_num_fences();
 	batch = intel_batchbuffer_alloc(bufmgr, devid);
+	intel_batchbuffer_set_exec_fd(batch, drm_fd);
 
 	busy_bo = drm_intel_bo_alloc(bufmgr, "tiled bo", BUSY_BUF_SIZE, 4096);
 	if (options.forced_tiling >= 0)
@@ -824,7 +936,7 @@ static void check_render_copyfunc(void)
 	uint32_t *ptr;
 	int i, j, pass;
 
-	if (!options.check_render_cpyfn)
+	if (!options.check_render_cpyfn || options.no_hw)
 		return;
 
 	init_buffer(&src, options.scratch_buf_size);
@@ -847,6 +959,7 @@ static void check_render_copyfunc(void)
 		}
 
 		render_copyfunc(&src, sx, sy, &dst, dx, dy, 0);
+		flush_render_copies();
 
 		if (options.use_cpu_maps)
 			set_to_cpu_domain(&dst, 0);
@@ -868,11 +981,14 @@ int main(int argc, char **argv)
 	int i, j;
 	unsigned *current_permutation, *tmp_permutation;
 
+	parse_options(argc, argv);
+
+	if (options.no_hw)
+		intel_mock_gem_enable(options.mock_devid);
+
 	drm_fd = drm_open_any();
 	devid = intel_get_drm_devid(drm_fd);
 
-	parse_options(argc, argv);
-
 	/* start our little helper early before too may allocations occur */
 	if (options.use_signal_helper)
 		drmtest_fork_signal_helper();
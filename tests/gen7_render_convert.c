@@ -0,0 +1,236 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/** @file gen7_render_convert.c
+ *
+ * Runs every source and destination format combination of the render
+ * convert function through unscaled, downscaled and upscaled copies, and
+ * checks the results against render_convert_reference.  The sampler and
+ * the render target write round differently from the CPU, so each channel
+ * may be off by one step.  That is one step of the 8 bit sources for the
+ * 10 bit channels, which can't be any more precise than that.
+ */
+
+#include "rendercopy.h"
+#include "intel_mock_gem.h"
+
+#define WIDTH 256
+#define HEIGHT 256
+#define STRIDE (WIDTH * 4)
+#define SIZE (HEIGHT * STRIDE)
+
+static const char *format_names[] = {
+	[RENDER_FORMAT_ARGB8888] = "ARGB8888",
+	[RENDER_FORMAT_RGB565] = "RGB565",
+	[RENDER_FORMAT_ARGB2101010] = "ARGB2101010",
+	[RENDER_FORMAT_I420] = "I420",
+	[RENDER_FORMAT_NV12] = "NV12",
+};
+
+static const struct {
+	unsigned src_size, dst_size;
+} scales[] = {
+	{ 128, 128 },
+	{ 192, 96 },
+	{ 64, 128 },
+};
+
+/* Splits a destination pixel into channels, along with the largest value
+ * of each, and returns how many there are. */
+static int
+unpack(enum render_format format, const uint8_t *row, unsigned x,
+       int *channels, int *max)
+{
+	uint32_t pixel;
+
+	switch (format) {
+	case RENDER_FORMAT_ARGB8888:
+		pixel = ((const uint32_t *)row)[x];
+		channels[0] = pixel >> 16 & 0xff;
+		channels[1] = pixel >> 8 & 0xff;
+		channels[2] = pixel & 0xff;
+		channels[3] = pixel >> 24;
+		max[0] = max[1] = max[2] = max[3] = 255;
+		return 4;
+	case RENDER_FORMAT_RGB565:
+		pixel = ((const uint16_t *)row)[x];
+		channels[0] = pixel >> 11;
+		channels[1] = pixel >> 5 & 0x3f;
+		channels[2] = pixel & 0x1f;
+		max[0] = max[2] = 31;
+		max[1] = 63;
+		return 3;
+	case RENDER_FORMAT_ARGB2101010:
+		pixel = ((const uint32_t *)row)[x];
+		channels[0] = pixel >> 20 & 0x3ff;
+		channels[1] = pixel >> 10 & 0x3ff;
+		channels[2] = pixel & 0x3ff;
+		channels[3] = pixel >> 30;
+		max[0] = max[1] = max[2] = 1023;
+		max[3] = 3;
+		return 4;
+	default:
+		assert(0);
+		return 0;
+	}
+}
+
+static int
+check(struct scratch_buf *dst, struct scratch_buf *ref,
+      enum render_format format, unsigned width, unsigned height)
+{
+	int got[4], expected[4], max[4], n, c, tolerance;
+	unsigned x, y;
+
+	for (y = 0; y < height; y++) {
+		const uint8_t *row = (uint8_t *)dst->data + y * dst->stride;
+		const uint8_t *ref_row = (uint8_t *)ref->data + y * ref->stride;
+
+		for (x = 0; x < width; x++) {
+			n = unpack(format, row, x, got, max);
+			unpack(format, ref_row, x, expected, max);
+
+			for (c = 0; c < n; c++) {
+				tolerance = max[c] > 255 ? max[c] / 255 : 1;
+				if (abs(got[c] - expected[c]) <= tolerance)
+					continue;
+
+				fprintf(stderr, "(%d, %d) channel %d: expected %d, found %d\n",
+					x, y, c, expected[c], got[c]);
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void
+init_buf(drm_intel_bufmgr *bufmgr, struct scratch_buf *buf, uint32_t stride,
+	 uint32_t size)
+{
+	memset(buf, 0, sizeof(*buf));
+	buf->bo = drm_intel_bo_alloc(bufmgr, "", size, 4096);
+	buf->stride = stride;
+	buf->tiling = I915_TILING_NONE;
+	buf->size = size;
+	buf->data = malloc(size);
+}
+
+static void
+fini_buf(struct scratch_buf *buf)
+{
+	drm_intel_bo_unreference(buf->bo);
+	free(buf->data);
+}
+
+int main(int argc, char **argv)
+{
+	drm_intel_bufmgr *bufmgr;
+	struct intel_batchbuffer *batch;
+	render_convertfunc_t convert;
+	struct scratch_buf src, dst, ref;
+	enum render_format src_format, dst_format;
+	unsigned i, j, src_size, dst_size;
+	int fd, failed = 0;
+
+	fd = drm_open_any();
+	if (intel_mock_gem_is_mock(fd)) {
+		printf("nothing is executed on the mock device, doing nothing\n");
+		return 77;
+	}
+
+	convert = get_render_convertfunc(intel_get_drm_devid(fd));
+	if (convert == NULL) {
+		printf("no render-convert function, doing nothing\n");
+		return 77;
+	}
+
+	bufmgr = drm_intel_bufmgr_gem_init(fd, 4096);
+	batch = intel_batchbuffer_alloc(bufmgr, intel_get_drm_devid(fd));
+	intel_batchbuffer_set_exec_fd(batch, fd);
+
+	/* Destinations are only RGB, one 32bpp sized buffer fits them all. */
+	init_buf(bufmgr, &dst, STRIDE, SIZE);
+	init_buf(bufmgr, &ref, STRIDE, SIZE);
+
+	for (src_format = RENDER_FORMAT_ARGB8888;
+	     src_format <= RENDER_FORMAT_NV12; src_format++) {
+		/* A whole number of rows, so that render_format_height()
+		 * finds the chroma planes again. */
+		uint32_t stride = render_format_is_yuv(src_format) ? WIDTH :
+				  src_format == RENDER_FORMAT_RGB565 ? WIDTH * 2 :
+				  STRIDE;
+		uint32_t size = render_format_is_yuv(src_format) ?
+				stride * HEIGHT * 3 / 2 : stride * HEIGHT;
+
+		init_buf(bufmgr, &src, stride, size);
+		for (j = 0; j < size; j++)
+			((uint8_t *)src.data)[j] = random();
+		drm_intel_bo_subdata(src.bo, 0, size, src.data);
+
+		for (dst_format = RENDER_FORMAT_ARGB8888;
+		     dst_format <= RENDER_FORMAT_ARGB2101010; dst_format++) {
+			for (i = 0; i < ARRAY_SIZE(scales); i++) {
+				src_size = scales[i].src_size;
+				dst_size = scales[i].dst_size;
+
+				printf("%s %ux%u to %s %ux%u\n",
+				       format_names[src_format],
+				       src_size, src_size,
+				       format_names[dst_format],
+				       dst_size, dst_size);
+
+				memset(ref.data, 0, SIZE);
+				drm_intel_bo_subdata(dst.bo, 0, SIZE, ref.data);
+
+				convert(batch, &src, src_format, 16, 16,
+					src_size, src_size,
+					&dst, dst_format, 8, 8,
+					dst_size, dst_size);
+				render_convert_reference(&src, src_format,
+							 16, 16,
+							 src_size, src_size,
+							 &ref, dst_format, 8, 8,
+							 dst_size, dst_size);
+
+				drm_intel_bo_get_subdata(dst.bo, 0, SIZE,
+							 dst.data);
+				failed |= check(&dst, &ref, dst_format,
+						dst_size + 16, dst_size + 16);
+			}
+		}
+
+		fini_buf(&src);
+	}
+
+	fini_buf(&dst);
+	fini_buf(&ref);
+	intel_batchbuffer_free(batch);
+	drm_intel_bufmgr_destroy(bufmgr);
+
+	close(fd);
+
+	return failed;
+}
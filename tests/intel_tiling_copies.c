@@ -0,0 +1,307 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/** @file intel_tiling_copies.c
+ *
+ * Checks the CPU tiling copies of intel_tiling.c without any GPU.  Random
+ * rectangles, at any byte offset and width and with a linear stride that
+ * isn't 16 byte aligned, are copied to and from X, Y and gen2 X tiled
+ * surfaces in every bit 6 swizzle mode.  Each copy is compared byte by byte with what
+ * intel_tiled_offset() says, including the bytes around the rectangle that
+ * must be left alone.  That is done for every implementation the CPU has,
+ * single threaded and over the thread pool, synchronously and through the
+ * asynchronous interface.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "i915_drm.h"
+#include "intel_gpu_tools.h"
+#include "intel_tiling.h"
+
+#define RECTS 16
+#define BIG_RECTS 4
+
+static const struct {
+	const char *name;
+	uint32_t tiling;
+	int gen;
+} layouts[] = {
+	{ "X", I915_TILING_X, 6 },
+	{ "Y", I915_TILING_Y, 6 },
+	{ "gen2 X", I915_TILING_X, 2 },
+};
+
+static const struct {
+	const char *name;
+	uint32_t swizzle;
+} swizzles[] = {
+	{ "none", I915_BIT_6_SWIZZLE_NONE },
+	{ "9", I915_BIT_6_SWIZZLE_9 },
+	{ "9_10", I915_BIT_6_SWIZZLE_9_10 },
+	{ "9_11", I915_BIT_6_SWIZZLE_9_11 },
+	{ "9_10_11", I915_BIT_6_SWIZZLE_9_10_11 },
+	{ "9_17", I915_BIT_6_SWIZZLE_9_17 },
+	{ "9_10_17", I915_BIT_6_SWIZZLE_9_10_17 },
+};
+
+struct rect {
+	unsigned x, y, width, height;
+};
+
+static void
+fill_random(uint8_t *p, size_t size)
+{
+	while (size--)
+		*p++ = random();
+}
+
+/* The copy done one byte at a time through intel_tiled_offset(). */
+static void
+reference_copy(const struct intel_tiled_surface *surf, uint8_t *tiled,
+	       uint8_t *linear, uint32_t stride, const struct rect *r,
+	       bool to_tiled)
+{
+	unsigned x, y;
+	uint32_t offset;
+
+	for (y = 0; y < r->height; y++) {
+		for (x = 0; x < r->width; x++) {
+			offset = intel_tiled_offset(surf, r->x + x, r->y + y);
+			if (to_tiled)
+				tiled[offset] = linear[y * stride + x];
+			else
+				linear[y * stride + x] = tiled[offset];
+		}
+	}
+}
+
+static int
+compare(const uint8_t *got, const uint8_t *expected, size_t size,
+	const char *what)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (got[i] != expected[i]) {
+			fprintf(stderr, "%s: byte %zu is 0x%02x instead of "
+				"0x%02x\n", what, i, got[i], expected[i]);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * One rectangle in both directions with the current implementation and
+ * thread count.  tiled and linear hold the starting contents, which are
+ * left as they were.
+ */
+static int
+check_rect(const struct intel_tiled_surface *surf, size_t tiled_size,
+	   const uint8_t *tiled, const uint8_t *linear, uint32_t stride,
+	   const struct rect *r, bool async, const char *what)
+{
+	size_t linear_size = (size_t)stride * r->height;
+	uint8_t *got_tiled, *want_tiled, *got_linear, *want_linear;
+	struct intel_tiled_surface dst = *surf;
+	char buf[256];
+	int ret = 0;
+
+	got_tiled = malloc(tiled_size);
+	want_tiled = malloc(tiled_size);
+	got_linear = malloc(linear_size);
+	want_linear = malloc(linear_size);
+	assert(got_tiled && want_tiled && got_linear && want_linear);
+
+	memcpy(got_tiled, tiled, tiled_size);
+	memcpy(want_tiled, tiled, tiled_size);
+	dst.ptr = got_tiled;
+	if (async)
+		intel_tiling_job_wait(intel_linear_to_tiled_async(&dst,
+								  r->x, r->y,
+								  linear, stride,
+								  r->width,
+								  r->height));
+	else
+		intel_linear_to_tiled(&dst, r->x, r->y, linear, stride,
+				      r->width, r->height);
+	reference_copy(surf, want_tiled, (uint8_t *)linear, stride, r, true);
+	snprintf(buf, sizeof(buf), "%s, to tiled", what);
+	ret |= compare(got_tiled, want_tiled, tiled_size, buf);
+
+	memcpy(got_linear, linear, linear_size);
+	memcpy(want_linear, linear, linear_size);
+	dst.ptr = (void *)tiled;
+	if (async)
+		intel_tiling_job_wait(intel_tiled_to_linear_async(got_linear,
+								  stride, &dst,
+								  r->x, r->y,
+								  r->width,
+								  r->height));
+	else
+		intel_tiled_to_linear(got_linear, stride, &dst, r->x, r->y,
+				      r->width, r->height);
+	reference_copy(surf, (uint8_t *)tiled, want_linear, stride, r, false);
+	snprintf(buf, sizeof(buf), "%s, from tiled", what);
+	ret |= compare(got_linear, want_linear, linear_size, buf);
+
+	free(got_tiled);
+	free(want_tiled);
+	free(got_linear);
+	free(want_linear);
+	return ret;
+}
+
+static void
+random_rect(struct rect *r, unsigned width, unsigned height)
+{
+	r->x = random() % width;
+	r->y = random() % height;
+	r->width = 1 + random() % (width - r->x);
+	r->height = 1 + random() % (height - r->y);
+}
+
+/*
+ * Random rectangles on a surface of a few tiles in one layout and swizzle
+ * mode.  A big surface is 1 MiB, several bands for the thread pool, and
+ * starts with a copy of all of it.
+ */
+static int
+check_surface(int layout, int swizzle, bool big, const char *impl)
+{
+	struct intel_tiled_surface surf;
+	unsigned tw, th, width, height;
+	uint32_t stride;
+	size_t size;
+	uint8_t *tiled, *linear, *bit17;
+	struct rect rects[RECTS];
+	unsigned threads[] = { 1, 4 };
+	char what[192];
+	int i, t, async, nrects, ret = 0;
+
+	memset(&surf, 0, sizeof(surf));
+	surf.tiling = layouts[layout].tiling;
+	surf.gen = layouts[layout].gen;
+	surf.swizzle = swizzles[swizzle].swizzle;
+	intel_tile_dims(&surf, &tw, &th);
+
+	if (big) {
+		width = 4096;
+		height = 256;
+	} else {
+		width = (1 + random() % 4) * tw;
+		height = (1 + random() % 3) * th;
+	}
+	surf.stride = width;
+	size = (size_t)width * height;
+
+	/* bit 17 of each page, random as it would be for a real bo */
+	bit17 = malloc(size / 4096 + 1);
+	tiled = malloc(size);
+	assert(bit17 && tiled);
+	fill_random(bit17, size / 4096 + 1);
+	fill_random(tiled, size);
+	surf.bit17 = bit17;
+
+	if (big) {
+		rects[0].x = rects[0].y = 0;
+		rects[0].width = width;
+		rects[0].height = height;
+	}
+	nrects = big ? BIG_RECTS : RECTS;
+	for (i = big; i < nrects; i++)
+		random_rect(&rects[i], width, height);
+
+	for (i = 0; i < nrects && !ret; i++) {
+		/* never a multiple of 16, to catch aligned access */
+		stride = rects[i].width + 1 + random() % 15 * 2;
+		if (stride % 16 == 0)
+			stride++;
+		linear = malloc((size_t)stride * rects[i].height);
+		assert(linear);
+		fill_random(linear, (size_t)stride * rects[i].height);
+
+		for (t = 0; t < ARRAY_SIZE(threads) && !ret; t++) {
+			intel_tiling_set_threads(threads[t]);
+			for (async = 0; async < 2 && !ret; async++) {
+				snprintf(what, sizeof(what),
+					 "%s, %s, swizzle %s, %u thread%s%s, "
+					 "%ux%u at (%u, %u) of %ux%u",
+					 impl, layouts[layout].name,
+					 swizzles[swizzle].name, threads[t],
+					 threads[t] > 1 ? "s" : "",
+					 async ? ", async" : "",
+					 rects[i].width, rects[i].height,
+					 rects[i].x, rects[i].y,
+					 width, height);
+				ret |= check_rect(&surf, size, tiled, linear,
+						  stride, &rects[i], async,
+						  what);
+			}
+		}
+
+		free(linear);
+	}
+
+	free(tiled);
+	free(bit17);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	int impl, layout, swizzle, failed = 0;
+
+	srandom(0xdeadbeef);
+
+	for (impl = 0; impl < INTEL_TILING_NUM_IMPLS; impl++) {
+		if (intel_tiling_set_impl(impl)) {
+			printf("%s: not supported by this CPU\n",
+			       intel_tiling_impl_name(impl));
+			continue;
+		}
+
+		for (layout = 0; layout < ARRAY_SIZE(layouts); layout++) {
+			for (swizzle = 0; swizzle < ARRAY_SIZE(swizzles);
+			     swizzle++) {
+				printf("%s, %s, swizzle %s\n",
+				       intel_tiling_impl_name(impl),
+				       layouts[layout].name,
+				       swizzles[swizzle].name);
+				failed |= check_surface(layout, swizzle, false,
+							intel_tiling_impl_name(impl));
+				failed |= check_surface(layout, swizzle, true,
+							intel_tiling_impl_name(impl));
+			}
+		}
+	}
+
+	intel_tiling_set_threads(0);
+
+	return failed;
+}
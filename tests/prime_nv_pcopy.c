@@ -29,6 +29,7 @@
 #include "intel_gpu_tools.h"
 #include "intel_batchbuffer.h"
 #include "drmtest.h"
+#include "intel_tiling.h"
 
 static int intel_fd = -1, nouveau_fd = -1;
 static drm_intel_bufmgr *bufmgr;
@@ -350,54 +351,19 @@ static void fill16(void *ptr, uint32_t val)
 	p[0] = p[1] = p[2] = p[3] = val;
 }
 
-#define TILE_SIZE 4096
-
-static int swtile_y(uint8_t *out, const uint8_t *in, int w, int h)
+/* Tiles the w x h linear in into out in the layout the intel bo gets,
+ * without swizzling as the copy engine doesn't swizzle either. */
+static int swtile(uint8_t *out, const uint8_t *in, int w, int h,
+		  uint32_t tiling)
 {
-	uint32_t x, y, dx, dy;
-	uint8_t *endptr = out + w * h;
-	assert(!(w % 128));
-	assert(!(h % 32));
-
-	for (y = 0; y < h; y += 32) {
-		for (x = 0; x < w; x += 128, out += TILE_SIZE) {
-			for (dx = 0; dx < 8; ++dx) {
-				for (dy = 0; dy < 32; ++dy) {
-					uint32_t out_ofs = (dx * 32 + dy) * 16;
-					uint32_t in_ofs = (y + dy) * w + (x + 16 * dx);
-					assert(out_ofs < TILE_SIZE);
-					assert(in_ofs < w*h);
-
-					// To do the Y tiling quirk:
-					// out_ofs = out_ofs ^ (((out_ofs >> 9) & 1) << 6);
-					memcpy(&out[out_ofs], &in[in_ofs], 16);
-				}
-			}
-		}
-	}
-	assert(out == endptr);
-	return 0;
-}
+	struct intel_tiled_surface surf = {
+		.ptr = out,
+		.stride = w,
+		.tiling = tiling,
+		.swizzle = I915_BIT_6_SWIZZLE_NONE,
+	};
 
-static int swtile_x(uint8_t *out, const uint8_t *in, int w, int h)
-{
-	uint32_t x, y, dy;
-	uint8_t *endptr = out + w * h;
-	assert(!(w % 512));
-	assert(!(h % 8));
-
-	for (y = 0; y < h; y += 8) {
-		for (x = 0; x < w; x += 512, out += TILE_SIZE) {
-			for (dy = 0; dy < 8; ++dy) {
-				uint32_t out_ofs = 512 * dy;
-				uint32_t in_ofs = (y + dy) * w + x;
-				assert(out_ofs < TILE_SIZE);
-				assert(in_ofs < w*h);
-				memcpy(&out[out_ofs], &in[in_ofs], 512);
-			}
-		}
-	}
-	assert(out == endptr);
+	intel_linear_to_tiled(&surf, 0, 0, in, w, w, h);
 	return 0;
 }
 
@@ -695,7 +661,7 @@ static int test1_macro(void)
 	if (pcopy)
 		ret = perform_copy(nvbo, &dst, 0, 0, nvbi, &src, 0, 0, w, h);
 	else
-		ret = swtile_y(nvbo->map, nvbi->map, w, h);
+		ret = swtile(nvbo->map, nvbi->map, w, h, I915_TILING_Y);
 	if (!ret)
 		ret = check1_macro(nvbo->map, w/128, h/32);
 
@@ -803,7 +769,8 @@ static int test1_micro(void)
 	if (pcopy)
 		ret = perform_copy(bo_intel, &intel, dst_x, dst_y, bo_nvidia, &nvidia, src_x, src_y, w, h);
 	else
-		ret = swtile_y(test_intel_bo->virtual, bo_linear->map, w, h);
+		ret = swtile(test_intel_bo->virtual, bo_linear->map, w, h,
+			     I915_TILING_Y);
 	if (ret)
 		goto out;
 
@@ -1002,7 +969,7 @@ static int test2(void)
 	if (0 && pcopy)
 		ret = perform_copy(nvbo, &dst, 0, 0, nvbi, &src, 0, 0, w, h);
 	else
-		ret = swtile_x(nvbo->map, nvbi->map, w, h);
+		ret = swtile(nvbo->map, nvbi->map, w, h, I915_TILING_X);
 	if (!ret)
 		ret = check1_macro(nvbo->map, w/512, h/8);
 
@@ -32,11 +32,15 @@
 #include <stdio.h>
 #include <string.h>
 #include <err.h>
+#include <errno.h>
 #include <arpa/inet.h>
 #include "intel_gpu_tools.h"
 
 static uint32_t devid;
 
+/* Decoding a register snapshot rather than live MMIO */
+static int snapshot;
+
 
 #define BITSTO(n)		(n >= sizeof(long) * 8 ? ~0 : (1UL << (n)) - 1)
 #define BITMASK(high, low)	(BITSTO(high+1) & ~BITSTO(low))
@@ -189,6 +193,48 @@ static const char *n_index_value[] = {
 	[1] = "DisplayPort",
 };
 
+/*
+ * The ELD, audio infoframe and channel map buffers are read through an index
+ * in a control register.  A snapshot only holds whatever the data register
+ * returned at capture time, so these are skipped when decoding one.
+ */
+static void dump_eld(uint32_t ctl, uint32_t index_mask, uint32_t data)
+{
+	uint32_t dword;
+	int i;
+
+	if (snapshot) {
+		printf("(not available in snapshot)\n");
+		return;
+	}
+
+	dword = INREG(ctl);
+	dword &= ~index_mask;
+	OUTREG(ctl, dword);
+	for (i = 0; i < BITS(dword, 14, 10) / 4; i++)
+		printf("%08x ", htonl(INREG(data)));
+	printf("\n");
+}
+
+static void dump_infoframe(uint32_t ctl, uint32_t data)
+{
+	uint32_t dword;
+	int i;
+
+	if (snapshot) {
+		printf("(not available in snapshot)\n");
+		return;
+	}
+
+	dword = INREG(ctl);
+	dword &= ~BITMASK(20, 18);
+	dword &= ~BITMASK(3, 0);
+	OUTREG(ctl, dword);
+	for (i = 0; i < 8; i++)
+		printf("%08x ", htonl(INREG(data)));
+	printf("\n");
+}
+
 static void do_self_tests(void)
 {
     if (BIT(1, 0) != 1)
@@ -481,28 +527,19 @@ static void dump_eaglelake(void)
     printf("AUD_CONV_CHCNT HDMI channel count\t%lu\n", BITS(dword, 11, 8) + 1);
 
     printf("AUD_CONV_CHCNT HDMI channel mapping:\n");
-    for (i = 0; i < 8; i++) {
+    if (snapshot)
+	    printf("\t(not available in snapshot)\n");
+    for (i = 0; !snapshot && i < 8; i++) {
 	    OUTREG(AUD_CONV_CHCNT, i);
 	    dword = INREG(AUD_CONV_CHCNT);
 	    printf("\t\t\t\t\t[0x%x] %u => %lu \n", dword, i, BITS(dword, 7, 4));
     }
 
     printf("AUD_HDMIW_HDMIEDID HDMI ELD:\n\t");
-    dword = INREG(AUD_CNTL_ST);
-    dword &= ~BITMASK(8, 5);
-    OUTREG(AUD_CNTL_ST, dword);
-    for (i = 0; i < BITS(dword, 14, 10) / 4; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_HDMIEDID)));
-    printf("\n");
+    dump_eld(AUD_CNTL_ST, BITMASK(8, 5), AUD_HDMIW_HDMIEDID);
 
     printf("AUD_HDMIW_INFOFR HDMI audio Infoframe:\n\t");
-    dword = INREG(AUD_CNTL_ST);
-    dword &= ~BITMASK(20, 18);
-    dword &= ~BITMASK(3, 0);
-    OUTREG(AUD_CNTL_ST, dword);
-    for (i = 0; i < 8; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_INFOFR)));
-    printf("\n");
+    dump_infoframe(AUD_CNTL_ST, AUD_HDMIW_INFOFR);
 }
 
 #undef AUD_RID
@@ -737,7 +774,9 @@ static void dump_ironlake(void)
     printf("AUD_OUT_DIG_CNVT_B  Stream_ID\t\t\t\t%lu\n",	BITS(dword, 23, 20));
 
     printf("AUD_OUT_CH_STR  Converter_Channel_MAP	PORTB	PORTC	PORTD\n");
-    for (i = 0; i < 8; i++) {
+    if (snapshot)
+	    printf("\t(not available in snapshot)\n");
+    for (i = 0; !snapshot && i < 8; i++) {
 	    OUTREG(AUD_OUT_CH_STR, i | (i << 8) | (i << 16));
 	    dword = INREG(AUD_OUT_CH_STR);
 	    printf("\t\t\t\t%lu\t%lu\t%lu\t%lu\n",
@@ -807,38 +846,16 @@ static void dump_ironlake(void)
     printf("AUD_HDMIW_STATUS  Function_Reset\t\t\t%lu\n",		 BIT(dword, 29));
 
     printf("AUD_HDMIW_HDMIEDID_A HDMI ELD:\n\t");
-    dword = INREG(AUD_CNTL_ST_A);
-    dword &= ~BITMASK(9, 5);
-    OUTREG(AUD_CNTL_ST_A, dword);
-    for (i = 0; i < BITS(dword, 14, 10) / 4; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_HDMIEDID_A)));
-    printf("\n");
+    dump_eld(AUD_CNTL_ST_A, BITMASK(9, 5), AUD_HDMIW_HDMIEDID_A);
 
     printf("AUD_HDMIW_HDMIEDID_B HDMI ELD:\n\t");
-    dword = INREG(AUD_CNTL_ST_B);
-    dword &= ~BITMASK(9, 5);
-    OUTREG(AUD_CNTL_ST_B, dword);
-    for (i = 0; i < BITS(dword, 14, 10) / 4; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_HDMIEDID_B)));
-    printf("\n");
+    dump_eld(AUD_CNTL_ST_B, BITMASK(9, 5), AUD_HDMIW_HDMIEDID_B);
 
     printf("AUD_HDMIW_INFOFR_A HDMI audio Infoframe:\n\t");
-    dword = INREG(AUD_CNTL_ST_A);
-    dword &= ~BITMASK(20, 18);
-    dword &= ~BITMASK(3, 0);
-    OUTREG(AUD_CNTL_ST_A, dword);
-    for (i = 0; i < 8; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_INFOFR_A)));
-    printf("\n");
+    dump_infoframe(AUD_CNTL_ST_A, AUD_HDMIW_INFOFR_A);
 
     printf("AUD_HDMIW_INFOFR_B HDMI audio Infoframe:\n\t");
-    dword = INREG(AUD_CNTL_ST_B);
-    dword &= ~BITMASK(20, 18);
-    dword &= ~BITMASK(3, 0);
-    OUTREG(AUD_CNTL_ST_B, dword);
-    for (i = 0; i < 8; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_INFOFR_B)));
-    printf("\n");
+    dump_infoframe(AUD_CNTL_ST_B, AUD_HDMIW_INFOFR_B);
 
 }
 
@@ -1219,7 +1236,9 @@ static void dump_cpt(void)
     printf("AUD_OUT_DIG_CNVT_C  Stream_ID\t\t\t\t%lu\n",	BITS(dword, 23, 20));
 
     printf("AUD_OUT_CH_STR  Converter_Channel_MAP	PORTB	PORTC	PORTD\n");
-    for (i = 0; i < 8; i++) {
+    if (snapshot)
+	    printf("\t(not available in snapshot)\n");
+    for (i = 0; !snapshot && i < 8; i++) {
 	    OUTREG(AUD_OUT_CH_STR, i | (i << 8) | (i << 16));
 	    dword = INREG(AUD_OUT_CH_STR);
 	    printf("\t\t\t\t%lu\t%lu\t%lu\t%lu\n",
@@ -1318,55 +1337,22 @@ static void dump_cpt(void)
     printf("AUD_HDMIW_STATUS  Function_Reset\t\t\t%lu\n",		 BIT(dword, 24));
 
     printf("AUD_HDMIW_HDMIEDID_A HDMI ELD:\n\t");
-    dword = INREG(AUD_CNTL_ST_A);
-    dword &= ~BITMASK(9, 5);
-    OUTREG(AUD_CNTL_ST_A, dword);
-    for (i = 0; i < BITS(dword, 14, 10) / 4; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_HDMIEDID_A)));
-    printf("\n");
+    dump_eld(AUD_CNTL_ST_A, BITMASK(9, 5), AUD_HDMIW_HDMIEDID_A);
 
     printf("AUD_HDMIW_HDMIEDID_B HDMI ELD:\n\t");
-    dword = INREG(AUD_CNTL_ST_B);
-    dword &= ~BITMASK(9, 5);
-    OUTREG(AUD_CNTL_ST_B, dword);
-    for (i = 0; i < BITS(dword, 14, 10) / 4; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_HDMIEDID_B)));
-    printf("\n");
+    dump_eld(AUD_CNTL_ST_B, BITMASK(9, 5), AUD_HDMIW_HDMIEDID_B);
 
     printf("AUD_HDMIW_HDMIEDID_C HDMI ELD:\n\t");
-    dword = INREG(AUD_CNTL_ST_C);
-    dword &= ~BITMASK(9, 5);
-    OUTREG(AUD_CNTL_ST_C, dword);
-    for (i = 0; i < BITS(dword, 14, 10) / 4; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_HDMIEDID_C)));
-    printf("\n");
+    dump_eld(AUD_CNTL_ST_C, BITMASK(9, 5), AUD_HDMIW_HDMIEDID_C);
 
     printf("AUD_HDMIW_INFOFR_A HDMI audio Infoframe:\n\t");
-    dword = INREG(AUD_CNTL_ST_A);
-    dword &= ~BITMASK(20, 18);
-    dword &= ~BITMASK(3, 0);
-    OUTREG(AUD_CNTL_ST_A, dword);
-    for (i = 0; i < 8; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_INFOFR_A)));
-    printf("\n");
+    dump_infoframe(AUD_CNTL_ST_A, AUD_HDMIW_INFOFR_A);
 
     printf("AUD_HDMIW_INFOFR_B HDMI audio Infoframe:\n\t");
-    dword = INREG(AUD_CNTL_ST_B);
-    dword &= ~BITMASK(20, 18);
-    dword &= ~BITMASK(3, 0);
-    OUTREG(AUD_CNTL_ST_B, dword);
-    for (i = 0; i < 8; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_INFOFR_B)));
-    printf("\n");
+    dump_infoframe(AUD_CNTL_ST_B, AUD_HDMIW_INFOFR_B);
 
     printf("AUD_HDMIW_INFOFR_C HDMI audio Infoframe:\n\t");
-    dword = INREG(AUD_CNTL_ST_C);
-    dword &= ~BITMASK(20, 18);
-    dword &= ~BITMASK(3, 0);
-    OUTREG(AUD_CNTL_ST_C, dword);
-    for (i = 0; i < 8; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_INFOFR_C)));
-    printf("\n");
+    dump_infoframe(AUD_CNTL_ST_C, AUD_HDMIW_INFOFR_C);
 
 }
 
@@ -1827,7 +1813,9 @@ static void dump_hsw(void)
     printf("AUD_OUT_DIG_CNVT_C  Stream_ID\t\t\t\t%lu\n",	BITS(dword, 23, 20));
 
     printf("AUD_OUT_CHAN_MAP  Converter_Channel_MAP	PORTB	PORTC	PORTD\n");
-    for (i = 0; i < 8; i++) {
+    if (snapshot)
+	    printf("\t(not available in snapshot)\n");
+    for (i = 0; !snapshot && i < 8; i++) {
 	    OUTREG(AUD_OUT_CHAN_MAP, i | (i << 8) | (i << 16));
 	    dword = INREG(AUD_OUT_CHAN_MAP);
 	    printf("\t\t\t\t%lu\t%lu\t%lu\t%lu\n",
@@ -1882,80 +1870,38 @@ static void dump_hsw(void)
     printf("AUD_HDMIW_STATUS  Function_Reset\t\t\t%lu\n",		 BIT(dword, 24));
 
     printf("AUD_HDMIW_HDMIEDID_A HDMI ELD:\n\t");
-    dword = INREG(AUD_DIP_ELD_CTRL_ST_A);
-    dword &= ~BITMASK(9, 5);
-    OUTREG(AUD_DIP_ELD_CTRL_ST_A, dword);
-    for (i = 0; i < BITS(dword, 14, 10) / 4; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_HDMIEDID_A)));
-    printf("\n");
+    dump_eld(AUD_DIP_ELD_CTRL_ST_A, BITMASK(9, 5), AUD_HDMIW_HDMIEDID_A);
 
     printf("AUD_HDMIW_HDMIEDID_B HDMI ELD:\n\t");
-    dword = INREG(AUD_DIP_ELD_CTRL_ST_B);
-    dword &= ~BITMASK(9, 5);
-    OUTREG(AUD_DIP_ELD_CTRL_ST_B, dword);
-    for (i = 0; i < BITS(dword, 14, 10) / 4; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_HDMIEDID_B)));
-    printf("\n");
+    dump_eld(AUD_DIP_ELD_CTRL_ST_B, BITMASK(9, 5), AUD_HDMIW_HDMIEDID_B);
 
     printf("AUD_HDMIW_HDMIEDID_C HDMI ELD:\n\t");
-    dword = INREG(AUD_DIP_ELD_CTRL_ST_C);
-    dword &= ~BITMASK(9, 5);
-    OUTREG(AUD_DIP_ELD_CTRL_ST_C, dword);
-    for (i = 0; i < BITS(dword, 14, 10) / 4; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_HDMIEDID_C)));
-    printf("\n");
+    dump_eld(AUD_DIP_ELD_CTRL_ST_C, BITMASK(9, 5), AUD_HDMIW_HDMIEDID_C);
 
     printf("AUD_HDMIW_INFOFR_A HDMI audio Infoframe:\n\t");
-    dword = INREG(AUD_DIP_ELD_CTRL_ST_A);
-    dword &= ~BITMASK(20, 18);
-    dword &= ~BITMASK(3, 0);
-    OUTREG(AUD_DIP_ELD_CTRL_ST_A, dword);
-    for (i = 0; i < 8; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_INFOFR_A)));
-    printf("\n");
+    dump_infoframe(AUD_DIP_ELD_CTRL_ST_A, AUD_HDMIW_INFOFR_A);
 
     printf("AUD_HDMIW_INFOFR_B HDMI audio Infoframe:\n\t");
-    dword = INREG(AUD_DIP_ELD_CTRL_ST_B);
-    dword &= ~BITMASK(20, 18);
-    dword &= ~BITMASK(3, 0);
-    OUTREG(AUD_DIP_ELD_CTRL_ST_B, dword);
-    for (i = 0; i < 8; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_INFOFR_B)));
-    printf("\n");
+    dump_infoframe(AUD_DIP_ELD_CTRL_ST_B, AUD_HDMIW_INFOFR_B);
 
     printf("AUD_HDMIW_INFOFR_C HDMI audio Infoframe:\n\t");
-    dword = INREG(AUD_DIP_ELD_CTRL_ST_C);
-    dword &= ~BITMASK(20, 18);
-    dword &= ~BITMASK(3, 0);
-    OUTREG(AUD_DIP_ELD_CTRL_ST_C, dword);
-    for (i = 0; i < 8; i++)
-	    printf("%08x ", htonl(INREG(AUD_HDMIW_INFOFR_C)));
-    printf("\n");
+    dump_infoframe(AUD_DIP_ELD_CTRL_ST_C, AUD_HDMIW_INFOFR_C);
 }
 
-int main(int argc, char **argv)
+static void dump_audio(void)
 {
-	struct pci_device *pci_dev;
-
-	pci_dev = intel_get_pci_device();
-	devid = pci_dev->device_id; /* XXX not true when mapping! */
-
-	do_self_tests();
-
-	if (argc == 2)
-		intel_map_file(argv[1]);
-	else
-		intel_get_mmio(pci_dev);
-
 	if (IS_GEN6(devid) || IS_GEN7(devid) || getenv("HAS_PCH_SPLIT")) {
 		if (IS_HASWELL(devid)) {
 			printf("Haswell audio registers:\n\n");
 			dump_hsw();
-			return 0;
+			return;
 		}
 		printf("%s audio registers:\n\n",
 		       IS_GEN6(devid) ? "SandyBridge" : "IvyBridge");
-		intel_check_pch();
+		if (snapshot)
+			pch = intel_devid_to_pch(devid);
+		else
+			intel_check_pch();
 		dump_cpt();
 	} else if (IS_GEN5(devid)) {
 		printf("Ironlake audio registers:\n\n");
@@ -1964,6 +1910,66 @@ int main(int argc, char **argv)
 		printf("G45 audio registers:\n\n");
 		dump_eaglelake();
 	}
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [-D id] [snapshot...]\n"
+	       "Options:\n"
+	       "  -D id   device id (in hex) of the machine the snapshots were\n"
+	       "          taken on, defaults to the local device\n"
+	       "  -h      prints this help\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	struct pci_device *pci_dev;
+	int opt, i, ret = 0;
+
+	while ((opt = getopt(argc, argv, "D:h")) != -1) {
+		switch (opt) {
+		case 'D':
+			devid = strtol(optarg, NULL, 16);
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	do_self_tests();
+
+	if (optind == argc) {
+		pci_dev = intel_get_pci_device();
+		if (!devid)
+			devid = pci_dev->device_id;
+		intel_get_mmio(pci_dev);
+		dump_audio();
+		return 0;
+	}
+
+	if (!devid)
+		devid = intel_get_pci_device()->device_id;
+
+	/* Decode snapshots taken with intel_reg_snapshot, no hardware access */
+	snapshot = 1;
+	for (i = optind; i < argc; i++) {
+		if (argc - optind > 1)
+			printf("%s==> %s <==\n\n", i > optind ? "\n" : "", argv[i]);
+
+		if (intel_mmio_load_snapshot(argv[i])) {
+			fflush(stdout);
+			fprintf(stderr, "Couldn't load %s: %s\n",
+				argv[i], strerror(errno));
+			ret = 1;
+			continue;
+		}
+
+		dump_audio();
+	}
 
-	return 0;
+	return ret;
 }
@@ -25,6 +25,8 @@
  *
  */
 
+#define _GNU_SOURCE
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -34,6 +36,7 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 
 #include "intel_bios.h"
 #include "intel_gpu_tools.h"
@@ -74,53 +77,67 @@ static int tv_present;
 static int lvds_present;
 static int panel_type;
 
-static struct bdb_block *find_section(int section_id, int length)
+static size_t vbios_size;
+static int vbios_mapped;
+
+/* Indexed by section id, data is NULL for absent sections. */
+static struct bdb_block sections[256];
+static int num_sections;
+
+static char error_msg[256];
+
+/*
+ * Walk the BDB once, recording where each section lives.  A truncated
+ * section ends the walk and only the first copy of a duplicated id is kept,
+ * as with the linear search this replaces.
+ */
+static void index_sections(int length)
 {
-	struct bdb_block *block;
 	unsigned char *base = (unsigned char *)bdb;
 	int idx = 0;
-	uint16_t total, current_size;
+	int total, current_size;
 	unsigned char current_id;
 
+	memset(sections, 0, sizeof(sections));
+	num_sections = 0;
+
 	/* skip to first section */
 	idx += bdb->header_size;
 	total = bdb->bdb_size;
 	if (total > length)
 		total = length;
 
-	block = malloc(sizeof(*block));
-	if (!block) {
-		fprintf(stderr, "out of memory\n");
-		exit(-1);
-	}
-
-	/* walk the sections looking for section_id */
 	while (idx + 3 < total) {
 		current_id = *(base + idx);
 		current_size = *(uint16_t *)(base + idx + 1);
 		if (idx + current_size > total)
-			return NULL;
+			break;
 
-		if (current_id == section_id) {
-			block->id = current_id;
-			block->size = current_size;
-			block->data = base + idx + 3;
-			return block;
+		if (!sections[current_id].data) {
+			sections[current_id].id = current_id;
+			sections[current_id].size = current_size;
+			sections[current_id].data = base + idx + 3;
+			num_sections++;
 		}
 
 		idx += current_size + 3;
 	}
+}
 
-	free(block);
-	return NULL;
+static struct bdb_block *find_section(int section_id)
+{
+	if (!sections[section_id].data)
+		return NULL;
+
+	return &sections[section_id];
 }
 
-static void dump_general_features(int length)
+static void dump_general_features(void)
 {
 	struct bdb_general_features *features;
 	struct bdb_block *block;
 
-	block = find_section(BDB_GENERAL_FEATURES, length);
+	block = find_section(BDB_GENERAL_FEATURES);
 
 	if (!block)
 		return;
@@ -172,17 +189,15 @@ static void dump_general_features(int length)
 
 	tv_present = 1;		/* should be based on whether TV DAC exists */
 	lvds_present = 1;	/* should be based on IS_MOBILE() */
-
-	free(block);
 }
 
-static void dump_backlight_info(int length)
+static void dump_backlight_info(void)
 {
 	struct bdb_block *block;
 	struct bdb_lvds_backlight *backlight;
 	struct blc_struct *blc;
 
-	block = find_section(BDB_LVDS_BACKLIGHT, length);
+	block = find_section(BDB_LVDS_BACKLIGHT);
 
 	if (!block)
 		return;
@@ -345,7 +360,7 @@ static void dump_child_device(struct child_device_config *child)
 	}
 }
 
-static void dump_general_definitions(int length)
+static void dump_general_definitions(void)
 {
 	struct bdb_block *block;
 	struct bdb_general_definitions *defs;
@@ -353,7 +368,7 @@ static void dump_general_definitions(int length)
 	int i;
 	int child_device_num;
 
-	block = find_section(BDB_GENERAL_DEFINITIONS, length);
+	block = find_section(BDB_GENERAL_DEFINITIONS);
 
 	if (!block)
 		return;
@@ -374,17 +389,16 @@ static void dump_general_definitions(int length)
 	child_device_num = (block->size - sizeof(*defs)) / sizeof(*child);
 	for (i = 0; i < child_device_num; i++)
 		dump_child_device(&defs->devices[i]);
-	free(block);
 }
 
-static void dump_child_devices(int length)
+static void dump_child_devices(void)
 {
 	struct bdb_block *block;
 	struct bdb_child_devices *child_devs;
 	struct child_device_config *child;
 	int i;
 
-	block = find_section(BDB_CHILD_DEVICE_TABLE, length);
+	block = find_section(BDB_CHILD_DEVICE_TABLE);
 	if (!block) {
 		printf("No child device table found\n");
 		return;
@@ -408,16 +422,14 @@ static void dump_child_devices(int length)
 		printf("\t\tDVO config: 0x%02x\n", child->dvo_cfg);
 		printf("\t\tDVO wiring: 0x%02x\n", child->dvo_wiring);
 	}
-
-	free(block);
 }
 
-static void dump_lvds_options(int length)
+static void dump_lvds_options(void)
 {
 	struct bdb_block *block;
 	struct bdb_lvds_options *options;
 
-	block = find_section(BDB_LVDS_OPTIONS, length);
+	block = find_section(BDB_LVDS_OPTIONS);
 	if (!block) {
 		printf("No LVDS options block\n");
 		return;
@@ -437,11 +449,9 @@ static void dump_lvds_options(int length)
 	printf("\tPFIT enhanced text mode: %s\n",
 	       YESNO(options->pfit_text_mode_enhanced));
 	printf("\tPFIT mode: %d\n", options->pfit_mode);
-
-	free(block);
 }
 
-static void dump_lvds_ptr_data(int length)
+static void dump_lvds_ptr_data(void)
 {
 	struct bdb_block *block;
 	struct bdb_lvds_lfp_data *lvds_data;
@@ -450,14 +460,14 @@ static void dump_lvds_ptr_data(int length)
 	struct bdb_lvds_lfp_data_entry *entry;
 	int lfp_data_size;
 
-	block = find_section(BDB_LVDS_LFP_DATA_PTRS, length);
+	block = find_section(BDB_LVDS_LFP_DATA_PTRS);
 	if (!block) {
 		printf("No LFP data pointers block\n");
 		return;
 	}
 	ptrs = block->data;
 
-	block = find_section(BDB_LVDS_LFP_DATA, length);
+	block = find_section(BDB_LVDS_LFP_DATA);
 	if (!block) {
 		printf("No LVDS data block\n");
 		return;
@@ -476,11 +486,9 @@ static void dump_lvds_ptr_data(int length)
 
 	printf("\tpanel type %02i: %dx%d\n", panel_type, fp_timing->x_res,
 	       fp_timing->y_res);
-
-	free(block);
 }
 
-static void dump_lvds_data(int length)
+static void dump_lvds_data(void)
 {
 	struct bdb_block *block;
 	struct bdb_lvds_lfp_data *lvds_data;
@@ -492,7 +500,7 @@ static void dump_lvds_data(int length)
 	float clock;
 	int lfp_data_size, dvo_offset;
 
-	block = find_section(BDB_LVDS_LFP_DATA_PTRS, length);
+	block = find_section(BDB_LVDS_LFP_DATA_PTRS);
 	if (!block) {
 		printf("No LVDS ptr block\n");
 		return;
@@ -502,9 +510,8 @@ static void dump_lvds_data(int length)
 	    ptrs->ptr[1].fp_timing_offset - ptrs->ptr[0].fp_timing_offset;
 	dvo_offset =
 	    ptrs->ptr[0].dvo_timing_offset - ptrs->ptr[0].fp_timing_offset;
-	free(block);
 
-	block = find_section(BDB_LVDS_LFP_DATA, length);
+	block = find_section(BDB_LVDS_LFP_DATA);
 	if (!block) {
 		printf("No LVDS data block\n");
 		return;
@@ -560,15 +567,14 @@ static void dump_lvds_data(int length)
 		       (hsyncend > htotal || vsyncend > vtotal) ?
 		       "BAD!" : "good");
 	}
-	free(block);
 }
 
-static void dump_driver_feature(int length)
+static void dump_driver_feature(void)
 {
 	struct bdb_block *block;
 	struct bdb_driver_feature *feature;
 
-	block = find_section(BDB_DRIVER_FEATURES, length);
+	block = find_section(BDB_DRIVER_FEATURES);
 	if (!block) {
 		printf("No Driver feature data block\n");
 		return;
@@ -636,16 +642,15 @@ static void dump_driver_feature(int length)
 	printf("\tLegacy CRT max Y: %d\n", feature->legacy_crt_max_y);
 	printf("\tLegacy CRT max refresh: %d\n",
 	       feature->legacy_crt_max_refresh);
-	free(block);
 }
 
-static void dump_edp(int length)
+static void dump_edp(void)
 {
 	struct bdb_block *block;
 	struct bdb_edp *edp;
 	int bpp;
 
-	block = find_section(BDB_EDP, length);
+	block = find_section(BDB_EDP);
 	if (!block) {
 		printf("No EDP data block\n");
 		return;
@@ -723,7 +728,6 @@ static void dump_edp(int length)
 		printf("1.2V\n");
 		break;
 	}
-	free(block);
 }
 
 static void
@@ -755,13 +759,13 @@ print_detail_timing_data(struct lvds_dvo_timing2 *dvo_timing)
 	printf("\tclock: %d\n", dvo_timing->clock * 10);
 }
 
-static void dump_sdvo_panel_dtds(int length)
+static void dump_sdvo_panel_dtds(void)
 {
 	struct bdb_block *block;
 	struct lvds_dvo_timing2 *dvo_timing;
 	int n, count;
 
-	block = find_section(BDB_SDVO_PANEL_DTDS, length);
+	block = find_section(BDB_SDVO_PANEL_DTDS);
 	if (!block) {
 		printf("No SDVO panel dtds block\n");
 		return;
@@ -774,16 +778,14 @@ static void dump_sdvo_panel_dtds(int length)
 		printf("%d:\n", n);
 		print_detail_timing_data(dvo_timing++);
 	}
-
-	free(block);
 }
 
-static void dump_sdvo_lvds_options(int length)
+static void dump_sdvo_lvds_options(void)
 {
 	struct bdb_block *block;
 	struct bdb_sdvo_lvds_options *options;
 
-	block = find_section(BDB_SDVO_LVDS_OPTIONS, length);
+	block = find_section(BDB_SDVO_LVDS_OPTIONS);
 	if (!block) {
 		printf("No SDVO LVDS options block\n");
 		return;
@@ -807,15 +809,21 @@ static void dump_sdvo_lvds_options(int length)
 	printf("\tmisc[1]: %x\n", options->panel_misc_bits_2);
 	printf("\tmisc[2]: %x\n", options->panel_misc_bits_3);
 	printf("\tmisc[3]: %x\n", options->panel_misc_bits_4);
-
-	free(block);
 }
 
+
 static int
-get_device_id(unsigned char *bios)
+get_device_id(unsigned char *bios, size_t size)
 {
     int device;
-    int offset = (bios[0x19] << 8) + bios[0x18];
+    size_t offset;
+
+    if (size < 0x1a)
+	return -1;
+
+    offset = (bios[0x19] << 8) + bios[0x18];
+    if (offset + 8 > size)
+	return -1;
 
     if (bios[offset] != 'P' ||
 	bios[offset+1] != 'C' ||
@@ -828,37 +836,23 @@ get_device_id(unsigned char *bios)
     return device;
 }
 
-int main(int argc, char **argv)
+static int load_rom(const char *filename)
 {
-	int fd;
-	struct vbt_header *vbt = NULL;
-	int vbt_off, bdb_off, i;
-	const char *filename = "bios";
 	struct stat finfo;
-	struct bdb_block *block;
-	char signature[17];
-	char *devid_string;
-
-	if (argc != 2) {
-		printf("usage: %s <rom file>\n", argv[0]);
-		return 1;
-	}
-
-	if ((devid_string = getenv("DEVICE")))
-	    devid = strtoul(devid_string, NULL, 0);
-
-	filename = argv[1];
+	int fd;
 
 	fd = open(filename, O_RDONLY);
 	if (fd == -1) {
-		printf("Couldn't open \"%s\": %s\n", filename, strerror(errno));
-		return 1;
+		snprintf(error_msg, sizeof(error_msg),
+			 "Couldn't open \"%s\": %s", filename, strerror(errno));
+		return -1;
 	}
 
-	if (stat(filename, &finfo)) {
-		printf("failed to stat \"%s\": %s\n", filename,
-		       strerror(errno));
-		return 1;
+	if (fstat(fd, &finfo)) {
+		snprintf(error_msg, sizeof(error_msg),
+			 "failed to stat \"%s\": %s", filename, strerror(errno));
+		close(fd);
+		return -1;
 	}
 
 	if (finfo.st_size == 0) {
@@ -867,9 +861,12 @@ int main(int argc, char **argv)
 		VBIOS = malloc (finfo.st_size);
 		while ((ret = read(fd, VBIOS + len, finfo.st_size - len))) {
 			if (ret < 0) {
-				printf("failed to read \"%s\": %s\n", filename,
-				       strerror(errno));
-				return 1;
+				snprintf(error_msg, sizeof(error_msg),
+					 "failed to read \"%s\": %s",
+					 filename, strerror(errno));
+				free(VBIOS);
+				close(fd);
+				return -1;
 			}
 
 			len += ret;
@@ -878,37 +875,357 @@ int main(int argc, char **argv)
 				VBIOS = realloc(VBIOS, finfo.st_size);
 			}
 		}
+		vbios_size = len;
+		vbios_mapped = 0;
 	} else {
 		VBIOS = mmap(NULL, finfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
 		if (VBIOS == MAP_FAILED) {
-			printf("failed to map \"%s\": %s\n", filename, strerror(errno));
-			return 1;
+			snprintf(error_msg, sizeof(error_msg),
+				 "failed to map \"%s\": %s",
+				 filename, strerror(errno));
+			close(fd);
+			return -1;
 		}
+		vbios_size = finfo.st_size;
+		vbios_mapped = 1;
 	}
 
+	close(fd);
+	return 0;
+}
+
+static void unload_rom(void)
+{
+	if (vbios_mapped)
+		munmap(VBIOS, vbios_size);
+	else
+		free(VBIOS);
+	VBIOS = NULL;
+	bdb = NULL;
+}
+
+static struct vbt_header *find_vbt(void)
+{
+	struct vbt_header *vbt;
+
 	/* Scour memory looking for the VBT signature */
-	for (i = 0; i + 4 < finfo.st_size; i++) {
-		if (!memcmp(VBIOS + i, "$VBT", 4)) {
-			vbt_off = i;
-			vbt = (struct vbt_header *)(VBIOS + i);
+	vbt = memmem(VBIOS, vbios_size, "$VBT", 4);
+	if (!vbt || (uint8_t *)vbt + sizeof(*vbt) > VBIOS + vbios_size) {
+		snprintf(error_msg, sizeof(error_msg), "VBT signature missing");
+		return NULL;
+	}
+
+	return vbt;
+}
+
+static int open_bdb(struct vbt_header *vbt)
+{
+	size_t bdb_off;
+
+	bdb_off = (uint8_t *)vbt - VBIOS + vbt->bdb_offset;
+	if (bdb_off + sizeof(struct bdb_header) > vbios_size) {
+		snprintf(error_msg, sizeof(error_msg),
+			 "Invalid VBT found, BDB points beyond end of data block");
+		return -1;
+	}
+
+	bdb = (struct bdb_header *)(VBIOS + bdb_off);
+	index_sections(vbios_size - bdb_off);
+
+	return 0;
+}
+
+/*
+ * Batch mode: every ROM image in a directory is parsed by a pool of worker
+ * processes and reduced to one summary line.  The summaries live in a
+ * shared anonymous mapping so the workers need no other IPC, and a ROM
+ * that crashes its worker is reported as such instead of taking the rest
+ * of the corpus with it.
+ */
+enum rom_state {
+	ROM_PENDING,
+	ROM_CLAIMED,
+	ROM_DONE,
+};
+
+struct rom_summary {
+	int state;
+	int ok;
+	int vbt_version;
+	int bdb_version;
+	int devid;
+	int num_sections;
+	int num_children;
+	int panel_type;
+	char error[256];
+};
+
+struct rom_corpus {
+	int next;
+	int count;
+	struct rom_summary roms[0];
+};
+
+static void summarize_rom(const char *filename, struct rom_summary *rom)
+{
+	struct vbt_header *vbt;
+	struct bdb_block *block;
+
+	rom->devid = -1;
+	rom->vbt_version = -1;
+	rom->bdb_version = -1;
+	rom->num_children = -1;
+	rom->panel_type = -1;
+
+	if (load_rom(filename))
+		goto out;
+
+	rom->devid = devid != -1 ? (int)devid : get_device_id(VBIOS, vbios_size);
+
+	vbt = find_vbt();
+	if (!vbt)
+		goto out_unload;
+	rom->vbt_version = vbt->version;
+
+	if (open_bdb(vbt))
+		goto out_unload;
+	rom->bdb_version = bdb->version;
+	rom->num_sections = num_sections;
+
+	block = find_section(BDB_GENERAL_DEFINITIONS);
+	if (block && block->size >= sizeof(struct bdb_general_definitions)) {
+		struct bdb_general_definitions *defs = block->data;
+		int i, n;
+
+		n = (block->size - sizeof(*defs)) /
+			sizeof(struct child_device_config);
+		rom->num_children = 0;
+		for (i = 0; i < n; i++)
+			if (defs->devices[i].device_type)
+				rom->num_children++;
+	}
+
+	block = find_section(BDB_LVDS_OPTIONS);
+	if (block && block->size >= 1)
+		rom->panel_type = ((struct bdb_lvds_options *)block->data)->panel_type;
+
+	rom->ok = 1;
+
+out_unload:
+	unload_rom();
+out:
+	if (!rom->ok)
+		snprintf(rom->error, sizeof(rom->error), "%s", error_msg);
+}
+
+static void batch_worker(struct rom_corpus *corpus, char **files)
+{
+	int i;
+
+	while ((i = __sync_fetch_and_add(&corpus->next, 1)) < corpus->count) {
+		struct rom_summary *rom = &corpus->roms[i];
+
+		rom->state = ROM_CLAIMED;
+		summarize_rom(files[i], rom);
+		rom->state = ROM_DONE;
+	}
+
+	exit(0);
+}
+
+static void print_value(int value, int width)
+{
+	if (value < 0)
+		printf("%*s", width, "-");
+	else
+		printf("%*d", width, value);
+}
+
+static int batch(const char *dirname, int jobs)
+{
+	struct rom_corpus *corpus;
+	struct dirent **names;
+	char **files;
+	size_t size;
+	int count, num_files = 0, running = 0, failed = 0;
+	int i, name_width = 4;
+
+	count = scandir(dirname, &names, NULL, alphasort);
+	if (count < 0) {
+		printf("Couldn't open \"%s\": %s\n", dirname, strerror(errno));
+		return 1;
+	}
+
+	files = calloc(count, sizeof(*files));
+	for (i = 0; i < count; i++) {
+		struct stat st;
+		char *path;
+
+		if (asprintf(&path, "%s/%s", dirname, names[i]->d_name) < 0)
+			path = NULL;
+		if (path && stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+			files[num_files++] = path;
+			if ((int)strlen(names[i]->d_name) > name_width)
+				name_width = strlen(names[i]->d_name);
+		} else {
+			free(path);
+		}
+		free(names[i]);
+	}
+	free(names);
+
+	size = sizeof(*corpus) + num_files * sizeof(corpus->roms[0]);
+	corpus = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (corpus == MAP_FAILED) {
+		printf("failed to allocate summary table: %s\n",
+		       strerror(errno));
+		return 1;
+	}
+	corpus->count = num_files;
+
+	if (jobs > num_files)
+		jobs = num_files;
+
+	fflush(stdout);
+	for (;;) {
+		int status;
+
+		/* Keep the pool full, replacing workers lost to a bad ROM. */
+		while (running < jobs && corpus->next < corpus->count) {
+			pid_t pid = fork();
+
+			if (pid == 0)
+				batch_worker(corpus, files);
+			if (pid < 0)
+				break;
+			running++;
+		}
+
+		if (!running || wait(&status) < 0)
+			break;
+		running--;
+	}
+
+	printf("%-*s %5s %4s %6s %8s %8s %5s  %s\n", name_width,
+	       "file", "VBT", "BDB", "devid", "sections", "children", "panel",
+	       "status");
+	for (i = 0; i < num_files; i++) {
+		struct rom_summary *rom = &corpus->roms[i];
+		const char *name = strrchr(files[i], '/') + 1;
+
+		printf("%-*s ", name_width, name);
+		if (rom->vbt_version < 0)
+			printf("%5s", "-");
+		else
+			printf("%2d.%02d", rom->vbt_version / 100,
+			       rom->vbt_version % 100);
+		putchar(' ');
+		print_value(rom->bdb_version, 4);
+		putchar(' ');
+		if (rom->devid < 0)
+			printf("%6s", "-");
+		else
+			printf("0x%04x", rom->devid);
+		putchar(' ');
+		print_value(rom->ok ? rom->num_sections : -1, 8);
+		putchar(' ');
+		print_value(rom->num_children, 8);
+		putchar(' ');
+		print_value(rom->panel_type, 5);
+
+		if (rom->state != ROM_DONE) {
+			printf("  crashed\n");
+			failed++;
+		} else if (!rom->ok) {
+			printf("  %s\n", rom->error);
+			failed++;
+		} else {
+			printf("  ok\n");
+		}
+
+		free(files[i]);
+	}
+	free(files);
+
+	printf("%d ROMs, %d failed\n", num_files, failed);
+
+	munmap(corpus, size);
+	return failed != 0;
+}
+
+static void usage(const char *name)
+{
+	printf("usage: %s <rom file>\n"
+	       "       %s [-j <jobs>] -b <directory>\n", name, name);
+}
+
+int main(int argc, char **argv)
+{
+	struct vbt_header *vbt;
+	const char *filename = "bios";
+	const char *batch_dir = NULL;
+	int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	char signature[17];
+	char *devid_string;
+	int i, c;
+
+	while ((c = getopt(argc, argv, "b:j:h")) != -1) {
+		switch (c) {
+		case 'b':
+			batch_dir = optarg;
+			break;
+		case 'j':
+			jobs = atoi(optarg);
 			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if ((devid_string = getenv("DEVICE")))
+	    devid = strtoul(devid_string, NULL, 0);
+
+	if (jobs < 1)
+		jobs = 1;
+
+	if (batch_dir) {
+		if (optind != argc) {
+			usage(argv[0]);
+			return 1;
 		}
+		return batch(batch_dir, jobs);
 	}
 
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	filename = argv[optind];
+
+	if (load_rom(filename)) {
+		printf("%s\n", error_msg);
+		return 1;
+	}
+
+	vbt = find_vbt();
 	if (!vbt) {
-		printf("VBT signature missing\n");
+		printf("%s\n", error_msg);
 		return 1;
 	}
 
 	printf("VBT vers: %d.%d\n", vbt->version / 100, vbt->version % 100);
 
-	bdb_off = vbt_off + vbt->bdb_offset;
-	if (bdb_off >= finfo.st_size - sizeof(struct bdb_header)) {
-		printf("Invalid VBT found, BDB points beyond end of data block\n");
+	if (open_bdb(vbt)) {
+		printf("%s\n", error_msg);
 		return 1;
 	}
 
-	bdb = (struct bdb_header *)(VBIOS + bdb_off);
 	strncpy(signature, (char *)bdb->signature, 16);
 	signature[16] = 0;
 	printf("BDB sig: %s\n", signature);
@@ -916,32 +1233,29 @@ int main(int argc, char **argv)
 
 	printf("Available sections: ");
 	for (i = 0; i < 256; i++) {
-		block = find_section(i, finfo.st_size);
-		if (!block)
-			continue;
-		printf("%d ", i);
-		free(block);
+		if (sections[i].data)
+			printf("%d ", i);
 	}
 	printf("\n");
 
 	if (devid == -1)
-	    devid = get_device_id(VBIOS);
+	    devid = get_device_id(VBIOS, vbios_size);
 	if (devid == -1)
 	    printf("Warning: could not find PCI device ID!\n");
 
-	dump_general_features(finfo.st_size);
-	dump_general_definitions(finfo.st_size);
-	dump_child_devices(finfo.st_size);
-	dump_lvds_options(finfo.st_size);
-	dump_lvds_data(finfo.st_size);
-	dump_lvds_ptr_data(finfo.st_size);
-	dump_backlight_info(finfo.st_size);
+	dump_general_features();
+	dump_general_definitions();
+	dump_child_devices();
+	dump_lvds_options();
+	dump_lvds_data();
+	dump_lvds_ptr_data();
+	dump_backlight_info();
 
-	dump_sdvo_lvds_options(finfo.st_size);
-	dump_sdvo_panel_dtds(finfo.st_size);
+	dump_sdvo_lvds_options();
+	dump_sdvo_panel_dtds();
 
-	dump_driver_feature(finfo.st_size);
-	dump_edp(finfo.st_size);
+	dump_driver_feature();
+	dump_edp();
 
 	return 0;
 }
@@ -37,7 +37,105 @@
 
 #include <intel_bufmgr.h>
 
+#include "intel_batch_capture.h"
+
 struct drm_intel_decode *ctx;
+static int devid_override;
+
+static const char *
+ring_name(uint32_t ring)
+{
+	static const char *names[] = {
+		"default", "render", "bsd", "blt", "vebox"
+	};
+
+	ring &= 7;
+	return ring < sizeof(names) / sizeof(names[0]) ? names[ring] : "unknown";
+}
+
+static int
+is_capture_file(const char *filename)
+{
+	uint32_t magic = 0;
+	FILE *file;
+
+	file = fopen(filename, "r");
+	if (file == NULL)
+		return 0;
+	if (fread(&magic, sizeof(magic), 1, file) != 1)
+		magic = 0;
+	fclose(file);
+
+	return magic == INTEL_CAPTURE_MAGIC;
+}
+
+static void
+read_capture_file(const char *filename)
+{
+	struct intel_capture_header header;
+	struct intel_capture_batch batch;
+	struct intel_capture_reloc *relocs = NULL;
+	uint32_t *data = NULL;
+	FILE *file;
+	uint32_t i;
+
+	file = fopen(filename, "r");
+	if (file == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n",
+			filename, strerror(errno));
+		exit(1);
+	}
+
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+	    header.version != INTEL_CAPTURE_VERSION) {
+		fprintf(stderr, "%s: unsupported capture version\n", filename);
+		exit(1);
+	}
+
+	/* Decode for the device the batches were captured on. */
+	if (!devid_override) {
+		drm_intel_decode_context_free(ctx);
+		ctx = drm_intel_decode_context_alloc(header.devid);
+	}
+
+	while (fread(&batch, sizeof(batch), 1, file) == 1) {
+		relocs = realloc(relocs, (batch.num_relocs + 1) * sizeof(*relocs));
+		data = realloc(data, batch.size + 4);
+		if (relocs == NULL || data == NULL) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(1);
+		}
+
+		if (fread(relocs, sizeof(*relocs), batch.num_relocs, file) != batch.num_relocs ||
+		    fread(data, 1, batch.size, file) != batch.size) {
+			fprintf(stderr, "%s: truncated capture\n", filename);
+			break;
+		}
+
+		printf("batch %llu: ring %s, context %u, %u bytes at 0x%08llx, %u relocations\n",
+		       (unsigned long long)batch.seqno, ring_name(batch.ring),
+		       batch.context, batch.batch_len,
+		       (unsigned long long)batch.gtt_offset, batch.num_relocs);
+		for (i = 0; i < batch.num_relocs; i++)
+			printf("    0x%08x: handle %u (%llu bytes) at 0x%08llx + 0x%x, read 0x%x write 0x%x%s\n",
+			       relocs[i].offset, relocs[i].target_handle,
+			       (unsigned long long)relocs[i].target_size,
+			       (unsigned long long)relocs[i].target_offset,
+			       relocs[i].delta,
+			       relocs[i].read_domains, relocs[i].write_domain,
+			       relocs[i].flags & INTEL_CAPTURE_RELOC_FENCED ?
+			       ", fenced" : "");
+
+		drm_intel_decode_set_batch_pointer(ctx, data, batch.gtt_offset,
+						   batch.batch_len / 4);
+		drm_intel_decode(ctx);
+		printf("\n");
+	}
+
+	free(relocs);
+	free(data);
+	fclose(file);
+}
 
 static void
 read_bin_file(const char * filename)
@@ -173,6 +271,7 @@ main (int argc, char *argv[])
 		switch(c) {
 		case 'd':
 			devid = strtoul(optarg, NULL, 0);
+			devid_override = 1;
 			break;
 		case 'b':
 			binary = 1;
@@ -199,7 +298,9 @@ main (int argc, char *argv[])
 			read_data_file(argv[i]);
 			continue;
 		}
-		if (binary == 1)
+		if (is_capture_file(argv[i]))
+			read_capture_file(argv[i]);
+		else if (binary == 1)
 			read_bin_file(argv[i]);
 		else if (binary == 0)
 			read_data_file(argv[i]);
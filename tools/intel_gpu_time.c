@@ -30,6 +30,7 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <sys/wait.h>
@@ -37,9 +38,27 @@
 #include "intel_gpu_tools.h"
 
 #define SAMPLES_PER_SEC             10000
+#define CPU_SAMPLES_PER_SEC         100
 
 static volatile int goddo;
 
+struct ring {
+	const char *name;
+	uint32_t mmio;
+	int present;
+
+	uint64_t idle;
+	int busy;
+	uint64_t run_start;
+};
+
+static struct ring rings[] = {
+	{ .name = "render", .mmio = 0x2030 },
+	{ .name = "bitstream", .mmio = 0x4030 },
+	{ .name = "bitstream", .mmio = 0x12030 },
+	{ .name = "blitter", .mmio = 0x22030 },
+};
+
 static pid_t spawn(char **argv)
 {
 	pid_t pid;
@@ -57,54 +76,205 @@ static void sighandler(int sig)
 	goddo = sig;
 }
 
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static int ring_sample(struct ring *ring)
+{
+	uint32_t head, tail;
+
+	head = INREG(ring->mmio + RING_HEAD) & HEAD_ADDR;
+	tail = INREG(ring->mmio + RING_TAIL) & TAIL_ADDR;
+
+	return head != tail;
+}
+
+static void ring_run_end(struct ring *ring, uint64_t t, FILE *timeline)
+{
+	if (timeline)
+		fprintf(timeline, "ring\t%s\t%s\t%llu\t%llu\n",
+			ring->name, ring->busy ? "busy" : "idle",
+			(unsigned long long)ring->run_start,
+			(unsigned long long)t);
+	ring->run_start = t;
+}
+
+/* Returns the child's user+sys time in seconds, or a negative value if
+ * unavailable.  The process CPU clock has ns resolution, /proc/<pid>/stat
+ * is only the fallback as it counts in clock ticks. */
+static double child_cpu_time(pid_t child)
+{
+	unsigned long utime, stime;
+	struct timespec ts;
+	clockid_t clock;
+	char path[64];
+	FILE *file;
+
+	if (clock_getcpuclockid(child, &clock) == 0 &&
+	    clock_gettime(clock, &ts) == 0)
+		return ts.tv_sec + 1e-9 * ts.tv_nsec;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", child);
+	file = fopen(path, "r");
+	if (!file)
+		return -1;
+
+	if (fscanf(file, "%*d %*s %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+		   &utime, &stime) != 2) {
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+
+	return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-t <timeline file>] cmd [args...]\n"
+		"\n"
+		"  -t <file>  write the busy/idle intervals of every ring and the\n"
+		"             CPU usage of cmd over time to file\n",
+		prog);
+}
+
 int main(int argc, char **argv)
 {
+	struct pci_device *pci_dev;
+	uint32_t devid;
 	pid_t child;
-	uint64_t ring_idle = 0, ring_time = 0;
+	uint64_t ring_time = 0, any_busy = 0, overlap = 0;
+	uint64_t t0, t, next_cpu, last_cpu_t = 0;
+	double last_cpu = -1;
 	struct timeval start, end;
 	static struct rusage rusage;
-	int status;
+	FILE *timeline = NULL;
+	unsigned int i;
+	int status, opt;
 
-	intel_get_mmio(intel_get_pci_device());
+	while ((opt = getopt(argc, argv, "+t:h")) != -1) {
+		switch (opt) {
+		case 't':
+			timeline = fopen(optarg, "w");
+			if (!timeline) {
+				perror("fopen");
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
 
-	if (argc == 1) {
-		fprintf(stderr, "usage: %s cmd [args...]\n", argv[0]);
+	if (optind == argc) {
+		usage(argv[0]);
 		return 1;
 	}
 
+	pci_dev = intel_get_pci_device();
+	devid = pci_dev->device_id;
+	intel_get_mmio(pci_dev);
+
+	rings[0].present = 1;
+	if (IS_GEN4(devid) || IS_GEN5(devid))
+		rings[1].present = 1;
+	if (IS_GEN6(devid) || IS_GEN7(devid)) {
+		rings[2].present = 1;
+		rings[3].present = 1;
+	}
+
 	signal(SIGCHLD, sighandler);
 	signal(SIGINT, SIG_IGN);
 	signal(SIGQUIT, SIG_IGN);
 
 	gettimeofday(&start, NULL);
-	child = spawn(argv+1);
+	t0 = now_us();
+	next_cpu = 0;
+	child = spawn(argv + optind);
 	if (child < 0)
 		return 127;
 
+	if (timeline)
+		fprintf(timeline, "# %s\n"
+			"# ring\t<name>\t<busy|idle>\t<start us>\t<end us>\n"
+			"# cpu\t<us>\t<percent of one cpu>\n",
+			argv[optind]);
+
 	while (!goddo) {
-		uint32_t ring_head, ring_tail;
+		int nbusy = 0;
+
+		t = now_us() - t0;
+		for (i = 0; i < ARRAY_SIZE(rings); i++) {
+			struct ring *ring = &rings[i];
+			int busy;
 
-		ring_head = INREG(LP_RING + RING_HEAD) & HEAD_ADDR;
-		ring_tail = INREG(LP_RING + RING_TAIL) & TAIL_ADDR;
+			if (!ring->present)
+				continue;
 
-		if (ring_tail == ring_head)
-			ring_idle++;
+			busy = ring_sample(ring);
+			if (busy != ring->busy) {
+				ring_run_end(ring, t, timeline);
+				ring->busy = busy;
+			}
+
+			if (busy)
+				nbusy++;
+			else
+				ring->idle++;
+		}
+		if (nbusy)
+			any_busy++;
+		if (nbusy > 1)
+			overlap++;
 		ring_time++;
 
+		if (timeline && t >= next_cpu) {
+			double cpu = child_cpu_time(child);
+
+			if (cpu >= 0 && last_cpu >= 0 && t > last_cpu_t)
+				fprintf(timeline, "cpu\t%llu\t%.1f\n",
+					(unsigned long long)t,
+					100. * (cpu - last_cpu) /
+					(1e-6 * (t - last_cpu_t)));
+			last_cpu = cpu;
+			last_cpu_t = t;
+			next_cpu = t + 1000000 / CPU_SAMPLES_PER_SEC;
+		}
+
 		usleep(1000000 / SAMPLES_PER_SEC);
 	}
 	gettimeofday(&end, NULL);
 	timersub(&end, &start, &end);
 
+	t = now_us() - t0;
+	for (i = 0; i < ARRAY_SIZE(rings); i++)
+		if (rings[i].present)
+			ring_run_end(&rings[i], t, timeline);
+	if (timeline)
+		fclose(timeline);
+
 	waitpid(child, &status, 0);
 
 	getrusage(RUSAGE_CHILDREN, &rusage);
-	printf("user: %ld.%06lds, sys: %ld.%06lds, elapsed: %ld.%06lds, CPU: %.1f%%, GPU: %.1f%%\n",
+	printf("user: %ld.%06lds, sys: %ld.%06lds, elapsed: %ld.%06lds, CPU: %.1f%%, GPU: %.1f%%",
 	       rusage.ru_utime.tv_sec, rusage.ru_utime.tv_usec,
 	       rusage.ru_stime.tv_sec, rusage.ru_stime.tv_usec,
 	       end.tv_sec, end.tv_usec,
 	       100*(rusage.ru_utime.tv_sec + 1e-6*rusage.ru_utime.tv_usec + rusage.ru_stime.tv_sec + 1e-6*rusage.ru_stime.tv_usec) / (end.tv_sec + 1e-6*end.tv_usec),
-	       100 - ring_idle * 100. / ring_time);
+	       100 - rings[0].idle * 100. / ring_time);
+	for (i = 1; i < ARRAY_SIZE(rings); i++)
+		if (rings[i].present)
+			printf(", %s: %.1f%%",
+			       rings[i].name, 100 - rings[i].idle * 100. / ring_time);
+	printf(", overlap: %.1f%%\n",
+	       any_busy ? overlap * 100. / any_busy : 0.);
 
 	return WEXITSTATUS(status);
 }
@@ -33,20 +33,27 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <err.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
 #include <sys/wait.h>
 #include <string.h>
+#include <strings.h>
+#include <math.h>
 #ifdef HAVE_TERMIOS_H
 #include <termios.h>
 #endif
 #include "intel_gpu_tools.h"
 #include "instdone.h"
+#include "intel_gpu_top_log.h"
+#include "intel_gpu_top_metrics.h"
 
 #define  FORCEWAKE	    0xA18C
 #define  FORCEWAKE_ACK	    0x130090
 
 #define SAMPLES_PER_SEC             10000
+#define SYSFS_PATH                  "/sys/class/drm/card0"
 #define SAMPLES_TO_PERCENT_RATIO    (SAMPLES_PER_SEC / 100)
 
 #define MAX_NUM_TOP_BITS            100
@@ -59,7 +66,22 @@ struct top_bit {
 } top_bits[MAX_NUM_TOP_BITS];
 struct top_bit *top_bits_sorted[MAX_NUM_TOP_BITS];
 
-static uint32_t instdone, instdone1;
+/*
+ * Per-bit busy counters for one INSTDONE word, stored bit-sliced: plane[k]
+ * holds bit k of the 32 vertical counters, so a sample is accumulated with
+ * a ripple-carry add of the busy mask across the planes instead of testing
+ * each instdone bit individually.  The planes are folded into the plain
+ * per-bit totals once per refresh, or before they can overflow.
+ */
+#define INSTDONE_PLANES             16
+
+struct instdone_counter {
+	uint32_t plane[INSTDONE_PLANES];
+	unsigned int samples;
+	int total[32];
+};
+
+static struct instdone_counter instdone_counter, instdone1_counter;
 
 static const char *bars[] = {
 	" ",
@@ -137,18 +159,56 @@ top_bits_sort(const void *a, const void *b)
 		return -1;
 }
 
+static void
+instdone_counter_flush(struct instdone_counter *counter)
+{
+	int i, k;
+
+	for (i = 0; i < 32; i++) {
+		int count = 0;
+
+		for (k = 0; k < INSTDONE_PLANES; k++)
+			count |= ((counter->plane[k] >> i) & 1) << k;
+		counter->total[i] += count;
+	}
+
+	memset(counter->plane, 0, sizeof(counter->plane));
+	counter->samples = 0;
+}
+
+static inline void
+instdone_counter_add(struct instdone_counter *counter, uint32_t reg_val)
+{
+	uint32_t carry = ~reg_val;
+	int k;
+
+	for (k = 0; carry && k < INSTDONE_PLANES; k++) {
+		uint32_t next = counter->plane[k] & carry;
+		counter->plane[k] ^= carry;
+		carry = next;
+	}
+
+	if (++counter->samples == (1 << INSTDONE_PLANES) - 1)
+		instdone_counter_flush(counter);
+}
+
+static void
+instdone_counter_reset(struct instdone_counter *counter)
+{
+	memset(counter, 0, sizeof(*counter));
+}
+
 static void
 update_idle_bit(struct top_bit *top_bit)
 {
-	uint32_t reg_val;
+	struct instdone_counter *counter;
 
 	if (top_bit->bit->reg == INST_DONE_1)
-		reg_val = instdone1;
+		counter = &instdone1_counter;
 	else
-		reg_val = instdone;
+		counter = &instdone_counter;
 
-	if ((reg_val & top_bit->bit->bit) == 0)
-		top_bit->count++;
+	top_bit->count = counter->total[ffs(top_bit->bit->bit) - 1];
 }
 
 static void
@@ -306,12 +366,54 @@ print_percentage_bar(float percent, int cur_line_len)
 	printf("%*s", PERCENTAGE_BAR_END - cur_line_len, "");
 }
 
+/*
+ * Log2-bucketed histogram: bucket 0 counts zeroes and bucket n counts
+ * values in [2^(n-1), 2^n), so adding a sample is a single clz.
+ */
+#define HIST_BUCKETS                33
+
+struct histogram {
+	uint32_t bucket[HIST_BUCKETS];
+	uint32_t count;
+};
+
+static inline void
+hist_add(struct histogram *hist, uint32_t value)
+{
+	hist->bucket[value ? 32 - __builtin_clz(value) : 0]++;
+	hist->count++;
+}
+
+/* Returns the upper bound of the bucket holding the p-th percentile. */
+static uint32_t
+hist_percentile(const struct histogram *hist, int p)
+{
+	uint32_t target = ((uint64_t)hist->count * p + 99) / 100;
+	uint32_t sum = 0;
+	int i;
+
+	if (!hist->count)
+		return 0;
+
+	for (i = 0; i < HIST_BUCKETS - 1; i++) {
+		sum += hist->bucket[i];
+		if (sum >= target)
+			break;
+	}
+
+	return i ? (uint32_t)((1ull << i) - 1) : 0;
+}
+
 struct ring {
 	const char *name;
 	uint32_t mmio;
 	int head, tail, size;
 	uint64_t full;
 	int idle;
+
+	/* occupancy and busy/idle run lengths (in samples) */
+	struct histogram fill, busy_runs, idle_runs;
+	int run_busy, run_len;
 };
 
 static uint32_t ring_read(struct ring *ring, uint32_t reg)
@@ -327,6 +429,9 @@ static void ring_init(struct ring *ring)
 static void ring_reset(struct ring *ring)
 {
 	ring->idle = ring->full = 0;
+	memset(&ring->fill, 0, sizeof(ring->fill));
+	memset(&ring->busy_runs, 0, sizeof(ring->busy_runs));
+	memset(&ring->idle_runs, 0, sizeof(ring->idle_runs));
 }
 
 static void ring_sample(struct ring *ring)
@@ -346,15 +451,44 @@ static void ring_sample(struct ring *ring)
 	if (full < 0)
 		full += ring->size;
 	ring->full += full;
+	hist_add(&ring->fill, full);
+
+	/* A run is accounted when it ends, or by ring_flush_runs() for the
+	 * part of it that fell into this refresh. */
+	if (!!full != ring->run_busy) {
+		if (ring->run_len)
+			hist_add(ring->run_busy ? &ring->busy_runs : &ring->idle_runs,
+				 ring->run_len);
+		ring->run_busy = !!full;
+		ring->run_len = 0;
+	}
+	ring->run_len++;
+}
+
+/* Accounts the elapsed part of the run in progress at the end of a
+ * refresh, so that a ring busy throughout still shows up. */
+static void ring_flush_runs(struct ring *ring)
+{
+	if (ring->run_len)
+		hist_add(ring->run_busy ? &ring->busy_runs : &ring->idle_runs,
+			 ring->run_len);
+	ring->run_len = 0;
 }
 
 static void ring_print_header(FILE *out, struct ring *ring)
 {
-    fprintf(out, "%.6s%%\tops\t",
+    fprintf(out, "%.6s%%\tops\tfill50\tfill95\tfill99\t"
+            "busy50\tbusy95\tbusy99\tidle50\tidle95\tidle99\t",
             ring->name
           );
 }
 
+/* Converts a run length in samples to usecs. */
+static unsigned long run_usecs(uint32_t samples, unsigned long samples_per_sec)
+{
+	return (uint64_t)samples * 1000000 / samples_per_sec;
+}
+
 static void ring_print(struct ring *ring, unsigned long samples_per_sec)
 {
 	int percent_busy, len;
@@ -370,17 +504,409 @@ static void ring_print(struct ring *ring, unsigned long samples_per_sec)
 		   ring->name,
 		   (int)(ring->full / samples_per_sec),
 		   ring->size);
+	printf("%25s fill p50/95/99: %u/%u/%u  "
+	       "runs p50/95/99 (us) busy: %lu/%lu/%lu idle: %lu/%lu/%lu\n",
+	       "",
+	       hist_percentile(&ring->fill, 50),
+	       hist_percentile(&ring->fill, 95),
+	       hist_percentile(&ring->fill, 99),
+	       run_usecs(hist_percentile(&ring->busy_runs, 50), samples_per_sec),
+	       run_usecs(hist_percentile(&ring->busy_runs, 95), samples_per_sec),
+	       run_usecs(hist_percentile(&ring->busy_runs, 99), samples_per_sec),
+	       run_usecs(hist_percentile(&ring->idle_runs, 50), samples_per_sec),
+	       run_usecs(hist_percentile(&ring->idle_runs, 95), samples_per_sec),
+	       run_usecs(hist_percentile(&ring->idle_runs, 99), samples_per_sec));
 }
 
 static void ring_log(struct ring *ring, unsigned long samples_per_sec,
 		FILE *output)
 {
 	if (ring->size)
-		fprintf(output, "%3d\t%d\t",
+		fprintf(output, "%3d\t%d\t%u\t%u\t%u\t"
+			"%lu\t%lu\t%lu\t%lu\t%lu\t%lu\t",
 			(int)(100 - 100 * ring->idle / samples_per_sec),
-			(int)(ring->full / samples_per_sec));
+			(int)(ring->full / samples_per_sec),
+			hist_percentile(&ring->fill, 50),
+			hist_percentile(&ring->fill, 95),
+			hist_percentile(&ring->fill, 99),
+			run_usecs(hist_percentile(&ring->busy_runs, 50), samples_per_sec),
+			run_usecs(hist_percentile(&ring->busy_runs, 95), samples_per_sec),
+			run_usecs(hist_percentile(&ring->busy_runs, 99), samples_per_sec),
+			run_usecs(hist_percentile(&ring->idle_runs, 50), samples_per_sec),
+			run_usecs(hist_percentile(&ring->idle_runs, 95), samples_per_sec),
+			run_usecs(hist_percentile(&ring->idle_runs, 99), samples_per_sec));
 	else
-		fprintf(output, "-1\t-1\t");
+		fprintf(output, "-1\t-1\t-1\t-1\t-1\t-1\t-1\t-1\t-1\t-1\t-1\t");
+}
+
+static void
+log_header(FILE *log, uint32_t devid, int samples_per_sec,
+	   struct ring **rings)
+{
+	struct gpu_top_log_header header;
+	int i;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = GPU_TOP_LOG_MAGIC;
+	header.version = GPU_TOP_LOG_VERSION;
+	header.devid = devid;
+	header.samples_per_sec = samples_per_sec;
+	for (i = 0; i < GPU_TOP_LOG_RINGS; i++) {
+		header.ring_size[i] = rings[i]->size;
+		strncpy(header.ring_name[i], rings[i]->name,
+			sizeof(header.ring_name[i]) - 1);
+	}
+
+	fwrite(&header, sizeof(header), 1, log);
+}
+
+static void
+log_sample(FILE *log, unsigned long long timestamp,
+	   uint32_t instdone, uint32_t instdone1, struct ring **rings)
+{
+	struct gpu_top_log_sample sample;
+	int i;
+
+	sample.type = GPU_TOP_LOG_RECORD_SAMPLE;
+	sample.timestamp = timestamp;
+	sample.instdone[0] = instdone;
+	sample.instdone[1] = instdone1;
+	for (i = 0; i < GPU_TOP_LOG_RINGS; i++) {
+		sample.head[i] = rings[i]->head;
+		sample.tail[i] = rings[i]->tail;
+	}
+
+	fwrite(&sample, sizeof(sample), 1, log);
+}
+
+static void
+log_stats(FILE *log, unsigned long long timestamp, const uint64_t *values)
+{
+	struct gpu_top_log_stats record;
+
+	record.type = GPU_TOP_LOG_RECORD_STATS;
+	record.timestamp = timestamp;
+	memcpy(record.stats, values, sizeof(record.stats));
+
+	fwrite(&record, sizeof(record), 1, log);
+}
+
+/*
+ * GT frequency and RC6 residency.  The current frequency is read from
+ * gt_cur_freq_mhz, or from RPSTAT1 if the sysfs file is missing, a hundred
+ * times a second, and every sample in between is accounted to that
+ * frequency.  The RC6 residency counters only need reading once per refresh.
+ */
+#define FREQ_SAMPLES_PER_SEC        100
+#define FREQ_BINS                   64
+
+static const char *rc6_files[] = {
+	"power/rc6_residency_ms",
+	"power/rc6p_residency_ms",
+	"power/rc6pp_residency_ms",
+};
+
+struct gt_power {
+	uint32_t devid;
+	int freq_fd;				/* < 0 once it failed for good */
+	int rc6_fd[ARRAY_SIZE(rc6_files)];
+	uint64_t rc6_value[ARRAY_SIZE(rc6_files)];	/* last read of each */
+	uint64_t rc6_ms, last_rc6_ms;
+	unsigned long long rc6_time, last_rc6_time;
+
+	int cur_freq;				/* < 0 if the last read failed */
+	uint32_t freq_failed;			/* samples without a freq */
+	uint32_t freq_samples[FREQ_BINS];	/* samples spent at each freq */
+	uint32_t freq_busy[FREQ_BINS];		/* ... with the render ring busy */
+
+	/* busy% against frequency over each freq sampling period */
+	int period_samples, period_idle;
+	double sx, sy, sxx, syy, sxy;
+	int n;
+};
+
+static int sysfs_open(const char *sysfs, const char *file)
+{
+	char path[1024];
+
+	snprintf(path, sizeof(path), "%s/%s", sysfs, file);
+	return open(path, O_RDONLY);
+}
+
+/*
+ * A sysfs file that can't be read won't start working later, so anything
+ * but an interrupted read closes it and sets *fd to -1, and the samplers
+ * stop trying it.
+ */
+static int sysfs_read(int *fd, uint64_t *value)
+{
+	char buf[32];
+	int len;
+
+	if (*fd < 0)
+		return -1;
+
+	len = pread(*fd, buf, sizeof(buf) - 1, 0);
+	if (len <= 0) {
+		if (len == 0 || (errno != EINTR && errno != EAGAIN)) {
+			close(*fd);
+			*fd = -1;
+		}
+		return -1;
+	}
+	buf[len] = '\0';
+
+	*value = strtoull(buf, NULL, 0);
+	return 0;
+}
+
+static int gt_power_read_freq(struct gt_power *power)
+{
+	uint64_t value;
+	uint32_t rpstat;
+
+	if (power->freq_fd >= 0) {
+		if (sysfs_read(&power->freq_fd, &value) == 0)
+			return value;
+		if (power->freq_fd >= 0)
+			return -1;
+		/* gone for good, RPSTAT1 from now on */
+	}
+
+	if (IS_HASWELL(power->devid)) {
+		rpstat = INREG(GEN6_RPSTAT1);
+		return ((rpstat & HSW_CAGF_MASK) >> HSW_CAGF_SHIFT) *
+			GT_FREQUENCY_MULTIPLIER;
+	} else if (IS_GEN6(power->devid) || IS_GEN7(power->devid)) {
+		rpstat = INREG(GEN6_RPSTAT1);
+		return ((rpstat & GEN6_CAGF_MASK) >> GEN6_CAGF_SHIFT) *
+			GT_FREQUENCY_MULTIPLIER;
+	}
+
+	return -1;
+}
+
+static void gt_power_read_rc6(struct gt_power *power)
+{
+	unsigned int i;
+
+	/* A counter that can't be read any more keeps its last value, so the
+	 * total doesn't go backwards. */
+	power->rc6_ms = 0;
+	for (i = 0; i < ARRAY_SIZE(rc6_files); i++) {
+		sysfs_read(&power->rc6_fd[i], &power->rc6_value[i]);
+		power->rc6_ms += power->rc6_value[i];
+	}
+	power->rc6_time = gettime();
+}
+
+static void gt_power_init(struct gt_power *power, uint32_t devid,
+			  const char *sysfs)
+{
+	unsigned int i;
+
+	memset(power, 0, sizeof(*power));
+	power->devid = devid;
+	power->freq_fd = sysfs_open(sysfs, "gt_cur_freq_mhz");
+	for (i = 0; i < ARRAY_SIZE(rc6_files); i++)
+		power->rc6_fd[i] = sysfs_open(sysfs, rc6_files[i]);
+
+	power->cur_freq = gt_power_read_freq(power);
+	gt_power_read_rc6(power);
+}
+
+static void gt_power_reset(struct gt_power *power)
+{
+	power->last_rc6_ms = power->rc6_ms;
+	power->last_rc6_time = power->rc6_time;
+
+	memset(power->freq_samples, 0, sizeof(power->freq_samples));
+	memset(power->freq_busy, 0, sizeof(power->freq_busy));
+	power->freq_failed = 0;
+	power->period_samples = power->period_idle = 0;
+	power->sx = power->sy = power->sxx = power->syy = power->sxy = 0;
+	power->n = 0;
+}
+
+static void gt_power_sample(struct gt_power *power, struct ring *render,
+			    int period)
+{
+	int busy = render->tail != render->head;
+	double x, y;
+	int bin;
+
+	/* A failed read only loses the samples until the next one works. */
+	if (power->cur_freq < 0) {
+		power->cur_freq = gt_power_read_freq(power);
+		if (power->cur_freq < 0) {
+			power->freq_failed++;
+			power->period_samples = power->period_idle = 0;
+			return;
+		}
+	}
+
+	bin = power->cur_freq / GT_FREQUENCY_MULTIPLIER;
+	if (bin >= FREQ_BINS)
+		bin = FREQ_BINS - 1;
+	power->freq_samples[bin]++;
+	power->freq_busy[bin] += busy;
+
+	power->period_idle += !busy;
+	if (++power->period_samples < period)
+		return;
+
+	x = power->cur_freq;
+	y = 100. - 100. * power->period_idle / power->period_samples;
+	power->sx += x;
+	power->sy += y;
+	power->sxx += x * x;
+	power->syy += y * y;
+	power->sxy += x * y;
+	power->n++;
+
+	power->cur_freq = gt_power_read_freq(power);
+	power->period_samples = power->period_idle = 0;
+}
+
+/* Pearson correlation of render busy% and frequency, 0 if undefined. */
+static double gt_power_correlation(struct gt_power *power)
+{
+	double n = power->n;
+	double vx = n * power->sxx - power->sx * power->sx;
+	double vy = n * power->syy - power->sy * power->sy;
+
+	if (power->n < 2 || vx <= 0 || vy <= 0)
+		return 0;
+
+	return (n * power->sxy - power->sx * power->sy) / sqrt(vx * vy);
+}
+
+static int gt_power_rc6_percent(struct gt_power *power)
+{
+	unsigned long long elapsed;
+
+	gt_power_read_rc6(power);
+
+	elapsed = power->rc6_time - power->last_rc6_time;
+	if (!elapsed)
+		return 0;
+
+	return (power->rc6_ms - power->last_rc6_ms) * 1000 * 100 / elapsed;
+}
+
+static int gt_power_avg_freq(struct gt_power *power)
+{
+	uint64_t total = 0, samples = 0;
+	int i;
+
+	for (i = 0; i < FREQ_BINS; i++) {
+		total += (uint64_t)power->freq_samples[i] * i;
+		samples += power->freq_samples[i];
+	}
+
+	return samples ? total * GT_FREQUENCY_MULTIPLIER / samples : -1;
+}
+
+static void gt_power_print(struct gt_power *power, int rc6)
+{
+	uint32_t samples = 0;
+	int i, len;
+
+	for (i = 0; i < FREQ_BINS; i++)
+		samples += power->freq_samples[i];
+
+	printf("%25s freq: %d MHz  rc6: %3d%%  busy/freq correlation: %+.2f",
+	       "GT", gt_power_avg_freq(power), rc6,
+	       gt_power_correlation(power));
+	if (power->freq_failed && samples)
+		printf("  (freq unreadable for %u samples)", power->freq_failed);
+	printf("\n");
+
+	if (!samples)
+		return;
+
+	len = printf("%25s", "time at freq:");
+	for (i = 0; i < FREQ_BINS; i++) {
+		if (!power->freq_samples[i])
+			continue;
+
+		if (len > 60) {
+			printf("\n");
+			len = printf("%25s", "");
+		}
+		len += printf(" %dMHz %d%% (busy %d%%)",
+			      i * GT_FREQUENCY_MULTIPLIER,
+			      (int)(100ull * power->freq_samples[i] / samples),
+			      (int)(100ull * power->freq_busy[i] /
+				    power->freq_samples[i]));
+	}
+	printf("\n");
+}
+
+static void
+publish_metrics(struct metrics_server *server, uint32_t devid,
+		struct ring **rings, unsigned long samples_per_sec,
+		struct gt_power *power, int rc6)
+{
+	char *text = NULL;
+	size_t len = 0;
+	FILE *out;
+	int i;
+
+	out = open_memstream(&text, &len);
+	if (!out)
+		return;
+
+	fprintf(out, "# TYPE intel_gpu_top_ring_busy_percent gauge\n");
+	for (i = 0; i < GPU_TOP_LOG_RINGS; i++) {
+		if (!rings[i]->size)
+			continue;
+		fprintf(out, "intel_gpu_top_ring_busy_percent{ring=\"%s\"} %lu\n",
+			rings[i]->name,
+			100 - 100 * rings[i]->idle / samples_per_sec);
+	}
+
+	fprintf(out, "# TYPE intel_gpu_top_ring_fill_bytes gauge\n");
+	for (i = 0; i < GPU_TOP_LOG_RINGS; i++) {
+		if (!rings[i]->size)
+			continue;
+		fprintf(out, "intel_gpu_top_ring_fill_bytes{ring=\"%s\"} %llu\n",
+			rings[i]->name,
+			(unsigned long long)(rings[i]->full / samples_per_sec));
+	}
+
+	fprintf(out, "# TYPE intel_gpu_top_ring_size_bytes gauge\n");
+	for (i = 0; i < GPU_TOP_LOG_RINGS; i++) {
+		if (!rings[i]->size)
+			continue;
+		fprintf(out, "intel_gpu_top_ring_size_bytes{ring=\"%s\"} %d\n",
+			rings[i]->name, rings[i]->size);
+	}
+
+	fprintf(out, "# TYPE intel_gpu_top_unit_busy_percent gauge\n");
+	for (i = 0; i < num_instdone_bits; i++)
+		fprintf(out, "intel_gpu_top_unit_busy_percent{unit=\"%s\"} %lu\n",
+			top_bits[i].bit->name,
+			top_bits[i].count * 100 / samples_per_sec);
+
+	if (HAS_STATS_REGS(devid)) {
+		fprintf(out, "# TYPE intel_gpu_top_pipeline_stat_total counter\n");
+		for (i = 0; i < STATS_COUNT; i++)
+			fprintf(out, "intel_gpu_top_pipeline_stat_total{stat=\"%s\"} %llu\n",
+				stats_reg_names[i], (unsigned long long)stats[i]);
+	}
+
+	fprintf(out, "# TYPE intel_gpu_top_freq_mhz gauge\n"
+		"intel_gpu_top_freq_mhz %d\n",
+		gt_power_avg_freq(power));
+	fprintf(out, "# TYPE intel_gpu_top_rc6_percent gauge\n"
+		"intel_gpu_top_rc6_percent %d\n",
+		rc6);
+
+	fclose(out);
+
+	metrics_server_publish(server, text, len);
+	free(text);
 }
 
 static void
@@ -395,10 +921,17 @@ usage(const char *appname)
 			"[-e <command>]       command to profile\n"
 			"[-o <file>]          output statistics to file. If file is '-',"
 			"                     run in batch mode and output statistics to stdio only \n"
+			"[-b <file>]          log every raw sample to a binary file, for\n"
+			"                     later analysis with intel_gpu_top_analyze\n"
+			"[-m <address>]       headless mode, serve metrics on a UNIX socket\n"
+			"                     (absolute path) or on a loopback HTTP port\n"
+			"[-p <path>]          sysfs directory of the device to read the GT\n"
+			"                     frequency and rc6 residency from (default %s)\n"
 			"[-h]                 show this help screen\n"
 			"\n",
 			appname,
-			SAMPLES_PER_SEC
+			SAMPLES_PER_SEC,
+			SYSFS_PATH
 		  );
 	return;
 }
@@ -420,18 +953,27 @@ int main(int argc, char **argv)
 		.name = "blitter",
 		.mmio = 0x22030,
 	};
+	struct ring *rings[GPU_TOP_LOG_RINGS] = {
+		&render_ring, &bsd_ring, &bsd6_ring, &blt_ring
+	};
 	int i, ch;
 	int samples_per_sec = SAMPLES_PER_SEC;
 	FILE *output = NULL;
+	FILE *log = NULL;
+	const char *sysfs = SYSFS_PATH;
+	struct gt_power power;
+	int freq_period;
 	double elapsed_time=0;
 	int print_headers=1;
 	pid_t child_pid=-1;
 	int child_stat;
 	char *cmd=NULL;
 	int interactive=1;
+	struct metrics_server *metrics = NULL;
+	const char *metrics_address = NULL;
 
 	/* Parse options? */
-	while ((ch = getopt(argc, argv, "s:o:e:h")) != -1) {
+	while ((ch = getopt(argc, argv, "s:o:b:m:p:e:h")) != -1) {
 		switch (ch) {
 		case 'e': cmd = strdup(optarg);
 			break;
@@ -455,6 +997,22 @@ int main(int argc, char **argv)
 				exit(1);
 			}
 			break;
+		case 'b':
+			log = fopen(optarg, "w");
+			if (!log) {
+				perror("fopen");
+				exit(1);
+			}
+			setvbuf(log, NULL, _IOFBF, 1 << 20);
+			break;
+		case 'm':
+			/* Running headless */
+			interactive = 0;
+			metrics_address = optarg;
+			break;
+		case 'p':
+			sysfs = optarg;
+			break;
 		case 'h':
 			usage(argv[0]);
 			exit(0);
@@ -517,6 +1075,15 @@ int main(int argc, char **argv)
 		ring_init(&blt_ring);
 	}
 
+	gt_power_init(&power, devid, sysfs);
+
+	if (metrics_address)
+		metrics = metrics_server_start(metrics_address);
+	freq_period = samples_per_sec / FREQ_SAMPLES_PER_SEC;
+
+	if (log)
+		log_header(log, devid, samples_per_sec, rings);
+
 	/* Initialize GPU stats */
 	if (HAS_STATS_REGS(devid)) {
 		for (i = 0; i < STATS_COUNT; i++) {
@@ -531,9 +1098,13 @@ int main(int argc, char **argv)
 			last_stats[i] = (uint64_t)stats_high << 32 |
 				stats_low;
 		}
+
+		if (log)
+			log_stats(log, gettime(), last_stats);
 	}
 
 	for (;;) {
+		uint32_t instdone = 0, instdone1 = 0;
 		int j;
 		unsigned long long t1, ti, tf, t2;
 		unsigned long long def_sleep = 1000000 / samples_per_sec;
@@ -545,6 +1116,7 @@ int main(int argc, char **argv)
 				       0x0};
 		int percent;
 		int len;
+		int rc6;
 
 		t1 = gettime();
 
@@ -553,23 +1125,34 @@ int main(int argc, char **argv)
 		ring_reset(&bsd6_ring);
 		ring_reset(&blt_ring);
 
+		instdone_counter_reset(&instdone_counter);
+		instdone_counter_reset(&instdone1_counter);
+
+		gt_power_reset(&power);
+
 		for (i = 0; i < samples_per_sec; i++) {
 			long long interval;
 			ti = gettime();
 			if (IS_965(devid)) {
 				instdone = INREG(INST_DONE_I965);
 				instdone1 = INREG(INST_DONE_1);
-			} else
+				instdone_counter_add(&instdone_counter, instdone);
+				instdone_counter_add(&instdone1_counter, instdone1);
+			} else {
 				instdone = INREG(INST_DONE);
-
-			for (j = 0; j < num_instdone_bits; j++)
-				update_idle_bit(&top_bits[j]);
+				instdone_counter_add(&instdone_counter, instdone);
+			}
 
 			ring_sample(&render_ring);
 			ring_sample(&bsd_ring);
 			ring_sample(&bsd6_ring);
 			ring_sample(&blt_ring);
 
+			gt_power_sample(&power, &render_ring, freq_period);
+
+			if (log)
+				log_sample(log, ti, instdone, instdone1, rings);
+
 			tf = gettime();
 			if (tf - t1 >= 1000000) {
 				/* We are out of sync, bail out */
@@ -594,22 +1177,42 @@ int main(int argc, char **argv)
 				stats[i] = (uint64_t)stats_high << 32 |
 					stats_low;
 			}
+
+			if (log)
+				log_stats(log, gettime(), stats);
 		}
 
+		ring_flush_runs(&render_ring);
+		ring_flush_runs(&bsd_ring);
+		ring_flush_runs(&bsd6_ring);
+		ring_flush_runs(&blt_ring);
+
+		instdone_counter_flush(&instdone_counter);
+		instdone_counter_flush(&instdone1_counter);
+		for (j = 0; j < num_instdone_bits; j++)
+			update_idle_bit(&top_bits[j]);
+
 		qsort(top_bits_sorted, num_instdone_bits,
 		      sizeof(struct top_bit *), top_bits_sort);
 
 		/* Limit the number of lines printed to the terminal height so the
 		 * most important info (at the top) will stay on screen. */
 		max_lines = -1;
-		if (ioctl(0, TIOCGWINSZ, &ws) != -1)
+		if (ioctl(0, TIOCGWINSZ, &ws) != -1) {
 			max_lines = ws.ws_row - 6; /* exclude header lines */
+			for (j = 0; j < GPU_TOP_LOG_RINGS; j++)
+				if (rings[j]->size)
+					max_lines--; /* and the percentile lines */
+			max_lines -= 2; /* and the GT frequency lines */
+		}
 		if (max_lines >= num_instdone_bits)
 			max_lines = num_instdone_bits;
 
 		t2 = gettime();
 		elapsed_time += (t2 - t1) / 1000000.0;
 
+		rc6 = gt_power_rc6_percent(&power);
+
 		if (interactive) {
 			printf("%s", clear_screen);
 			print_clock_info(pci_dev);
@@ -618,6 +1221,7 @@ int main(int argc, char **argv)
 			ring_print(&bsd_ring, last_samples_per_sec);
 			ring_print(&bsd6_ring, last_samples_per_sec);
 			ring_print(&blt_ring, last_samples_per_sec);
+			gt_power_print(&power, rc6);
 
 			printf("\n%30s  %s\n", "task", "percent busy");
 			for (i = 0; i < max_lines; i++) {
@@ -637,7 +1241,6 @@ int main(int argc, char **argv)
 						   stats_reg_names[i],
 						   (long long)stats[i],
 						   (long long)(stats[i] - last_stats[i]));
-					last_stats[i] = stats[i];
 				} else {
 					if (!top_bits_sorted[i]->count)
 						break;
@@ -653,14 +1256,11 @@ int main(int argc, char **argv)
 				ring_print_header(output, &bsd_ring);
 				ring_print_header(output, &bsd6_ring);
 				ring_print_header(output, &blt_ring);
-				for (i = 0; i < MAX_NUM_TOP_BITS; i++) {
-					if (i < STATS_COUNT && HAS_STATS_REGS(devid)) {
+				fprintf(output, "freq\trc6%%\tcorr\t");
+				if (HAS_STATS_REGS(devid)) {
+					for (i = 0; i < STATS_COUNT; i++)
 						fprintf(output, "%.6s\t",
-							   stats_reg_names[i]
-							   );
-					}
-					if (!top_bits[i].count)
-						continue;
+							stats_reg_names[i]);
 				}
 				fprintf(output, "\n");
 				print_headers = 0;
@@ -672,26 +1272,28 @@ int main(int argc, char **argv)
 			ring_log(&bsd_ring, last_samples_per_sec, output);
 			ring_log(&bsd6_ring, last_samples_per_sec, output);
 			ring_log(&blt_ring, last_samples_per_sec, output);
-
-			for (i = 0; i < MAX_NUM_TOP_BITS; i++) {
-				if (i < STATS_COUNT && HAS_STATS_REGS(devid)) {
-					fprintf(output, "%lu\t",
-						   stats[i] - last_stats[i]);
-					last_stats[i] = stats[i];
-				}
-					if (!top_bits[i].count)
-						continue;
+			fprintf(output, "%d\t%d\t%.2f\t",
+				gt_power_avg_freq(&power), rc6,
+				gt_power_correlation(&power));
+
+			if (HAS_STATS_REGS(devid)) {
+				for (i = 0; i < STATS_COUNT; i++)
+					fprintf(output, "%llu\t",
+						(unsigned long long)(stats[i] - last_stats[i]));
 			}
 			fprintf(output, "\n");
 			fflush(output);
 		}
 
-		for (i = 0; i < num_instdone_bits; i++) {
+		if (metrics)
+			publish_metrics(metrics, devid, rings,
+					last_samples_per_sec, &power, rc6);
+
+		for (i = 0; i < num_instdone_bits; i++)
 			top_bits_sorted[i]->count = 0;
 
-			if (i < STATS_COUNT)
-				last_stats[i] = stats[i];
-		}
+		for (i = 0; i < STATS_COUNT; i++)
+			last_stats[i] = stats[i];
 
 		/* Check if child has gone */
 		if (child_pid > 0) {
@@ -707,7 +1309,12 @@ int main(int argc, char **argv)
 		}
 	}
 
-	fclose(output);
+	if (output)
+		fclose(output);
+	if (log)
+		fclose(log);
+	if (metrics)
+		metrics_server_stop(metrics);
 
 	intel_register_access_fini();
 	return 0;
@@ -0,0 +1,313 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Offline analysis of the binary sample logs written by intel_gpu_top -b.
+ *
+ * The raw samples are re-aggregated into windows of arbitrary length and
+ * printed as CSV: per ring busy percentage and mean/percentile fill, per
+ * INSTDONE unit busy percentage and the pipeline statistics deltas.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#include "instdone.h"
+#include "intel_chipset.h"
+#include "intel_reg.h"
+#include "intel_gpu_top_log.h"
+
+static const char *stats_names[GPU_TOP_LOG_STATS] = {
+	"vert fetch",
+	"prim fetch",
+	"VS invocations",
+	"GS invocations",
+	"GS prims",
+	"CL invocations",
+	"CL prims",
+	"PS invocations",
+	"PS depth pass",
+};
+
+struct ring_window {
+	uint32_t *fill;
+	int idle;
+};
+
+static struct gpu_top_log_header header;
+static struct ring_window rings[GPU_TOP_LOG_RINGS];
+static int samples, max_samples;
+static int busy[MAX_INSTDONE_BITS];
+static uint64_t stats[GPU_TOP_LOG_STATS], last_stats[GPU_TOP_LOG_STATS];
+static int have_stats, have_last_stats;
+
+static int
+cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static uint32_t
+percentile(const uint32_t *sorted, int count, int p)
+{
+	int i = (count * p + 99) / 100 - 1;
+
+	if (i < 0)
+		i = 0;
+	return sorted[i];
+}
+
+static void
+print_header(FILE *out)
+{
+	int i;
+
+	fprintf(out, "time");
+	for (i = 0; i < GPU_TOP_LOG_RINGS; i++) {
+		const char *name = header.ring_name[i];
+
+		if (!header.ring_size[i])
+			continue;
+
+		fprintf(out, ",%s busy,%s fill,%s fill p50,%s fill p95,%s fill p99",
+			name, name, name, name, name);
+	}
+	for (i = 0; i < num_instdone_bits; i++)
+		fprintf(out, ",%s", instdone_bits[i].name);
+	for (i = 0; i < GPU_TOP_LOG_STATS; i++)
+		fprintf(out, ",%s", stats_names[i]);
+	fprintf(out, "\n");
+}
+
+static void
+print_window(FILE *out, double time)
+{
+	int i;
+
+	if (!samples)
+		return;
+
+	fprintf(out, "%.3f", time);
+	for (i = 0; i < GPU_TOP_LOG_RINGS; i++) {
+		struct ring_window *ring = &rings[i];
+		uint64_t total = 0;
+		int n;
+
+		if (!header.ring_size[i])
+			continue;
+
+		for (n = 0; n < samples; n++)
+			total += ring->fill[n];
+		qsort(ring->fill, samples, sizeof(*ring->fill), cmp_u32);
+
+		fprintf(out, ",%.1f,%u,%u,%u,%u",
+			100. - 100. * ring->idle / samples,
+			(unsigned)(total / samples),
+			percentile(ring->fill, samples, 50),
+			percentile(ring->fill, samples, 95),
+			percentile(ring->fill, samples, 99));
+	}
+	for (i = 0; i < num_instdone_bits; i++)
+		fprintf(out, ",%.1f", 100. * busy[i] / samples);
+	for (i = 0; i < GPU_TOP_LOG_STATS; i++) {
+		if (have_stats && have_last_stats)
+			fprintf(out, ",%llu",
+				(unsigned long long)(stats[i] - last_stats[i]));
+		else
+			fprintf(out, ",");
+	}
+	fprintf(out, "\n");
+
+	for (i = 0; i < GPU_TOP_LOG_RINGS; i++)
+		rings[i].idle = 0;
+	memset(busy, 0, sizeof(busy));
+	if (have_stats) {
+		memcpy(last_stats, stats, sizeof(stats));
+		have_last_stats = 1;
+		have_stats = 0;
+	}
+	samples = 0;
+}
+
+static void
+add_sample(const struct gpu_top_log_sample *sample)
+{
+	int i;
+
+	if (samples == max_samples) {
+		max_samples = max_samples ? 2 * max_samples : 4096;
+		for (i = 0; i < GPU_TOP_LOG_RINGS; i++) {
+			rings[i].fill = realloc(rings[i].fill,
+						max_samples * sizeof(uint32_t));
+			if (!rings[i].fill)
+				err(1, "realloc");
+		}
+	}
+
+	for (i = 0; i < GPU_TOP_LOG_RINGS; i++) {
+		int full;
+
+		if (!header.ring_size[i])
+			continue;
+
+		full = sample->tail[i] - sample->head[i];
+		if (full < 0)
+			full += header.ring_size[i];
+		if (!full)
+			rings[i].idle++;
+		rings[i].fill[samples] = full;
+	}
+
+	for (i = 0; i < num_instdone_bits; i++) {
+		uint32_t reg_val;
+
+		if (instdone_bits[i].reg == INST_DONE_1)
+			reg_val = sample->instdone[1];
+		else
+			reg_val = sample->instdone[0];
+
+		if ((reg_val & instdone_bits[i].bit) == 0)
+			busy[i]++;
+	}
+
+	samples++;
+}
+
+static void
+usage(const char *appname)
+{
+	printf("intel_gpu_top_analyze - Re-aggregate a binary intel_gpu_top log\n"
+	       "\n"
+	       "usage: %s [parameters] <log file>\n"
+	       "\n"
+	       "The following parameters apply:\n"
+	       "[-w <msecs>]         aggregation window (default 1000)\n"
+	       "[-o <file>]          write the CSV output to file (default stdout)\n"
+	       "[-h]                 show this help screen\n"
+	       "\n",
+	       appname);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *in, *out = stdout;
+	uint64_t window = 1000000, start = 0, window_start = 0;
+	int first = 1;
+	uint32_t type;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "w:o:h")) != -1) {
+		switch (ch) {
+		case 'w':
+			window = strtoull(optarg, NULL, 0) * 1000;
+			if (!window) {
+				fprintf(stderr, "Error: window must be >= 1ms\n");
+				exit(1);
+			}
+			break;
+		case 'o':
+			out = fopen(optarg, "w");
+			if (!out) {
+				perror("fopen");
+				exit(1);
+			}
+			break;
+		case 'h':
+			usage(argv[0]);
+			exit(0);
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (optind >= argc) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	in = fopen(argv[optind], "r");
+	if (!in)
+		err(1, "failed to open %s", argv[optind]);
+
+	if (fread(&header, sizeof(header), 1, in) != 1 ||
+	    header.magic != GPU_TOP_LOG_MAGIC)
+		errx(1, "%s is not an intel_gpu_top log", argv[optind]);
+	if (header.version != GPU_TOP_LOG_VERSION)
+		errx(1, "unsupported log version %u", header.version);
+
+	init_instdone_definitions(header.devid);
+	print_header(out);
+
+	while (fread(&type, sizeof(type), 1, in) == 1) {
+		if (type == GPU_TOP_LOG_RECORD_SAMPLE) {
+			struct gpu_top_log_sample sample;
+
+			if (fread((char *)&sample + sizeof(type),
+				  sizeof(sample) - sizeof(type), 1, in) != 1)
+				break;
+
+			if (first) {
+				start = window_start = sample.timestamp;
+				first = 0;
+			}
+
+			while (sample.timestamp >= window_start + window) {
+				print_window(out, (window_start - start) / 1e6);
+				window_start += window;
+			}
+
+			add_sample(&sample);
+		} else if (type == GPU_TOP_LOG_RECORD_STATS) {
+			struct gpu_top_log_stats record;
+
+			if (fread((char *)&record + sizeof(type),
+				  sizeof(record) - sizeof(type), 1, in) != 1)
+				break;
+
+			if (!have_last_stats) {
+				memcpy(last_stats, record.stats, sizeof(stats));
+				have_last_stats = 1;
+			} else {
+				memcpy(stats, record.stats, sizeof(stats));
+				have_stats = 1;
+			}
+		} else {
+			errx(1, "corrupt log: unknown record type %u", type);
+		}
+	}
+
+	print_window(out, (window_start - start) / 1e6);
+
+	fclose(in);
+	if (out != stdout)
+		fclose(out);
+
+	return 0;
+}
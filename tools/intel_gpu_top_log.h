@@ -0,0 +1,71 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _INTEL_GPU_TOP_LOG_H_
+#define _INTEL_GPU_TOP_LOG_H_
+
+#include <stdint.h>
+
+/*
+ * Binary sample log written by intel_gpu_top -b and read back by
+ * intel_gpu_top_analyze.  The file is a gpu_top_log_header followed by a
+ * stream of records, each starting with its record type.  All values are
+ * in host byte order.
+ */
+#define GPU_TOP_LOG_MAGIC		0x4c505447	/* "GTPL" */
+#define GPU_TOP_LOG_VERSION		1
+
+#define GPU_TOP_LOG_RINGS		4
+#define GPU_TOP_LOG_INSTDONE		2
+#define GPU_TOP_LOG_STATS		9
+
+struct gpu_top_log_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t devid;
+	uint32_t samples_per_sec;
+	uint32_t ring_size[GPU_TOP_LOG_RINGS];	/**< 0 if the ring is absent */
+	char ring_name[GPU_TOP_LOG_RINGS][16];
+} __attribute__ ((packed));
+
+#define GPU_TOP_LOG_RECORD_SAMPLE	1
+#define GPU_TOP_LOG_RECORD_STATS	2
+
+/** One record per sample of the sampling loop. */
+struct gpu_top_log_sample {
+	uint32_t type;
+	uint32_t instdone[GPU_TOP_LOG_INSTDONE];
+	uint32_t head[GPU_TOP_LOG_RINGS];
+	uint32_t tail[GPU_TOP_LOG_RINGS];
+	uint64_t timestamp;			/**< in usecs */
+} __attribute__ ((packed));
+
+/** One record per refresh with the raw pipeline statistics counters. */
+struct gpu_top_log_stats {
+	uint32_t type;
+	uint64_t timestamp;			/**< in usecs */
+	uint64_t stats[GPU_TOP_LOG_STATS];
+} __attribute__ ((packed));
+
+#endif /* _INTEL_GPU_TOP_LOG_H_ */
@@ -0,0 +1,345 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "intel_gpu_top_metrics.h"
+
+#define MAX_CLIENTS		16
+#define MAX_REQUEST		4096
+
+struct metrics_client {
+	int fd;
+	char *response;		/* NULL while the request is being read */
+	size_t len, written;
+	size_t request_len;
+	char request[MAX_REQUEST];
+};
+
+struct metrics_server {
+	int fd, http;
+	int wake[2];		/* pipe used to stop the server thread */
+	char *path;
+	pthread_t thread;
+
+	pthread_mutex_t lock;	/* protects text/len */
+	char *text;
+	size_t len;
+
+	struct metrics_client clients[MAX_CLIENTS];
+	int num_clients;
+};
+
+static void set_nonblock(int fd)
+{
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static void client_respond(struct metrics_server *server,
+			   struct metrics_client *client)
+{
+	char header[128];
+	size_t header_len = 0;
+
+	pthread_mutex_lock(&server->lock);
+	if (server->http)
+		header_len = snprintf(header, sizeof(header),
+				      "HTTP/1.0 200 OK\r\n"
+				      "Content-Type: text/plain; version=0.0.4\r\n"
+				      "Content-Length: %zu\r\n"
+				      "\r\n", server->len);
+	client->response = malloc(header_len + server->len + 1);
+	if (client->response) {
+		memcpy(client->response, header, header_len);
+		memcpy(client->response + header_len, server->text, server->len);
+		client->len = header_len + server->len;
+	}
+	pthread_mutex_unlock(&server->lock);
+
+	client->written = 0;
+}
+
+static void client_close(struct metrics_server *server, int i)
+{
+	struct metrics_client *client = &server->clients[i];
+
+	close(client->fd);
+	free(client->response);
+
+	server->clients[i] = server->clients[--server->num_clients];
+}
+
+/* Returns 0 once the client is done with and can be closed. */
+static int client_read(struct metrics_server *server,
+		       struct metrics_client *client)
+{
+	ssize_t ret;
+
+	ret = read(client->fd, client->request + client->request_len,
+		   sizeof(client->request) - client->request_len - 1);
+	if (ret < 0)
+		return errno == EAGAIN || errno == EINTR;
+	if (ret == 0)
+		return 0;
+
+	client->request_len += ret;
+	client->request[client->request_len] = '\0';
+
+	if (strstr(client->request, "\r\n\r\n") ||
+	    strstr(client->request, "\n\n")) {
+		client_respond(server, client);
+		return client->response != NULL;
+	}
+
+	/* Oversized request, give up on it */
+	return client->request_len < sizeof(client->request) - 1;
+}
+
+static int client_write(struct metrics_client *client)
+{
+	ssize_t ret;
+
+	ret = send(client->fd, client->response + client->written,
+		   client->len - client->written, MSG_NOSIGNAL);
+	if (ret < 0)
+		return errno == EAGAIN || errno == EINTR;
+
+	client->written += ret;
+	return client->written < client->len;
+}
+
+static void server_accept(struct metrics_server *server)
+{
+	struct metrics_client *client;
+	int fd;
+
+	fd = accept(server->fd, NULL, NULL);
+	if (fd < 0)
+		return;
+
+	if (server->num_clients == MAX_CLIENTS) {
+		close(fd);
+		return;
+	}
+
+	set_nonblock(fd);
+
+	client = &server->clients[server->num_clients++];
+	memset(client, 0, sizeof(*client));
+	client->fd = fd;
+
+	/* There is no request on the UNIX socket, just dump the metrics. */
+	if (!server->http) {
+		client_respond(server, client);
+		if (!client->response)
+			client_close(server, server->num_clients - 1);
+	}
+}
+
+static void *server_thread(void *data)
+{
+	struct metrics_server *server = data;
+	struct pollfd pfd[MAX_CLIENTS + 2];
+
+	for (;;) {
+		int i, n = 0;
+
+		pfd[n].fd = server->wake[0];
+		pfd[n++].events = POLLIN;
+		pfd[n].fd = server->fd;
+		pfd[n++].events = POLLIN;
+		for (i = 0; i < server->num_clients; i++) {
+			pfd[n].fd = server->clients[i].fd;
+			pfd[n++].events =
+				server->clients[i].response ? POLLOUT : POLLIN;
+		}
+
+		if (poll(pfd, n, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (pfd[0].revents)
+			break;
+
+		/* Walk backwards as closing a client moves the last one into
+		 * its slot. */
+		for (i = server->num_clients; i--; ) {
+			struct metrics_client *client = &server->clients[i];
+			short revents = pfd[i + 2].revents;
+			int keep = 1;
+
+			if (!revents)
+				continue;
+
+			if (revents & (POLLERR | POLLNVAL))
+				keep = 0;
+			else if (client->response)
+				keep = client_write(client);
+			else
+				keep = client_read(server, client);
+
+			if (!keep)
+				client_close(server, i);
+		}
+
+		if (pfd[1].revents & POLLIN)
+			server_accept(server);
+	}
+
+	while (server->num_clients)
+		client_close(server, 0);
+
+	return NULL;
+}
+
+static int listen_unix(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		errx(1, "metrics socket path too long: %s", path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		err(1, "socket");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)))
+		err(1, "bind %s", path);
+
+	return fd;
+}
+
+static int listen_loopback(int port)
+{
+	struct sockaddr_in addr;
+	int fd, one = 1;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		err(1, "socket");
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)))
+		err(1, "bind 127.0.0.1:%d", port);
+
+	return fd;
+}
+
+struct metrics_server *metrics_server_start(const char *address)
+{
+	struct metrics_server *server;
+
+	server = calloc(1, sizeof(*server));
+	if (!server)
+		err(1, "calloc");
+
+	if (address[0] == '/') {
+		server->fd = listen_unix(address);
+		server->path = strdup(address);
+	} else {
+		server->fd = listen_loopback(atoi(address));
+		server->http = 1;
+	}
+
+	if (listen(server->fd, MAX_CLIENTS))
+		err(1, "listen");
+	set_nonblock(server->fd);
+
+	if (pipe(server->wake))
+		err(1, "pipe");
+
+	pthread_mutex_init(&server->lock, NULL);
+	server->text = strdup("");
+
+	if (pthread_create(&server->thread, NULL, server_thread, server))
+		errx(1, "failed to create the metrics thread");
+
+	return server;
+}
+
+void metrics_server_publish(struct metrics_server *server,
+			    const char *text, size_t len)
+{
+	char *copy, *old;
+
+	/* Copy outside of the lock, only swap the pointers under it. */
+	copy = malloc(len + 1);
+	if (!copy)
+		return;
+	memcpy(copy, text, len);
+	copy[len] = '\0';
+
+	pthread_mutex_lock(&server->lock);
+	old = server->text;
+	server->text = copy;
+	server->len = len;
+	pthread_mutex_unlock(&server->lock);
+
+	free(old);
+}
+
+void metrics_server_stop(struct metrics_server *server)
+{
+	if (write(server->wake[1], "", 1) != 1)
+		pthread_cancel(server->thread);
+	pthread_join(server->thread, NULL);
+
+	close(server->wake[0]);
+	close(server->wake[1]);
+	close(server->fd);
+	if (server->path) {
+		unlink(server->path);
+		free(server->path);
+	}
+
+	pthread_mutex_destroy(&server->lock);
+	free(server->text);
+	free(server);
+}
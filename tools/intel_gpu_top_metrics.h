@@ -0,0 +1,47 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _INTEL_GPU_TOP_METRICS_H_
+#define _INTEL_GPU_TOP_METRICS_H_
+
+#include <stddef.h>
+
+/*
+ * Local metrics endpoint for intel_gpu_top.
+ *
+ * The sampler publishes a complete text exposition once per refresh and a
+ * separate thread serves the latest copy to clients, either raw on a UNIX
+ * socket (address starting with '/') or as an HTTP response on a loopback
+ * TCP port.  Publishing only swaps a pointer under a lock that the server
+ * thread never holds across any I/O, so a slow client cannot stall the
+ * sampler.
+ */
+struct metrics_server;
+
+struct metrics_server *metrics_server_start(const char *address);
+void metrics_server_publish(struct metrics_server *server,
+			    const char *text, size_t len);
+void metrics_server_stop(struct metrics_server *server);
+
+#endif /* _INTEL_GPU_TOP_METRICS_H_ */
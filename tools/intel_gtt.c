@@ -31,29 +31,41 @@
 #include <stdarg.h>
 #include <pciaccess.h>
 #include <unistd.h>
+#include <err.h>
 
 #include "intel_gpu_tools.h"
 
-#define INGTT(offset) (*(volatile uint32_t *)(gtt + (offset) / (KB(4) / 4)))
-
 #define KB(x) ((x) * 1024)
 #define MB(x) ((x) * 1024 * 1024)
 
-int main(int argc, char **argv)
+#define PAGE_SHIFT 12
+
+/*
+ * GTT dump file: a gtt_dump_header followed by num_entries PTEs, one per
+ * 4KiB page of the aperture, in host byte order.
+ */
+#define GTT_DUMP_MAGIC		0x44545447	/* "GTTD" */
+#define GTT_DUMP_VERSION	1
+
+struct gtt_dump_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t devid;
+	uint32_t num_entries;
+};
+
+#define RUN_BUCKETS 32
+
+static uint32_t *
+map_gtt(struct pci_device *pci_dev, uint32_t devid)
 {
-	struct pci_device *pci_dev;
-	int start, aper_size;
 	unsigned char *gtt;
-	uint32_t devid;
 	int flag[] = {
 		PCI_DEV_MAP_FLAG_WRITE_COMBINE,
 		PCI_DEV_MAP_FLAG_WRITABLE,
 		0
 	}, f;
 
-	pci_dev = intel_get_pci_device();
-	devid = pci_dev->device_id;
-
 	if (IS_GEN2(devid)) {
 		printf("Unsupported chipset for gtt dumper\n");
 		exit(1);
@@ -87,48 +99,328 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
-	aper_size = pci_dev->regions[2].size;
+	return (uint32_t *)gtt;
+}
+
+/*
+ * Snapshot the live GTT into a plain array in one pass, so that all the
+ * scanning below runs on cached memory rather than on the WC mapping.
+ */
+static uint32_t *
+read_gtt(uint32_t *devid, uint32_t *num_entries)
+{
+	struct pci_device *pci_dev;
+	volatile uint32_t *gtt;
+	uint32_t *pte, i;
 
-	for (start = 0; start < aper_size; start += KB(4)) {
-		uint32_t start_pte = INGTT(start);
-		uint32_t end;
-		int constant_length = 0;
-		int linear_length = 0;
+	pci_dev = intel_get_pci_device();
+	*devid = pci_dev->device_id;
+	gtt = map_gtt(pci_dev, *devid);
 
-		/* Check if it's a linear sequence */
-		for (end = start + KB(4); end < aper_size; end += KB(4)) {
-			uint32_t end_pte = INGTT(end);
-			if (end_pte == start_pte + (end - start))
-				linear_length++;
-			else
-				break;
-		}
-		if (linear_length > 0) {
+	*num_entries = pci_dev->regions[2].size >> PAGE_SHIFT;
+	pte = malloc(*num_entries * sizeof(*pte));
+	if (!pte)
+		err(1, "malloc");
+
+	for (i = 0; i < *num_entries; i++)
+		pte[i] = gtt[i];
+
+	return pte;
+}
+
+static uint32_t *
+load_gtt(const char *filename, uint32_t *devid, uint32_t *num_entries)
+{
+	struct gtt_dump_header header;
+	uint32_t *pte;
+	FILE *file;
+
+	file = fopen(filename, "r");
+	if (!file)
+		err(1, "failed to open %s", filename);
+
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+	    header.magic != GTT_DUMP_MAGIC)
+		errx(1, "%s is not a GTT dump", filename);
+	if (header.version != GTT_DUMP_VERSION)
+		errx(1, "%s: unsupported dump version %u", filename,
+		     header.version);
+
+	pte = malloc(header.num_entries * sizeof(*pte));
+	if (!pte)
+		err(1, "malloc");
+	if (fread(pte, sizeof(*pte), header.num_entries, file) !=
+	    header.num_entries)
+		errx(1, "%s: truncated dump", filename);
+
+	fclose(file);
+
+	*devid = header.devid;
+	*num_entries = header.num_entries;
+	return pte;
+}
+
+static void
+save_gtt(const char *filename, uint32_t devid,
+	 const uint32_t *pte, uint32_t num_entries)
+{
+	struct gtt_dump_header header;
+	FILE *file;
+
+	file = fopen(filename, "w");
+	if (!file)
+		err(1, "failed to open %s", filename);
+
+	header.magic = GTT_DUMP_MAGIC;
+	header.version = GTT_DUMP_VERSION;
+	header.devid = devid;
+	header.num_entries = num_entries;
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+	    fwrite(pte, sizeof(*pte), num_entries, file) != num_entries)
+		err(1, "failed to write %s", filename);
+
+	fclose(file);
+}
+
+/*
+ * Returns the end of the run of PTEs starting at start that step by
+ * stride.  The inner loop has no early exit, so the compiler can
+ * vectorise it; only the block containing the break is rescanned.
+ */
+static uint32_t
+run_end(const uint32_t *pte, uint32_t start, uint32_t num_entries,
+	uint32_t stride)
+{
+	uint32_t i = start + 1;
+
+	while (i + 8 <= num_entries) {
+		uint32_t mismatch = 0;
+		int j;
+
+		for (j = 0; j < 8; j++)
+			mismatch |= (pte[i + j] - pte[i + j - 1]) ^ stride;
+		if (mismatch)
+			break;
+		i += 8;
+	}
+
+	while (i < num_entries && pte[i] - pte[i - 1] == stride)
+		i++;
+
+	return i;
+}
+
+static void
+dump_gtt(const uint32_t *pte, uint32_t num_entries)
+{
+	uint32_t start, end;
+
+	for (start = 0; start < num_entries; start = end) {
+		end = run_end(pte, start, num_entries, KB(4));
+		if (end - start > 1) {
 			printf("0x%08x - 0x%08x: linear from "
 			       "0x%08x to 0x%08x\n",
-			       start, end - KB(4),
-			       start_pte, start_pte + (end - start) - KB(4));
-			start = end - KB(4);
+			       start << PAGE_SHIFT, (end - 1) << PAGE_SHIFT,
+			       pte[start], pte[end - 1]);
 			continue;
 		}
 
-		/* Check if it's a constant sequence */
-		for (end = start + KB(4); end < aper_size; end += KB(4)) {
-			uint32_t end_pte = INGTT(end);
-			if (end_pte == start_pte)
-				constant_length++;
-			else
-				break;
-		}
-		if (constant_length > 0) {
+		end = run_end(pte, start, num_entries, 0);
+		if (end - start > 1) {
 			printf("0x%08x - 0x%08x: constant 0x%08x\n",
-			       start, end - KB(4), start_pte);
-			start = end - KB(4);
+			       start << PAGE_SHIFT, (end - 1) << PAGE_SHIFT,
+			       pte[start]);
 			continue;
 		}
 
-		printf("0x%08x: 0x%08x\n", start, start_pte);
+		printf("0x%08x: 0x%08x\n", start << PAGE_SHIFT, pte[start]);
+	}
+}
+
+static int
+log2_bucket(uint32_t pages)
+{
+	return 31 - __builtin_clz(pages);
+}
+
+/* 64 bit, as a 4GiB GTT holds extents past the last 32 bit power of two. */
+static uint64_t
+pot_roundup(uint64_t x)
+{
+	uint64_t pot = 1;
+
+	while (pot < x)
+		pot <<= 1;
+	return pot;
+}
+
+/*
+ * The scratch page is whatever the unused entries point to, i.e. the
+ * target of the longest constant run.
+ */
+static uint32_t
+find_scratch(const uint32_t *pte, uint32_t num_entries)
+{
+	uint32_t start, end, best = 0, scratch = 0;
+
+	for (start = 0; start < num_entries; start = end) {
+		end = run_end(pte, start, num_entries, 0);
+		if (end - start > best) {
+			best = end - start;
+			scratch = pte[start];
+		}
+	}
+
+	return scratch;
+}
+
+static void
+analyze_gtt(uint32_t devid, const uint32_t *pte, uint32_t num_entries)
+{
+	uint32_t runs[RUN_BUCKETS] = { 0 }, run_pages[RUN_BUCKETS] = { 0 };
+	uint32_t scratch, scratch_pages = 0, invalid_pages = 0;
+	uint32_t largest_mapped = 0, largest_mapped_start = 0;
+	uint32_t largest_unmapped = 0, largest_unmapped_start = 0;
+	uint32_t extents = 0, mb_aligned = 0, fence_aligned = 0;
+	uint32_t start, end, i;
+	uint64_t size;
+
+	if (num_entries == 0) {
+		printf("GTT: no entries, devid 0x%04x\n", devid);
+		return;
 	}
 
+	scratch = find_scratch(pte, num_entries);
+
+	/* Physically contiguous runs of mapped pages */
+	for (start = 0; start < num_entries; start = end) {
+		end = run_end(pte, start, num_entries, KB(4));
+		if (pte[start] == scratch || !(pte[start] & 1)) {
+			end = start + 1;
+			continue;
+		}
+
+		i = log2_bucket(end - start);
+		runs[i]++;
+		run_pages[i] += end - start;
+	}
+
+	/* Mapped and unmapped extents of the GTT address space */
+	for (start = 0; start < num_entries; start = end) {
+		int mapped = pte[start] != scratch && (pte[start] & 1);
+
+		for (end = start + 1; end < num_entries; end++)
+			if ((pte[end] != scratch && (pte[end] & 1)) != mapped)
+				break;
+
+		if (!mapped) {
+			for (i = start; i < end; i++) {
+				if (pte[i] == scratch)
+					scratch_pages++;
+				else
+					invalid_pages++;
+			}
+			if (end - start > largest_unmapped) {
+				largest_unmapped = end - start;
+				largest_unmapped_start = start;
+			}
+			continue;
+		}
+
+		if (end - start > largest_mapped) {
+			largest_mapped = end - start;
+			largest_mapped_start = start;
+		}
+
+		/* Gen3 fences need a power-of-two size of at least 1MiB,
+		 * naturally aligned; later gens only need 4KiB alignment. */
+		extents++;
+		if ((start << PAGE_SHIFT) % MB(1) == 0)
+			mb_aligned++;
+		size = (uint64_t)(end - start) << PAGE_SHIFT;
+		if ((start << PAGE_SHIFT) %
+		    pot_roundup(size > MB(1) ? size : MB(1)) == 0)
+			fence_aligned++;
+	}
+
+	printf("GTT: %u entries (%u MiB), devid 0x%04x\n",
+	       num_entries, num_entries >> (20 - PAGE_SHIFT), devid);
+	printf("scratch page PTE: 0x%08x, covering %u pages (%.1f%%)\n",
+	       scratch, scratch_pages, 100. * scratch_pages / num_entries);
+	if (invalid_pages)
+		printf("invalid PTEs: %u pages\n", invalid_pages);
+	printf("largest mapped extent: %u KiB at 0x%08x\n",
+	       largest_mapped << (PAGE_SHIFT - 10),
+	       largest_mapped_start << PAGE_SHIFT);
+	printf("largest unmapped extent: %u KiB at 0x%08x\n",
+	       largest_unmapped << (PAGE_SHIFT - 10),
+	       largest_unmapped_start << PAGE_SHIFT);
+	printf("mapped extents: %u, 1MiB aligned: %u, gen3 fence aligned: %u%s\n",
+	       extents, mb_aligned, fence_aligned,
+	       IS_GEN3(devid) ? "" : " (not required on this gen)");
+
+	printf("\nphysically contiguous runs:\n");
+	printf("%12s %10s %10s\n", "pages", "runs", "KiB");
+	for (i = 0; i < RUN_BUCKETS; i++) {
+		if (!runs[i])
+			continue;
+		printf("%5u-%-6u %10u %10u\n",
+		       1u << i, (2u << i) - 1, runs[i],
+		       run_pages[i] << (PAGE_SHIFT - 10));
+	}
+}
+
+static void
+usage(const char *appname)
+{
+	printf("usage: %s [-a] [-f <dump file>] [-c <dump file>]\n"
+	       "\n"
+	       "  -c <file>  capture the GTT into file and exit\n"
+	       "  -f <file>  read the GTT from a capture instead of the device\n"
+	       "  -a         print a fragmentation analysis instead of the PTEs\n",
+	       appname);
+}
+
+int main(int argc, char **argv)
+{
+	const char *capture = NULL, *input = NULL;
+	uint32_t devid, num_entries;
+	uint32_t *pte;
+	int analyze = 0, ch;
+
+	while ((ch = getopt(argc, argv, "ac:f:h")) != -1) {
+		switch (ch) {
+		case 'a':
+			analyze = 1;
+			break;
+		case 'c':
+			capture = optarg;
+			break;
+		case 'f':
+			input = optarg;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (input)
+		pte = load_gtt(input, &devid, &num_entries);
+	else
+		pte = read_gtt(&devid, &num_entries);
+
+	if (capture)
+		save_gtt(capture, devid, pte, num_entries);
+	else if (analyze)
+		analyze_gtt(devid, pte, num_entries);
+	else
+		dump_gtt(pte, num_entries);
+
+	free(pte);
 	return 0;
 }
@@ -26,6 +26,7 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -236,6 +237,9 @@ const char *dip_frequency_names[] = {
 
 int gen = 0;
 
+/* Decoding a register snapshot rather than live MMIO */
+static int snapshot;
+
 static const char *spd_source_to_string(SourceDevice source)
 {
 	switch (source) {
@@ -302,6 +306,12 @@ static void load_infoframe(Transcoder transcoder, DipInfoFrame *frame,
 	uint32_t ctl_val;
 	uint32_t i;
 
+	/* The buffers sit behind an index that a snapshot cannot replay */
+	if (snapshot) {
+		memset(frame, 0, sizeof(*frame));
+		return;
+	}
+
 	ctl_val = INREG(ctl_reg);
 
 	ctl_val &= ~DIP_CTL_BUFFER_INDEX;
@@ -415,6 +425,11 @@ static void dump_avi_info(Transcoder transcoder)
 	freq = (val & DIP_CTL_FREQUENCY) >> 16;
 	printf("- frequency: %s\n", dip_frequency_names[freq]);
 
+	if (snapshot) {
+		printf("- contents: not available in snapshot\n");
+		return;
+	}
+
 	dump_raw_infoframe(&frame);
 
 	printf("- type: %x, version: %x, length: %x, ecc: %x, checksum: %x\n",
@@ -496,6 +511,11 @@ static void dump_vendor_info(Transcoder transcoder)
 	freq = (val & DIP_CTL_FREQUENCY) >> 16;
 	printf("- frequency: %s\n", dip_frequency_names[freq]);
 
+	if (snapshot) {
+		printf("- contents: not available in snapshot\n");
+		return;
+	}
+
 	dump_raw_infoframe(&frame);
 
 	vendor_id = frame.vendor.id[2] << 16 | frame.vendor.id[1] << 8 |
@@ -531,6 +551,11 @@ static void dump_gamut_info(Transcoder transcoder)
 	freq = (val & DIP_CTL_FREQUENCY) >> 16;
 	printf("- frequency: %s\n", dip_frequency_names[freq]);
 
+	if (snapshot) {
+		printf("- contents: not available in snapshot\n");
+		return;
+	}
+
 	dump_raw_infoframe(&frame);
 
 	if (!infoframe_valid_checksum(&frame))
@@ -559,6 +584,11 @@ static void dump_spd_info(Transcoder transcoder)
 	freq = (val & DIP_CTL_FREQUENCY) >> 16;
 	printf("- frequency: %s\n", dip_frequency_names[freq]);
 
+	if (snapshot) {
+		printf("- contents: not available in snapshot\n");
+		return;
+	}
+
 	dump_raw_infoframe(&frame);
 
 	printf("- type: %x, version: %x, length: %x, ecc: %x, checksum: %x\n",
@@ -957,6 +987,11 @@ printf("Options:\n"
 "          select transcoder (A, B or C)\n"
 "  -f, --infoframe\n"
 "          select infoframe (AVI, Vendor, Gamut or SPD)\n"
+"  -s, --snapshot [file]\n"
+"          decode a register snapshot taken with intel_reg_snapshot instead\n"
+"          of the hardware, may be given several times (--dump only)\n"
+"  -D, --devid [id]\n"
+"          device id (in hex) of the machine the snapshots were taken on\n"
 "  -h, --help\n"
 "          prints this message\n"
 "\n"
@@ -1009,79 +1044,57 @@ printf("Options:\n"
 #define CHECK_TRANSCODER(transcoder)                  \
 	if (transcoder == TRANSC_INVALID) {           \
 		printf("Transcoder not selected.\n"); \
-		ret = 1;                              \
-		goto out;                             \
+		return 1;                             \
 	}
 
 #define CHECK_DIP(dip)                                \
 	if (dip == DIP_INVALID) {                     \
 		printf("Infoframe not selected.\n");  \
-		ret = 1;                              \
-		goto out;                             \
+		return 1;                             \
 	}
 
-int main(int argc, char *argv[])
-{
+struct action {
 	int opt;
-	int ret = 0;
-	struct pci_device *pci_dev;
-	Transcoder transcoder = TRANSC_INVALID;
-	DipType dip = DIP_INVALID;
-	Register hdmi_port;
-
-	char short_opts[] = "dc:k:q:nNxXp:P:t:f:h";
-	struct option long_opts[] = {
-		{ "dump",               no_argument,       NULL, 'd' },
-		{ "change-fields",      required_argument, NULL, 'c' },
-		{ "change-checksum",    required_argument, NULL, 'k' },
-		{ "change-frequency",   required_argument, NULL, 'q' },
-		{ "disable",            no_argument,       NULL, 'n' },
-		{ "enable",             no_argument,       NULL, 'N' },
-		{ "disable-infoframes", no_argument,       NULL, 'x' },
-		{ "enable-infoframes",  no_argument,       NULL, 'X' },
-		{ "disable-hdmi-port",  required_argument, NULL, 'p' },
-		{ "enable-hdmi-port",   required_argument, NULL, 'P' },
-		{ "transcoder" ,        required_argument, NULL, 't' },
-		{ "infoframe",          required_argument, NULL, 'f' },
-		{ "help",               no_argument,       NULL, 'h' },
-	};
-
-	printf("WARNING: This is just a debugging tool! Don't expect it to work"
-	       " perfectly: the Kernel might undo our changes.\n");
-
-	pci_dev = intel_get_pci_device();
-	intel_register_access_init(pci_dev, 0);
-	intel_check_pch();
+	char *arg;
+};
 
-	if (IS_GEN4(pci_dev->device_id))
+static int set_gen(uint32_t devid)
+{
+	if (IS_GEN4(devid))
 		gen = 4;
-	else if (IS_GEN5(pci_dev->device_id))
+	else if (IS_GEN5(devid))
 		gen = 5;
-	else if (IS_GEN6(pci_dev->device_id))
+	else if (IS_GEN6(devid))
 		gen = 6;
-	else if (IS_GEN7(pci_dev->device_id))
+	else if (IS_GEN7(devid))
 		gen = 7;
 	else {
 		printf("This program does not support your hardware yet.\n");
-		ret = 1;
-		goto out;
+		return 1;
 	}
 
-	while (1) {
-		opt = getopt_long(argc, argv, short_opts, long_opts, NULL);
-		if (opt == -1)
-			break;
+	return 0;
+}
+
+static int run_actions(struct action *actions, int num_actions)
+{
+	Transcoder transcoder = TRANSC_INVALID;
+	DipType dip = DIP_INVALID;
+	Register hdmi_port;
+	char *optarg;
+	int i;
+
+	for (i = 0; i < num_actions; i++) {
+		int opt = actions[i].opt;
+
+		optarg = actions[i].arg;
 
 		switch (opt) {
 		case 'd':
 			dump_all_info();
 			break;
 		case 'c':
-			if (transcoder == TRANSC_INVALID) {
-				printf("Transcoder not selected.\n");
-				ret = 1;
-				goto out;
-			}
+			CHECK_TRANSCODER(transcoder);
 			switch (dip) {
 			case DIP_AVI:
 				change_avi_infoframe(transcoder, optarg);
@@ -1089,15 +1102,13 @@ int main(int argc, char *argv[])
 			case DIP_VENDOR:
 			case DIP_GAMUT:
 				printf("Option not implemented yet.\n");
-				ret = 1;
-				goto out;
+				return 1;
 			case DIP_SPD:
 				change_spd_infoframe(transcoder, optarg);
 				break;
 			case DIP_INVALID:
 				printf("Infoframe not selected.\n");
-				ret = 1;
-				goto out;
+				return 1;
 			}
 			break;
 		case 'k':
@@ -1119,8 +1130,7 @@ int main(int argc, char *argv[])
 						DIP_FREQ_EVERY_OTHER_VSYNC);
 			else {
 				printf("Invalid frequency.\n");
-				ret = 1;
-				goto out;
+				return 1;
 			}
 			break;
 		case 'n':
@@ -1151,8 +1161,7 @@ int main(int argc, char *argv[])
 				hdmi_port = get_hdmi_port(2);
 			else {
 				printf("Invalid HDMI port.\n");
-				ret = 1;
-				goto out;
+				return 1;
 			}
 			if (opt == 'p')
 				disable_hdmi_port(hdmi_port);
@@ -1168,8 +1177,7 @@ int main(int argc, char *argv[])
 				transcoder = TRANSC_C;
 			} else {
 				printf("Invalid transcoder.\n");
-				ret = 1;
-				goto out;
+				return 1;
 			}
 			break;
 		case 'f':
@@ -1183,21 +1191,129 @@ int main(int argc, char *argv[])
 				dip = DIP_SPD;
 			else {
 				printf("Invalid infoframe.\n");
-				ret = 1;
-				goto out;
+				return 1;
 			}
 			break;
 		case 'h':
 			print_usage();
 			break;
-		default:
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	int ret = 0;
+	struct pci_device *pci_dev;
+	struct action *actions;
+	int num_actions = 0;
+	char **snapshots;
+	int num_snapshots = 0;
+	uint32_t devid = 0;
+	int i;
+
+	char short_opts[] = "dc:k:q:nNxXp:P:t:f:s:D:h";
+	struct option long_opts[] = {
+		{ "dump",               no_argument,       NULL, 'd' },
+		{ "change-fields",      required_argument, NULL, 'c' },
+		{ "change-checksum",    required_argument, NULL, 'k' },
+		{ "change-frequency",   required_argument, NULL, 'q' },
+		{ "disable",            no_argument,       NULL, 'n' },
+		{ "enable",             no_argument,       NULL, 'N' },
+		{ "disable-infoframes", no_argument,       NULL, 'x' },
+		{ "enable-infoframes",  no_argument,       NULL, 'X' },
+		{ "disable-hdmi-port",  required_argument, NULL, 'p' },
+		{ "enable-hdmi-port",   required_argument, NULL, 'P' },
+		{ "transcoder" ,        required_argument, NULL, 't' },
+		{ "infoframe",          required_argument, NULL, 'f' },
+		{ "snapshot",           required_argument, NULL, 's' },
+		{ "devid",              required_argument, NULL, 'D' },
+		{ "help",               no_argument,       NULL, 'h' },
+		{ 0 }
+	};
+
+	/* Actions are only run once we know whether we are poking the
+	 * hardware or decoding snapshots, so collect them first. */
+	actions = calloc(argc, sizeof(*actions));
+	snapshots = calloc(argc, sizeof(*snapshots));
+	if (!actions || !snapshots) {
+		printf("Out of memory.\n");
+		return 1;
+	}
+
+	while (1) {
+		opt = getopt_long(argc, argv, short_opts, long_opts, NULL);
+		if (opt == -1)
+			break;
+
+		switch (opt) {
+		case 's':
+			snapshots[num_snapshots++] = optarg;
+			break;
+		case 'D':
+			devid = strtol(optarg, NULL, 16);
+			break;
+		case '?':
 			print_usage();
-			ret = 1;
-			goto out;
+			return 1;
+		default:
+			actions[num_actions].opt = opt;
+			actions[num_actions].arg = optarg;
+			num_actions++;
+		}
+	}
+
+	if (num_snapshots) {
+		for (i = 0; i < num_actions; i++) {
+			if (!strchr("dtfh", actions[i].opt)) {
+				printf("Only --dump can be used on snapshots.\n");
+				return 1;
+			}
+		}
+		if (!num_actions)
+			actions[num_actions++].opt = 'd';
+
+		if (!devid)
+			devid = intel_get_pci_device()->device_id;
+		if (set_gen(devid))
+			return 1;
+		pch = intel_devid_to_pch(devid);
+
+		snapshot = 1;
+		for (i = 0; i < num_snapshots; i++) {
+			if (num_snapshots > 1)
+				printf("%s==> %s <==\n", i ? "\n" : "",
+				       snapshots[i]);
+
+			if (intel_mmio_load_snapshot(snapshots[i])) {
+				fflush(stdout);
+				fprintf(stderr, "Couldn't load %s: %s\n",
+					snapshots[i], strerror(errno));
+				ret = 1;
+				continue;
+			}
+
+			if (run_actions(actions, num_actions))
+				return 1;
 		}
+
+		return ret;
 	}
 
-out:
+	printf("WARNING: This is just a debugging tool! Don't expect it to work"
+	       " perfectly: the Kernel might undo our changes.\n");
+
+	pci_dev = intel_get_pci_device();
+	intel_register_access_init(pci_dev, 0);
+	intel_check_pch();
+
+	ret = set_gen(pci_dev->device_id);
+	if (!ret)
+		ret = run_actions(actions, num_actions);
+
 	intel_register_access_fini();
 	return ret;
 }
@@ -30,6 +30,9 @@
 #include <stdio.h>
 #include <err.h>
 #include <string.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
 #include "intel_gpu_tools.h"
 
 static void bit_decode(uint32_t reg)
@@ -41,7 +44,18 @@ static void bit_decode(uint32_t reg)
 	printf("\n");
 
 	for (i=31; i >= 0; i--)
-		printf(" %2d", (reg & (1 << i)) && 1);
+		printf(" %2d", (reg & (1u << i)) && 1);
+	printf("\n");
+}
+
+static void bit_decode_changes(uint32_t reg, uint32_t changed)
+{
+	int i;
+
+	bit_decode(reg);
+
+	for (i=31; i >= 0; i--)
+		printf(" %2s", changed & (1u << i) ? "^^" : "");
 	printf("\n");
 }
 
@@ -54,13 +68,386 @@ static void dump_range(uint32_t start, uint32_t end)
 		       *(volatile uint32_t *)((volatile char*)mmio + i));
 }
 
+/*
+ * Register scripts: one operation per line, '#' starts a comment.
+ *
+ *   read <addr> [count]                  print count dwords from addr
+ *   write <addr> <value>
+ *   rmw <addr> <mask> <value>            replace the bits in mask by value
+ *   wait <addr> <mask> <value> <usecs>   poll until (reg & mask) == value
+ *   delay <usecs>
+ *   loop <count> ... end                 repeat the enclosed operations
+ *
+ * The whole script is parsed before the device is touched and then runs
+ * with a single mapping and forcewake reference, so its timing is not
+ * disturbed by parsing or terminal output.
+ */
+enum script_opcode {
+	OP_READ,
+	OP_WRITE,
+	OP_RMW,
+	OP_WAIT,
+	OP_DELAY,
+	OP_LOOP,
+	OP_END,
+};
+
+struct script_op {
+	enum script_opcode opcode;
+	uint32_t reg, mask, value;
+	uint32_t count;		/* dwords, iterations or usecs */
+	int match;		/* index of the matching loop/end */
+	int line;
+};
+
+#define MAX_SCRIPT_DEPTH 16
+
+static const struct {
+	const char *name;
+	enum script_opcode opcode;
+	int args;
+	int optional;
+} script_ops[] = {
+	{ "read", OP_READ, 2, 1 },
+	{ "write", OP_WRITE, 2, 0 },
+	{ "rmw", OP_RMW, 3, 0 },
+	{ "wait", OP_WAIT, 4, 0 },
+	{ "delay", OP_DELAY, 1, 0 },
+	{ "loop", OP_LOOP, 1, 0 },
+	{ "end", OP_END, 0, 0 },
+};
+
+#define WATCH_RATE 1000
+
+static struct script_op *
+script_parse(const char *filename, int *num_ops)
+{
+	struct script_op *ops = NULL;
+	int n = 0, size = 0, depth = 0, line = 0;
+	int stack[MAX_SCRIPT_DEPTH];
+	char buf[1024];
+	FILE *file;
+
+	file = fopen(filename, "r");
+	if (!file)
+		err(1, "failed to open %s", filename);
+
+	while (fgets(buf, sizeof(buf), file)) {
+		struct script_op *op;
+		uint32_t args[4];
+		char *tok, *end;
+		unsigned int i;
+		int nargs = 0;
+
+		line++;
+		if ((tok = strchr(buf, '#')))
+			*tok = '\0';
+
+		tok = strtok(buf, " \t\r\n");
+		if (!tok)
+			continue;
+
+		for (i = 0; i < ARRAY_SIZE(script_ops); i++)
+			if (!strcmp(tok, script_ops[i].name))
+				break;
+		if (i == ARRAY_SIZE(script_ops))
+			errx(1, "%s:%d: unknown operation '%s'", filename, line, tok);
+
+		while ((tok = strtok(NULL, " \t\r\n"))) {
+			if (nargs == script_ops[i].args)
+				errx(1, "%s:%d: too many arguments", filename, line);
+			args[nargs++] = strtoul(tok, &end, 0);
+			if (*end)
+				errx(1, "%s:%d: bad number '%s'", filename, line, tok);
+		}
+		if (nargs < script_ops[i].args - script_ops[i].optional)
+			errx(1, "%s:%d: missing arguments", filename, line);
+
+		if (n == size) {
+			size = size ? 2 * size : 256;
+			ops = realloc(ops, size * sizeof(*ops));
+			if (!ops)
+				err(1, "realloc");
+		}
+
+		op = &ops[n];
+		memset(op, 0, sizeof(*op));
+		op->opcode = script_ops[i].opcode;
+		op->line = line;
+
+		switch (op->opcode) {
+		case OP_READ:
+			op->reg = args[0];
+			op->count = nargs > 1 ? args[1] : 1;
+			break;
+		case OP_WRITE:
+			op->reg = args[0];
+			op->value = args[1];
+			break;
+		case OP_RMW:
+			op->reg = args[0];
+			op->mask = args[1];
+			op->value = args[2];
+			break;
+		case OP_WAIT:
+			op->reg = args[0];
+			op->mask = args[1];
+			op->value = args[2];
+			op->count = args[3];
+			break;
+		case OP_DELAY:
+			op->count = args[0];
+			break;
+		case OP_LOOP:
+			if (depth == MAX_SCRIPT_DEPTH)
+				errx(1, "%s:%d: loops nested too deeply", filename, line);
+			op->count = args[0];
+			stack[depth++] = n;
+			break;
+		case OP_END:
+			if (!depth)
+				errx(1, "%s:%d: end without loop", filename, line);
+			op->match = stack[--depth];
+			ops[op->match].match = n;
+			break;
+		}
+		n++;
+	}
+	if (depth)
+		errx(1, "%s:%d: unterminated loop", filename, ops[stack[depth - 1]].line);
+
+	fclose(file);
+
+	*num_ops = n;
+	return ops;
+}
+
+static uint64_t script_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static int script_run(const struct script_op *ops, int num_ops)
+{
+	uint32_t remaining[MAX_SCRIPT_DEPTH];
+	int pc, depth = 0, ret = 0;
+
+	for (pc = 0; pc < num_ops; pc++) {
+		const struct script_op *op = &ops[pc];
+		uint64_t deadline;
+		uint32_t val, i;
+
+		switch (op->opcode) {
+		case OP_READ:
+			for (i = 0; i < op->count; i++)
+				printf("0x%X : 0x%X\n", op->reg + 4 * i,
+				       INREG(op->reg + 4 * i));
+			break;
+		case OP_WRITE:
+			OUTREG(op->reg, op->value);
+			break;
+		case OP_RMW:
+			val = INREG(op->reg);
+			OUTREG(op->reg, (val & ~op->mask) | (op->value & op->mask));
+			break;
+		case OP_WAIT:
+			deadline = script_time_us() + op->count;
+			while (((val = INREG(op->reg)) & op->mask) != op->value) {
+				if (script_time_us() > deadline) {
+					printf("line %d: timed out waiting for 0x%X & 0x%X == 0x%X (0x%X)\n",
+					       op->line, op->reg, op->mask,
+					       op->value, val);
+					ret = 1;
+					break;
+				}
+			}
+			break;
+		case OP_DELAY:
+			deadline = script_time_us() + op->count;
+			while (script_time_us() < deadline)
+				;
+			break;
+		case OP_LOOP:
+			if (!op->count)
+				pc = op->match;
+			else
+				remaining[depth++] = op->count;
+			break;
+		case OP_END:
+			if (--remaining[depth - 1])
+				pc = op->match;
+			else
+				depth--;
+			break;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * Watch mode: poll a set of register ranges at a fixed rate and print
+ * only the registers that changed since the previous poll.
+ */
+struct watch_range {
+	uint32_t reg, count;
+	uint32_t *cur, *prev;
+};
+
+static volatile int watch_stop;
+
+static void watch_sighandler(int sig)
+{
+	watch_stop = 1;
+}
+
+static void timespec_add_ns(struct timespec *ts, long ns)
+{
+	ts->tv_nsec += ns;
+	while (ts->tv_nsec >= 1000000000) {
+		ts->tv_nsec -= 1000000000;
+		ts->tv_sec++;
+	}
+}
+
+static double timespec_diff(const struct timespec *a, const struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) + (a->tv_nsec - b->tv_nsec) / 1e9;
+}
+
+static void watch_read(struct watch_range *range)
+{
+	uint32_t i;
+
+	for (i = 0; i < range->count; i++)
+		range->cur[i] = INREG(range->reg + 4 * i);
+}
+
+static int watch_report(struct watch_range *range, double t, int decode_bits)
+{
+	uint32_t i;
+	int changes = 0;
+
+	/* memcmp is vectorised, only walk the range when something changed */
+	if (!memcmp(range->cur, range->prev, range->count * sizeof(uint32_t)))
+		return 0;
+
+	for (i = 0; i < range->count; i++) {
+		uint32_t changed = range->cur[i] ^ range->prev[i];
+
+		if (!changed)
+			continue;
+
+		printf("%12.6f 0x%X : 0x%X -> 0x%X (changed 0x%X)\n",
+		       t, range->reg + 4 * i, range->prev[i], range->cur[i],
+		       changed);
+		if (decode_bits)
+			bit_decode_changes(range->cur[i], changed);
+		changes++;
+	}
+
+	memcpy(range->prev, range->cur, range->count * sizeof(uint32_t));
+	return changes;
+}
+
+static int watch(char **regs, int num_regs, int dwords, int rate,
+		 int decode_bits)
+{
+	struct watch_range *ranges;
+	struct timespec start, next, now;
+	unsigned long long polls = 0, changes = 0;
+	long period = 1000000000 / rate;
+	int i;
+
+	ranges = calloc(num_regs, sizeof(*ranges));
+	if (!ranges)
+		err(1, "calloc");
+
+	for (i = 0; i < num_regs; i++) {
+		char *count;
+
+		ranges[i].reg = strtoul(regs[i], &count, 0);
+		ranges[i].count = *count == ':' ? strtoul(count + 1, NULL, 0) : dwords;
+		if (!ranges[i].count)
+			ranges[i].count = 1;
+
+		ranges[i].cur = malloc(2 * ranges[i].count * sizeof(uint32_t));
+		if (!ranges[i].cur)
+			err(1, "malloc");
+		ranges[i].prev = ranges[i].cur + ranges[i].count;
+	}
+
+	signal(SIGINT, watch_sighandler);
+	signal(SIGTERM, watch_sighandler);
+
+	intel_register_access_init(intel_get_pci_device(), 0);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < num_regs; i++) {
+		watch_read(&ranges[i]);
+		memcpy(ranges[i].prev, ranges[i].cur,
+		       ranges[i].count * sizeof(uint32_t));
+		dump_range(ranges[i].reg, ranges[i].reg + 4 * ranges[i].count);
+	}
+	fflush(stdout);
+
+	next = start;
+	while (!watch_stop) {
+		int changed = 0;
+
+		timespec_add_ns(&next, period);
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		for (i = 0; i < num_regs; i++)
+			watch_read(&ranges[i]);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		polls++;
+
+		for (i = 0; i < num_regs; i++)
+			changed += watch_report(&ranges[i],
+						timespec_diff(&now, &start),
+						decode_bits);
+		if (changed) {
+			changes += changed;
+			fflush(stdout);
+		}
+
+		/* If we fell behind, don't try to catch up with a burst. */
+		if (timespec_diff(&now, &next) > period / 1e9)
+			next = now;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	fprintf(stderr, "%llu polls in %.3fs: %.0f Hz (requested %d Hz), %llu changes\n",
+		polls, timespec_diff(&now, &start),
+		polls / timespec_diff(&now, &start), rate, changes);
+
+	intel_register_access_fini();
+
+	for (i = 0; i < num_regs; i++)
+		free(ranges[i].cur);
+	free(ranges);
+
+	return 0;
+}
+
 static void usage(char *cmdname)
 {
 	printf("Usage: %s [-f|-d] [addr1] [addr2] .. [addrN]\n", cmdname);
+	printf("       %s [-t] --script <file>\n", cmdname);
+	printf("       %s [-d] [-r rate] --watch addr1[:count] .. [addrN[:count]]\n", cmdname);
 	printf("\t -f : read back full range of registers.\n");
 	printf("\t      WARNING! This option may result in a machine hang!\n");
 	printf("\t -d : decode register bits.\n");
 	printf("\t -c : number of dwords to dump (can't be used with -f/-d).\n");
+	printf("\t -s, --script : execute the register operations in file.\n");
+	printf("\t -t : report the script execution time on stderr.\n");
+	printf("\t -w, --watch : poll the registers until interrupted and print\n");
+	printf("\t               only the ones that changed.\n");
+	printf("\t -r : polls per second in watch mode (default %d).\n", WATCH_RATE);
 	printf("\t addr : in 0xXXXX format\n");
 }
 
@@ -73,8 +460,18 @@ int main(int argc, char** argv)
 	int full_dump = 0;
 	int decode_bits = 0;
 	int dwords = 1;
+	const char *script = NULL;
+	int timing = 0;
+	int watch_mode = 0;
+	int rate = WATCH_RATE;
+	static const struct option long_opts[] = {
+		{ "script", required_argument, NULL, 's' },
+		{ "watch", no_argument, NULL, 'w' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
 
-	while ((ch = getopt(argc, argv, "dfhc:")) != -1) {
+	while ((ch = getopt_long(argc, argv, "dfhc:s:twr:", long_opts, NULL)) != -1) {
 		switch(ch) {
 		case 'd':
 			decode_bits = 1;
@@ -89,11 +486,83 @@ int main(int argc, char** argv)
 		case 'c':
 			dwords = strtol(optarg, NULL, 0);
 			break;
+		case 's':
+			script = optarg;
+			break;
+		case 't':
+			timing = 1;
+			break;
+		case 'w':
+			watch_mode = 1;
+			break;
+		case 'r':
+			rate = strtol(optarg, NULL, 0);
+			if (rate <= 0) {
+				usage(cmdname);
+				ret = 1;
+				goto out;
+			}
+			break;
 		}
 	}
 	argc -= optind;
 	argv += optind;
 
+	/* watch needs registers to poll, and doesn't mix with the other
+	 * modes */
+	if (watch_mode) {
+		if (argc < 1) {
+			fprintf(stderr, "--watch needs at least one register\n");
+			usage(cmdname);
+			ret = 1;
+			goto out;
+		}
+		if (script || full_dump) {
+			usage(cmdname);
+			ret = 1;
+			goto out;
+		}
+		for (i = 0; i < argc; i++) {
+			char *end;
+
+			strtoul(argv[i], &end, 0);
+			if (end == argv[i] || (*end && *end != ':')) {
+				fprintf(stderr, "invalid register %s\n", argv[i]);
+				usage(cmdname);
+				ret = 1;
+				goto out;
+			}
+		}
+	}
+
+	if (script) {
+		struct script_op *ops;
+		static char buf[1 << 16];
+		uint64_t start;
+		int num_ops;
+
+		ops = script_parse(script, &num_ops);
+		setvbuf(stdout, buf, _IOFBF, sizeof(buf));
+
+		intel_register_access_init(intel_get_pci_device(), 0);
+		start = script_time_us();
+		ret = script_run(ops, num_ops);
+		if (timing)
+			fprintf(stderr, "%s: %d operations in %llu us\n", script,
+				num_ops,
+				(unsigned long long)(script_time_us() - start));
+		intel_register_access_fini();
+
+		fflush(stdout);
+		free(ops);
+		goto out;
+	}
+
+	if (watch_mode) {
+		ret = watch(argv, argc, dwords, rate, decode_bits);
+		goto out;
+	}
+
 	if (argc < 1) {
 		usage(cmdname);
 		ret = 1;